@@ -1,14 +1,23 @@
+#include <stdlib.h>
+
 #include "adapter.h"
 #include "promise.h"
 #include "logger.h"
 
 using namespace std;
+using namespace fixed;
 
 static const Logger logger("[Adapter]");
 
 struct AdapterPrivate {
     static bool setOffset(Adapter *self, int value);
-    static bool setValue(Adapter *self, int value);
+    static bool setValue(Adapter *self, Q16 value);
+    static void learnOffset(Adapter *self, int value);
+    static bool hasValue(Adapter *self);
+    static void expireWrites(Adapter *self, gint64 now);
+    static void recordWrite(Adapter *self, Q16 brightness);
+    static bool isNear(Adapter *self, Q16 written, Q16 reported);
+    static bool consumeEcho(Adapter *self, Q16 brightness);
     static void setBrightness(Adapter *self);
     static void onBrightnessChanged(Adapter *self);
 };
@@ -32,36 +41,139 @@ bool AdapterPrivate::setOffset(Adapter *self, int value) {
   return true;
 }
 
-bool AdapterPrivate::setValue(Adapter *self, int value) {
-  value = clamp(value, 0 - self->offset, 100 - self->offset);
+bool AdapterPrivate::setValue(Adapter *self, Q16 value) {
+  /* offset follows the ambient level */
+  setOffset(self, self->offsets.get(value));
+  value = clamp(value, fromInt(0 - self->offset), fromInt(100 - self->offset));
 
   if (self->value == value)
     return false;
 
+  bool changed = toInt(self->value) != toInt(value);
   self->value = value;
-  self->valueChanged();
+  if (changed)
+    self->valueChanged();
   return true;
 }
 
+void AdapterPrivate::learnOffset(Adapter *self, int value) {
+  if (hasValue(self)) {
+    if (self->offsets.learn(self->value, value))
+      self->offsetsChanged();
+    setOffset(self, self->offsets.get(self->value));
+  } else {
+    OffsetTable offsets;
+    offsets.fill(value);
+    if (self->offsets != offsets) {
+      self->offsets = offsets;
+      self->offsetsChanged();
+    }
+    setOffset(self, value);
+  }
+}
+
+inline bool AdapterPrivate::hasValue(Adapter *self) {
+  return self->value != fromInt(Adapter::NO_VALUE);
+}
+
+void AdapterPrivate::expireWrites(Adapter *self, gint64 now) {
+  int n = 0;
+  while (n < self->nWrites && self->writes[n].expires < now)
+    n++;
+  if (!n)
+    return;
+
+  self->nWrites -= n;
+  for (int i = 0; i < self->nWrites; i++)
+    self->writes[i] = self->writes[i + n];
+}
+
+void AdapterPrivate::recordWrite(Adapter *self, Q16 brightness) {
+  if (self->echoWindow <= 0)
+    return;
+
+  gint64 now = g_get_monotonic_time();
+  expireWrites(self, now);
+
+  /* full, forget the oldest */
+  if (self->nWrites == Adapter::MAX_WRITES) {
+    self->nWrites--;
+    for (int i = 0; i < self->nWrites; i++)
+      self->writes[i] = self->writes[i + 1];
+  }
+
+  self->writes[self->nWrites++] = {
+      brightness,
+      now + self->echoWindow * 1000
+  };
+}
+
+/* backends coarser than 1% truncate or round the percentage written
+ * to one of their steps, either one is reported back */
+bool AdapterPrivate::isNear(Adapter *self, Q16 written, Q16 reported) {
+  if (abs(written - reported) <= HALF)
+    return true;
+
+  Q16 resolution = self->proxy->getResolution();
+  if (resolution <= ONE || written < 0 || reported < 0)
+    return false;
+
+  Q16 sent = fromInt(toInt(written));
+  Q16 step = (reported + resolution / 2) / resolution;
+  return step >= sent / resolution
+      && step <= (sent + resolution / 2) / resolution;
+}
+
+/* echoes come in order, a match supersedes older writes */
+bool AdapterPrivate::consumeEcho(Adapter *self, Q16 brightness) {
+  expireWrites(self, g_get_monotonic_time());
+  for (int i = 0; i < self->nWrites; i++) {
+    if (isNear(self, self->writes[i].brightness, brightness)) {
+      expireWrites(self, self->writes[i].expires + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
 void AdapterPrivate::setBrightness(Adapter *self) {
-  int brightness = self->value + self->offset;
-  LOGGER(logger) << "Setting brightness: " << brightness
-      << ", value: " << self->value
+  Q16 brightness = self->curve.mapFixed(self->value + fromInt(self->offset));
+  LOGGER(logger) << "Setting brightness: " << toDouble(brightness)
+      << ", value: " << toDouble(self->value)
       << ", offset: " << self->offset
       << endl;
-  self->proxy->setBrightness(brightness).grab(PROMISE_LOG_EX);
+  recordWrite(self, brightness);
+  self->proxy->setBrightnessFixed(brightness).grab(PROMISE_LOG_EX);
 }
 
 void AdapterPrivate::onBrightnessChanged(Adapter *self) {
-  int brightness = self->proxy->getBrightness();
+  Q16 brightness = self->proxy->getBrightnessFixed();
+
+  if (consumeEcho(self, brightness)) {
+    self->stats.echoes++;
+    return;
+  }
+
+  /* several levels can map to the same brightness, and backends round
+   * the brightness set to their own resolution */
+  if (hasValue(self)) {
+    Q16 expected = self->curve.mapFixed(self->value + fromInt(self->offset));
+    if (isNear(self, expected, brightness))
+      return;
+    self->stats.adjustments++;
+  }
+
+  int level = self->curve.inverse(toInt(brightness));
+  int offset = self->offset;
   bool changed;
-  if (self->value != Adapter::NO_VALUE) {
-    changed = setOffset(self, brightness - self->value);
+  if (hasValue(self)) {
+    learnOffset(self, level - toInt(self->value));
+    changed = self->offset != offset;
   } else {
-    changed = setValue(self, brightness - self->offset);
+    changed = setValue(self, fromInt(level - self->offset));
   }
-  changed && LOGGER(logger) << "Brightness changed: " << brightness
-      << ", value: " << self->value
+  changed && LOGGER(logger) << "Brightness changed: " << toDouble(brightness)
+      << ", value: " << toDouble(self->value)
       << ", offset: " << self->offset
       << endl;
 }
@@ -81,21 +193,54 @@ int Adapter::getOffset() const {
 }
 
 void Adapter::setOffset(int value) {
-  if (this->offset != value && AdapterPrivate::setOffset(this, value)) {
-    if (this->value != NO_VALUE) {
-      /* offset is changed so ensure value is still in range */
-      AdapterPrivate::setValue(this, this->value);
-      AdapterPrivate::setBrightness(this);
-    }
+  int offset = this->offset;
+  AdapterPrivate::learnOffset(this, value);
+  if (this->offset != offset && AdapterPrivate::hasValue(this)) {
+    /* offset is changed so ensure value is still in range */
+    AdapterPrivate::setValue(this, this->value);
+    AdapterPrivate::setBrightness(this);
+  }
+}
+
+const OffsetTable& Adapter::getOffsets() const {
+  return offsets;
+}
+
+void Adapter::setOffsets(const OffsetTable &offsets) {
+  if (this->offsets == offsets)
+    return;
+
+  this->offsets = offsets;
+  if (AdapterPrivate::hasValue(this)) {
+    AdapterPrivate::setValue(this, this->value);
+    AdapterPrivate::setBrightness(this);
   }
 }
 
 int Adapter::getValue() const {
-  return value;
+  return toInt(value);
 }
 
 void Adapter::setValue(int value) {
+  setValueFixed(fromInt(value));
+}
+
+Q16 Adapter::getValueFixed() const {
+  return value;
+}
+
+void Adapter::setValueFixed(Q16 value) {
   if (this->value != value && AdapterPrivate::setValue(this, value)) {
     AdapterPrivate::setBrightness(this);
   }
 }
+
+void Adapter::setCurve(const OutputCurve &curve) {
+  this->curve = curve;
+  if (AdapterPrivate::hasValue(this))
+    AdapterPrivate::setBrightness(this);
+}
+
+const Adapter::Stats& Adapter::getStats() const {
+  return stats;
+}
@@ -2,29 +2,92 @@
 #define ADAPTER_H_
 
 #include "brightness.h"
+#include "curve.h"
+#include "offset-table.h"
 #include "signals.h"
 
+/**
+ * Sets brightness from the value plus an offset learnt from manual
+ * changes, the offset depends on the value so each ambient level keeps
+ * its own correction.
+ */
 class Adapter {
     friend class AdapterPrivate;
 
+  public:
+    struct Stats {
+        unsigned long long echoes = 0;
+        unsigned long long adjustments = 0;
+    };
+
+  private:
     static const int NO_VALUE = -200;
+    static const int MAX_WRITES = 8;
+
+    /* brightness written, its echo is expected until expiry */
+    struct Write {
+        fixed::Q16 brightness;
+        gint64 expires;
+    };
 
     IBrightnessProxy *proxy;
     void *bchid = nullptr;
     int offset = 0;
-    int value = NO_VALUE;
+    OffsetTable offsets;
+    fixed::Q16 value = fixed::fromInt(NO_VALUE);
+    OutputCurve curve;
+
+    Write writes[MAX_WRITES];
+    int nWrites = 0;
+    Stats stats;
 
   public:
+    /**
+     * Milliseconds to wait for the echo of a write, 0 to not track
+     * writes when the proxy absorbs its own echoes, as Ramp does.
+     */
+    long echoWindow = 2000;
+
     signals::Signal<void()> offsetChanged;
     signals::Signal<void()> valueChanged;
 
+    /**
+     * Emitted when a manual change is learnt into the offset table.
+     */
+    signals::Signal<void()> offsetsChanged;
+
     Adapter(IBrightnessProxy *proxy);
     ~Adapter();
 
+    /**
+     * Offset at the current value, setting it is learnt as a manual
+     * change, at every value if there is none yet.
+     */
     int getOffset() const;
     void setOffset(int);
+
+    const OffsetTable& getOffsets() const;
+    void setOffsets(const OffsetTable&);
+
     int getValue() const;
     void setValue(int);
+
+    /**
+     * Value in Q16, the integer value is a rounded view of it.
+     */
+    fixed::Q16 getValueFixed() const;
+    void setValueFixed(fixed::Q16);
+
+    /**
+     * Curve from value plus offset to brightness.
+     */
+    void setCurve(const OutputCurve&);
+
+    /**
+     * Brightness changes that were echoes of our writes, and those
+     * made by the user.
+     */
+    const Stats& getStats() const;
 };
 
 #endif /* ADAPTER_H_ */
@@ -2,6 +2,7 @@
 
 #include "autobright-service.h"
 #include "debug-info.h"
+#include "gdbus-stats.h"
 #include "gexception.h"
 #include "logger.h"
 
@@ -52,6 +53,33 @@ static gboolean handleDisable(
   return TRUE;
 }
 
+static gboolean handleCallStats(
+    AutobrightDebug *object,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  GVariantBuilder builder;
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ssttttttt)"));
+  const gdbus::CallStatsTable &table = gdbus::callStats();
+  for (int i = 0; i < table.size; i++) {
+    const gdbus::CallStats &stats = table.entries[i];
+    g_variant_builder_add(&builder, "(ssttttttt)",
+        stats.iface,
+        stats.method,
+        (guint64) stats.calls,
+        (guint64) stats.errors,
+        (guint64) stats.timeouts,
+        (guint64) stats.cancelled,
+        (guint64) stats.latency.percentile(50),
+        (guint64) stats.latency.percentile(99),
+        (guint64) stats.latency.max());
+  }
+  autobright_debug_complete_call_stats(
+      object,
+      invocation,
+      g_variant_builder_end(&builder));
+  return TRUE;
+}
+
 static void onBusAcquired(
     GDBusConnection *connection,
     const gchar *name,
@@ -90,6 +118,24 @@ static void copyDebugInfo(DebugInfo *info, AutobrightDebug *debug) {
   autobright_debug_set_offset(debug, info->offset);
   autobright_debug_set_brightness(debug, info->brightness);
   autobright_debug_set_flags(debug, info->flags);
+  autobright_debug_set_samples(debug, info->samples);
+  autobright_debug_set_suppressed(debug, info->suppressed);
+  autobright_debug_set_coalesced(debug, info->coalesced);
+  autobright_debug_set_processed(debug, info->processed);
+  autobright_debug_set_time_to_target(debug, info->timeToTarget);
+  autobright_debug_set_ramp_steps(debug, info->rampSteps);
+  autobright_debug_set_echoes(debug, info->echoes);
+  autobright_debug_set_adjustments(debug, info->adjustments);
+  autobright_debug_set_value_changes_per_hour(
+      debug,
+      info->valueChangesPerHour);
+  autobright_debug_set_quiescent_time(debug, info->quiescentTime);
+  autobright_debug_set_wakeups_avoided(debug, info->wakeupsAvoided);
+  autobright_debug_set_resume_time(debug, info->resumeTime);
+  autobright_debug_set_duty_cycle(debug, info->dutyCycle);
+  autobright_debug_set_wakeups_per_minute(debug, info->wakeupsPerMinute);
+  autobright_debug_set_idle_refresh_time(debug, info->idleRefreshTime);
+  autobright_debug_set_idle_events_lost(debug, info->idleEventsLost);
 }
 
 void AutobrightServicePrivate::connectMethods(AutobrightService *self) {
@@ -97,6 +143,11 @@ void AutobrightServicePrivate::connectMethods(AutobrightService *self) {
   g_signal_connect(debug, "handle-quit", G_CALLBACK(::handleQuit), self);
   g_signal_connect(debug, "handle-enable", G_CALLBACK(::handleEnable), self);
   g_signal_connect(debug, "handle-disable", G_CALLBACK(::handleDisable), self);
+  g_signal_connect(
+      debug,
+      "handle-call-stats",
+      G_CALLBACK(::handleCallStats),
+      self);
 }
 
 void AutobrightServicePrivate::onBusAcquired(
@@ -1,44 +1,502 @@
-#include <math.h>
-#include <stdexcept>
-
 #include "autobright.h"
+#include "sysfs-backlight.h"
+#include "logind-backlight.h"
+#include "iio-sensor.h"
+#include "sensor-fusion.h"
 #include "logger.h"
 
 using namespace std;
 using namespace promise;
-using Unit = SensorProxy::Unit;
+using PGSettings = gsettings::PGSettings;
 
 static const Logger logger("[Autobright]", Logger::DEFAULT);
 
+enum BrightnessBackend {
+  GSD,
+  SYSFS,
+  LOGIND
+};
+
+enum KeyboardBackend {
+  KEYBOARD_NONE,
+  KEYBOARD_GSD,
+  KEYBOARD_SYSFS
+};
+
+enum SensorBackend {
+  PROXY,
+  IIO,
+  FUSION
+};
+
+enum FilterType {
+  PRESSURE,
+  EMA,
+  MEDIAN,
+  KALMAN,
+  HYSTERESIS
+};
+
+static const char *FILTER_KEYS[] = {
+    "filter",
+    "filter-time-constant",
+    "filter-interval",
+    "median-window",
+    "kalman-process-noise",
+    "kalman-measurement-noise",
+    "hysteresis-threshold",
+    "fast-path-threshold",
+    "fast-path-confirm",
+    "predictor-lead",
+    "predictor-window",
+    "predictor-limit"
+};
+
+struct Autobright::Output {
+    std::string name;
+    std::unique_ptr<IBrightnessProxy> proxy;
+    Adapter adapter;
+    Settings settings;
+    bool connected = false;
+
+    Output(const char *name, IBrightnessProxy *proxy, PGSettings gsettings) :
+        name(name),
+        proxy(proxy),
+        adapter(proxy),
+        settings(&adapter, gsettings, this->name + "-") {
+    }
+};
+
 struct AutobrightPrivate {
+    using Output = Autobright::Output;
+
+    static IBrightnessProxy* newBrightness(PGSettings gsettings);
+    static IBrightnessProxy* newKeyboard(GSettings *gsettings);
+    static void newOutputs(Autobright *self);
+    static void connectOutput(Autobright *self, Output *output);
+    static void setValue(Autobright *self, fixed::Q16 value);
+    static ISensor* newSource(const char *name, const char *iioRoot);
+    static ISensor* newFusion(GSettings *gsettings, const char *iioRoot);
+    static ISensor* newSensor(PGSettings gsettings);
+    static ISensor* newDutyCycle(Autobright *self, ISensor *sensor);
+    static void updateDutyCycle(Autobright *self);
+    static IFilter* newBaseFilter(GSettings *gsettings);
+    static IFilter* newFilter(PGSettings gsettings);
+    static void setFilter(Autobright *self, IFilter *filter);
+    static CurvePoints getCurve(GSettings *gsettings, const char *key);
+    static void updateCurve(Autobright *self, const char *key);
+    static void updateRamp(Autobright *self);
+    static void updateDeadBand(Autobright *self);
+    static void onSettingsChanged(Autobright *self, const char *key);
+    static void onQuiescenceChanged(Autobright *self);
+    static void onResumed(Autobright *self);
+    static void startResume(Autobright *self);
+    static void applyAtOnce(Autobright *self, int normalized, gint64 now);
     static void onLightLevelChanged(Autobright *self);
+    static void onFilterTimeout(Autobright *self);
+    static void scheduleFilter(Autobright *self);
 };
 
-inline static int normalizeLux(double lux) {
-  return lux < 1 ? 0 : round(log10(lux) / 3 * 100);
+static void gOnSettingsChanged(
+    GSettings *settings,
+    const gchar *key,
+    gpointer user_data) {
+  Autobright *self = (Autobright*) user_data;
+  AutobrightPrivate::onSettingsChanged(self, key);
+}
+
+static gboolean gOnFilterTimeout(gpointer user_data) {
+  Autobright *self = (Autobright*) user_data;
+  AutobrightPrivate::onFilterTimeout(self);
+  return G_SOURCE_REMOVE;
+}
+
+IBrightnessProxy* AutobrightPrivate::newBrightness(PGSettings gsettings) {
+  if (!gsettings)
+    return new BrightnessProxy();
+
+  GSettings *s = gsettings.get();
+  switch (g_settings_get_enum(s, "brightness-backend")) {
+    case SYSFS: {
+      gchar *root = g_settings_get_string(s, "backlight-root");
+      IBrightnessProxy *proxy = new SysfsBacklight(root);
+      g_free(root);
+      LOGGER(logger) << "Using sysfs brightness backend" << endl;
+      return proxy;
+    }
+    case LOGIND: {
+      gchar *root = g_settings_get_string(s, "backlight-root");
+      IBrightnessProxy *proxy = new LogindBacklight(root);
+      g_free(root);
+      LOGGER(logger) << "Using logind brightness backend" << endl;
+      return proxy;
+    }
+    default:
+      return new BrightnessProxy();
+  }
+}
+
+IBrightnessProxy* AutobrightPrivate::newKeyboard(GSettings *s) {
+  switch (g_settings_get_enum(s, "keyboard-backend")) {
+    case KEYBOARD_GSD:
+      LOGGER(logger) << "Using gsd keyboard backend" << endl;
+      return new BrightnessProxy(BrightnessProxy::KEYBOARD);
+    case KEYBOARD_SYSFS: {
+      gchar *root = g_settings_get_string(s, "keyboard-root");
+      IBrightnessProxy *proxy = new SysfsBacklight(
+          root,
+          SysfsBacklight::KEYBOARD_PATTERN);
+      g_free(root);
+      LOGGER(logger) << "Using sysfs keyboard backend" << endl;
+      return proxy;
+    }
+    default:
+      return nullptr;
+  }
+}
+
+void AutobrightPrivate::newOutputs(Autobright *self) {
+  IBrightnessProxy *keyboard = newKeyboard(self->gsettings.get());
+  if (keyboard) {
+    /* the session dims the keyboard on idle too, not to be learnt */
+    self->outputs.emplace_back(
+        new Output("keyboard", new IdleAware(keyboard), self->gsettings));
+    updateCurve(self, "keyboard-curve");
+  }
+
+  for (const auto &output : self->outputs) {
+    output->proxy->supervise(&self->supervisor);
+  }
+}
+
+/* outputs are optional, the screen works without them */
+void AutobrightPrivate::connectOutput(Autobright *self, Output *output) {
+  output->proxy->connect().then([=] {
+    LOGGER(logger) << "Connected " << output->name << " output" << endl;
+    output->connected = true;
+    if (self->input.hasUnit())
+      output->adapter.setValueFixed(self->deadBand.getValue());
+  }, [=](exception_ptr ex) {
+    LOGGER_WARN(logger) << "Cannot connect " << output->name
+        << " output: " << ex << endl;
+  });
+}
+
+/* one filter pass drives every output */
+void AutobrightPrivate::setValue(Autobright *self, fixed::Q16 value) {
+  self->adapter.setValueFixed(value);
+  for (const auto &output : self->outputs) {
+    if (output->connected)
+      output->adapter.setValueFixed(value);
+  }
+}
+
+ISensor* AutobrightPrivate::newSource(const char *name, const char *iioRoot) {
+  if (g_str_equal(name, "proxy"))
+    return new SensorProxy();
+  if (g_str_equal(name, "iio"))
+    return new IioSensor("", iioRoot);
+  return new IioSensor(name, iioRoot);
+}
+
+ISensor* AutobrightPrivate::newFusion(
+    GSettings *gsettings,
+    const char *iioRoot) {
+  SensorFusion *fusion = new SensorFusion();
+  fusion->policy = (SensorFusion::Policy) g_settings_get_enum(
+      gsettings, "fusion-policy");
+
+  GVariantIter *iter;
+  const gchar *name;
+  gdouble weight;
+  g_settings_get(gsettings, "fusion-sources", "a(sd)", &iter);
+  while (g_variant_iter_loop(iter, "(&sd)", &name, &weight)) {
+    LOGGER(logger) << "Fusion source: " << name
+        << ", weight: " << weight << endl;
+    fusion->add(newSource(name, iioRoot), weight);
+  }
+  g_variant_iter_free(iter);
+
+  return fusion;
 }
 
-inline static int normalizeLightLevel(double lightLevel, Unit unit) {
-  switch (unit) {
-    case Unit::VENDOR:
-      return lightLevel;
-    case Unit::LUX:
-      return normalizeLux(lightLevel);
+ISensor* AutobrightPrivate::newSensor(PGSettings gsettings) {
+  if (!gsettings)
+    return new SensorProxy();
+
+  GSettings *s = gsettings.get();
+  gchar *iioRoot = g_settings_get_string(s, "iio-root");
+  ISensor *sensor;
+  switch (g_settings_get_enum(s, "sensor-backend")) {
+    case IIO:
+      LOGGER(logger) << "Using iio sensor backend" << endl;
+      sensor = newSource("iio", iioRoot);
+      break;
+    case FUSION:
+      LOGGER(logger) << "Using fusion sensor backend" << endl;
+      sensor = newFusion(s, iioRoot);
+      break;
     default:
-      throw invalid_argument("Unknown unit");
+      sensor = new SensorProxy();
+      break;
+  }
+  g_free(iioRoot);
+  return sensor;
+}
+
+ISensor* AutobrightPrivate::newDutyCycle(Autobright *self, ISensor *sensor) {
+  self->dutyCycle = new DutyCycle(sensor);
+  if (self->gsettings)
+    updateDutyCycle(self);
+  return self->dutyCycle;
+}
+
+void AutobrightPrivate::updateDutyCycle(Autobright *self) {
+  GSettings *s = self->gsettings.get();
+  self->dutyCycle->stableTime = g_settings_get_uint(
+      s, "duty-cycle-stable-time");
+  self->dutyCycle->maxInterval = g_settings_get_uint(
+      s, "duty-cycle-max-interval");
+  self->dutyCycle->setEnabled(g_settings_get_boolean(s, "duty-cycle"));
+}
+
+IFilter* AutobrightPrivate::newBaseFilter(GSettings *s) {
+  long timeConstant = g_settings_get_uint(s, "filter-time-constant");
+  long interval = g_settings_get_uint(s, "filter-interval");
+  switch (g_settings_get_enum(s, "filter")) {
+    case EMA: {
+      EmaFilter *filter = new EmaFilter();
+      filter->timeConstant = timeConstant;
+      return filter;
+    }
+    case MEDIAN: {
+      MedianFilter *filter = new MedianFilter(
+          g_settings_get_uint(s, "median-window"));
+      filter->interval = interval;
+      return filter;
+    }
+    case KALMAN: {
+      KalmanFilter *filter = new KalmanFilter();
+      filter->processNoise = g_settings_get_double(s, "kalman-process-noise");
+      filter->measurementNoise = g_settings_get_double(
+          s, "kalman-measurement-noise");
+      filter->interval = interval;
+      return filter;
+    }
+    case HYSTERESIS: {
+      HysteresisFilter *filter = new HysteresisFilter();
+      filter->threshold = g_settings_get_uint(s, "hysteresis-threshold");
+      return filter;
+    }
+    default: {
+      PressureFilter *filter = new PressureFilter();
+      filter->timeConstant = timeConstant;
+      return filter;
+    }
+  }
+}
+
+IFilter* AutobrightPrivate::newFilter(PGSettings gsettings) {
+  if (!gsettings)
+    return new PressureFilter();
+
+  GSettings *s = gsettings.get();
+  IFilter *filter = newBaseFilter(s);
+  int threshold = g_settings_get_uint(s, "fast-path-threshold");
+  if (threshold) {
+    FastPathFilter *fastPath = new FastPathFilter(filter);
+    fastPath->threshold = threshold;
+    fastPath->confirmTime = g_settings_get_uint(s, "fast-path-confirm");
+    filter = fastPath;
+  }
+
+  long lead = g_settings_get_uint(s, "predictor-lead");
+  if (lead) {
+    PredictiveFilter *predictive = new PredictiveFilter(filter);
+    predictive->leadTime = lead;
+    predictive->window = g_settings_get_uint(s, "predictor-window");
+    predictive->limit = g_settings_get_uint(s, "predictor-limit");
+    filter = predictive;
+  }
+  return filter;
+}
+
+/* the new filter starts from the current value */
+void AutobrightPrivate::setFilter(Autobright *self, IFilter *filter) {
+  filter->setValue(self->filter->getValue());
+  filter->setStep(self->bright.getResolution());
+  self->filter.reset(filter);
+
+  if (self->input.hasUnit())
+    onLightLevelChanged(self);
+  else
+    scheduleFilter(self);
+}
+
+CurvePoints AutobrightPrivate::getCurve(GSettings *gsettings, const char *key) {
+  CurvePoints points;
+  GVariantIter *iter;
+  gdouble x, y;
+  g_settings_get(gsettings, key, "a(dd)", &iter);
+  while (g_variant_iter_loop(iter, "(dd)", &x, &y)) {
+    points.push_back({ x, y });
+  }
+  g_variant_iter_free(iter);
+  return points;
+}
+
+/* invalid curves are ignored, keeping the current one */
+void AutobrightPrivate::updateCurve(Autobright *self, const char *key) {
+  try {
+    CurvePoints points = getCurve(self->gsettings.get(), key);
+    if (g_str_equal(key, "input-curve")) {
+      InputCurve curve(points);
+      self->input.setCurve(curve);
+      self->dutyCycle->setCurve(curve);
+    } else if (g_str_equal(key, "output-curve")) {
+      self->adapter.setCurve(OutputCurve(points));
+    } else {
+      for (const auto &output : self->outputs) {
+        if (output->name + "-curve" == key)
+          output->adapter.setCurve(OutputCurve(points));
+      }
+    }
+  } catch (const exception &e) {
+    LOGGER_ERROR(logger) << "Invalid " << key << ": " << e.what() << endl;
+  }
+}
+
+void AutobrightPrivate::updateRamp(Autobright *self) {
+  GSettings *s = self->gsettings.get();
+  self->ramp.rate = g_settings_get_double(s, "ramp-rate");
+  self->ramp.interval = g_settings_get_uint(s, "ramp-interval");
+}
+
+void AutobrightPrivate::updateDeadBand(Autobright *self) {
+  GSettings *s = self->gsettings.get();
+  self->deadBand.up = fixed::fromDouble(
+      g_settings_get_double(s, "dead-band-up"));
+  self->deadBand.down = fixed::fromDouble(
+      g_settings_get_double(s, "dead-band-down"));
+  self->deadBand.dwell = g_settings_get_uint(s, "dead-band-dwell");
+}
+
+void AutobrightPrivate::onSettingsChanged(Autobright *self, const char *key) {
+  if (g_str_equal(key, "ramp-rate") || g_str_equal(key, "ramp-interval")) {
+    updateRamp(self);
+    return;
+  }
+
+  if (g_str_has_prefix(key, "dead-band-")) {
+    updateDeadBand(self);
+    scheduleFilter(self);
+    return;
+  }
+
+  if (g_str_equal(key, "resume-window")) {
+    self->resumeWindow = g_settings_get_uint(self->gsettings.get(), key);
+    return;
   }
+
+  if (g_str_has_prefix(key, "duty-cycle")) {
+    updateDutyCycle(self);
+    return;
+  }
+
+  if (g_str_equal(key, "quiescence")) {
+    self->quiescence.setEnabled(
+        g_settings_get_boolean(self->gsettings.get(), key));
+    return;
+  }
+
+  if (g_str_has_suffix(key, "-curve")) {
+    updateCurve(self, key);
+    return;
+  }
+
+  for (const char *filterKey : FILTER_KEYS) {
+    if (g_str_equal(key, filterKey)) {
+      LOGGER(logger) << "Filter settings changed: " << key << endl;
+      setFilter(self, newFilter(self->gsettings));
+      return;
+    }
+  }
+}
+
+/* the pipeline is paused while quiescent, filters catch up on resume */
+void AutobrightPrivate::onQuiescenceChanged(Autobright *self) {
+  if (self->quiescence.isQuiescent()) {
+    scheduleFilter(self);
+    return;
+  }
+
+  if (self->input.hasUnit())
+    onLightLevelChanged(self);
+  else
+    scheduleFilter(self);
+
+  /* the sample above was taken before sleep, the window is open before
+   * the sensor resumes and sends a fresh one */
+  if (self->resuming)
+    startResume(self);
+}
+
+/* the sensor is claimed again once the pipeline runs, maybe after unlock */
+void AutobrightPrivate::onResumed(Autobright *self) {
+  if (self->resumeWindow <= 0)
+    return;
+
+  self->resuming = true;
+  self->resumedAt = 0;
+  if (!self->quiescence.isQuiescent())
+    startResume(self);
+}
+
+void AutobrightPrivate::startResume(Autobright *self) {
+  self->resumedAt = g_get_monotonic_time();
+  LOGGER(logger) << "Resumed, next sample is applied at once" << endl;
+}
+
+/* skip filter accumulation, dead band and ramp: one write */
+void AutobrightPrivate::applyAtOnce(
+    Autobright *self,
+    int normalized,
+    gint64 now) {
+  self->resuming = false;
+  self->resumeTime = (now - self->resumedAt) / 1000;
+  self->filter->setValue(normalized);
+  self->deadBand.setValue(self->filter->getFixed());
+  self->timeToTarget.update(normalized, normalized, now);
+
+  /* only for this value, the adapter may not write it at all */
+  self->ramp.setAtOnce(true);
+  setValue(self, self->deadBand.getValue());
+  self->ramp.setAtOnce(false);
+  scheduleFilter(self);
+
+  LOGGER(logger) << "Applied at once: " << normalized
+      << ", after resume: " << self->resumeTime << "ms" << endl;
 }
 
 void AutobrightPrivate::onLightLevelChanged(Autobright *self) {
-  if (!self->sensor.hasUnit())
+  if (self->quiescence.isQuiescent())
     return;
 
-  double lightLevel = self->sensor.getLightLevel();
-  Unit unit = self->sensor.getUnit();
-  int normalized = normalizeLightLevel(lightLevel, unit);
-  self->normalized = normalized;
-  int filtered = self->filter.filter(normalized);
-  self->adapter.setValue(filtered);
+  double lightLevel = self->input.getLightLevel();
+  int normalized = self->input.getNormalized();
+  gint64 now = g_get_monotonic_time();
+
+  if (self->resuming && self->resumedAt) {
+    if (now - self->resumedAt <= self->resumeWindow * 1000) {
+      applyAtOnce(self, normalized, now);
+      return;
+    }
+    self->resuming = false;
+  }
+  int filtered = self->filter->filter(normalized, now);
+  self->timeToTarget.update(normalized, filtered, now);
+  setValue(self, self->deadBand.filter(self->filter->getFixed(), now));
+  scheduleFilter(self);
 
   LOGGER_DEBUG(logger) << "Light Level Changed: " << lightLevel
       << ", normalized: " << normalized
@@ -46,38 +504,126 @@ void AutobrightPrivate::onLightLevelChanged(Autobright *self) {
       << endl;
 }
 
+/* input held constant, filter value changes with time */
+void AutobrightPrivate::onFilterTimeout(Autobright *self) {
+  self->filterId = 0;
+  gint64 now = g_get_monotonic_time();
+  int filtered = self->filter->update(now);
+  self->timeToTarget.update(self->input.getNormalized(), filtered, now);
+  setValue(self, self->deadBand.filter(self->filter->getFixed(), now));
+  scheduleFilter(self);
+
+  LOGGER_DEBUG(logger) << "Filter updated: " << filtered << endl;
+}
+
+void AutobrightPrivate::scheduleFilter(Autobright *self) {
+  if (self->filterId) {
+    g_source_remove(self->filterId);
+    self->filterId = 0;
+  }
+
+  if (self->quiescence.isQuiescent())
+    return;
+
+  /* also wake up when the dead band lets a held value through */
+  long delay = self->filter->nextUpdate();
+  long held = self->deadBand.nextUpdate(g_get_monotonic_time());
+  if (held >= 0 && (delay < 0 || held < delay))
+    delay = held;
+  if (delay >= 0)
+    self->filterId = g_timeout_add(delay, gOnFilterTimeout, self);
+}
+
 Autobright::Autobright(PGSettings gsettings) :
-    bright(),
-    adapter(&bright),
+    gsettings(gsettings),
+    bright(AutobrightPrivate::newBrightness(gsettings)),
+    ramp(&bright),
+    adapter(&ramp),
     settings(&adapter, gsettings),
-    sensor(),
-    filter(),
-    lightLevelChanged(sensor.lightLevelChanged),
+    input(AutobrightPrivate::newDutyCycle(
+        this,
+        AutobrightPrivate::newSensor(gsettings))),
+    filter(AutobrightPrivate::newFilter(gsettings)),
+    quiescence(&input, &presence),
+    supervisor(),
+    lightLevelChanged(input.lightLevelChanged),
     brightnessChanged(bright.brightnessChanged) {
 
-  llchid = sensor.lightLevelChanged << [=] {
+  /* echoes of the screen writes are absorbed by the ramp */
+  adapter.echoWindow = 0;
+
+  if (gsettings) {
+    GSettings *s = gsettings.get();
+    input.maxRate = g_settings_get_double(s, "max-sample-rate");
+    AutobrightPrivate::updateCurve(this, "input-curve");
+    AutobrightPrivate::updateCurve(this, "output-curve");
+    AutobrightPrivate::updateRamp(this);
+    AutobrightPrivate::updateDeadBand(this);
+    AutobrightPrivate::newOutputs(this);
+    quiescence.setEnabled(g_settings_get_boolean(s, "quiescence"));
+    resumeWindow = g_settings_get_uint(s, "resume-window");
+    g_signal_connect(
+        s,
+        "changed",
+        G_CALLBACK(gOnSettingsChanged),
+        this);
+  }
+
+  llchid = input.lightLevelChanged << [=] {
     AutobrightPrivate::onLightLevelChanged(this);
   };
+
+  quiescence.changed << [=] {
+    AutobrightPrivate::onQuiescenceChanged(this);
+  };
+  bright.inactiveChanged << [=] {
+    presence.setUserIdle(bright.isInactive());
+  };
+  presence.resumed << [=] {
+    AutobrightPrivate::onResumed(this);
+  };
+
+  bright.supervise(&supervisor);
+  input.supervise(&supervisor);
+  presence.supervise(&supervisor);
 }
 
 Autobright::~Autobright() {
-  sensor.lightLevelChanged.remove(llchid);
+  input.lightLevelChanged.remove(llchid);
+  if (gsettings)
+    g_signal_handlers_disconnect_by_data(gsettings.get(), this);
+  if (filterId)
+    g_source_remove(filterId);
 }
 
 Promise<void> Autobright::connect() {
+  for (const auto &output : outputs) {
+    AutobrightPrivate::connectOutput(this, output.get());
+  }
+
   return bright.connect() << [=] {
-    filter.setValue(adapter.getValue());
-    return sensor.connect();
+    filter->setValue(adapter.getValue());
+    deadBand.setValue(adapter.getValueFixed());
+    filter->setStep(bright.getResolution());
+    return input.connect();
+  } << [=] {
+    return presence.connect();
   };
 }
 
 void Autobright::updateDebugInfo(DebugInfo *info) const {
-  info->unit = sensor.getUnit();
-  info->lightLevel = sensor.getLightLevel();
-  info->normalized = normalized;
+  input.updateDebugInfo(info);
   info->value = adapter.getValue();
   info->offset = adapter.getOffset();
+  info->echoes = ramp.getStats().echoes;
+  info->adjustments = adapter.getStats().adjustments;
   info->brightness = bright.getBrightness();
-  filter.updateDebugInfo(info);
+  filter->updateDebugInfo(info);
+  info->timeToTarget = timeToTarget.last;
+  info->valueChangesPerHour = deadBand.changesPerHour();
+  quiescence.updateDebugInfo(info);
+  dutyCycle->updateDebugInfo(info);
+  info->resumeTime = resumeTime;
+  ramp.updateDebugInfo(info);
   bright.updateDebugInfo(info);
 }
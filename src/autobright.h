@@ -2,30 +2,68 @@
 #define AUTOBRIGHT_H_
 
 #include "idle-aware.h"
+#include "ramp.h"
 #include "adapter.h"
 #include "settings.h"
+#include <memory>
+#include <vector>
+
 #include "sensor.h"
+#include "conditioner.h"
+#include "duty-cycle.h"
 #include "filter.h"
 #include "signals.h"
 #include "gsettings.h"
 #include "promise.h"
 #include "debug-info.h"
+#include "supervisor.h"
+#include "presence.h"
+#include "quiescence.h"
 
 class Autobright {
     friend class AutobrightPrivate;
 
     using PGSettings = gsettings::PGSettings;
 
+    struct Output;
+
+    PGSettings gsettings;
     IdleAware bright;
+    Ramp ramp;
     Adapter adapter;
     Settings settings;
-    SensorProxy sensor;
-    PressureFilter filter;
+
+    /* owned by input, declared first to be set while input is built */
+    DutyCycle *dutyCycle = nullptr;
+    SensorConditioner input;
+    std::unique_ptr<IFilter> filter;
+    DeadBand deadBand;
+    TimeToTarget timeToTarget;
+    Presence presence;
+    Quiescence quiescence;
+
+    /* driven by the same value as the screen, with their own curve and
+     * offsets */
+    std::vector<std::unique_ptr<Output>> outputs;
 
     void *llchid = nullptr;
-    int normalized = 0;
+    guint filterId = 0;
+
+    /* first samples after resume from sleep skip filter and ramp */
+    bool resuming = false;
+    gint64 resumedAt = 0;
+    long resumeTime = -1;
+
+    /* declared last to stop supervising before members are destroyed */
+    Supervisor supervisor;
 
   public:
+    /**
+     * Milliseconds after resume in which samples are applied at once,
+     * 0 to disable.
+     */
+    long resumeWindow = 3000;
+
     signals::Signal<void()> &lightLevelChanged;
     signals::Signal<void()> &brightnessChanged;
 
@@ -2,19 +2,34 @@
 #include "logger.h"
 
 using namespace std;
+using namespace fixed;
 using namespace gdbus;
 using namespace promise;
 using namespace signals;
 
 static const Logger logger("[BrightnessProxy]", Logger::DEBUG);
 
+static const char *SERVICE = "org.gnome.SettingsDaemon.Power";
+
+const char *BrightnessProxy::SCREEN = "org.gnome.SettingsDaemon.Power.Screen";
+const char *BrightnessProxy::KEYBOARD =
+    "org.gnome.SettingsDaemon.Power.Keyboard";
+
+static const Getter<int> brightnessGetter { "Brightness" };
+
 static const Setter<int> brightnessSetter { "Brightness", "i" };
 
 struct BrightnessProxyPrivate {
     static void setProxy(BrightnessProxy *self, PGDBusProxy proxy);
     static void setBrightness(BrightnessProxy *self, int value);
+    static void setSteps(BrightnessProxy *self, int value);
     static Promise<void> ensureProxy(BrightnessProxy *self);
     static Promise<void> ensureBrightness(BrightnessProxy *self);
+    static void write(BrightnessProxy *self, int value);
+    static void onWritten(
+        BrightnessProxy *self,
+        int value,
+        const exception_ptr &ex);
 };
 
 struct ResolveOnEmit {
@@ -27,16 +42,20 @@ struct ResolveOnEmit {
     }
 };
 
-static Promise<PGDBusProxy> newProxy() {
+static Promise<PGDBusProxy> newProxy(const char *interface) {
   return newForBus(
       G_BUS_TYPE_SESSION,
-      "org.gnome.SettingsDaemon.Power",
+      SERVICE,
       "/org/gnome/SettingsDaemon/Power",
-      "org.gnome.SettingsDaemon.Power.Screen",
+      interface,
       G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START);
 }
 
 inline static void updateBrightness(BrightnessProxy *self, GDBusProxy *proxy) {
+  PUGVariant steps(g_dbus_proxy_get_cached_property(proxy, "Steps"));
+  if (steps)
+    BrightnessProxyPrivate::setSteps(self, g_variant_get_int32(steps.get()));
+
   PUGVariant brightness(g_dbus_proxy_get_cached_property(proxy, "Brightness"));
   if (brightness) {
     int value = g_variant_get_int32(brightness.get());
@@ -84,11 +103,15 @@ void BrightnessProxyPrivate::setBrightness(BrightnessProxy *self, int value) {
   self->brightnessChanged();
 }
 
+void BrightnessProxyPrivate::setSteps(BrightnessProxy *self, int value) {
+  self->steps = value;
+}
+
 Promise<void> BrightnessProxyPrivate::ensureProxy(BrightnessProxy *self) {
   if (self->proxy)
     return resolved();
 
-  return newProxy() << [=](PGDBusProxy proxy) {
+  return newProxy(self->interface) << [=](PGDBusProxy proxy) {
     BrightnessProxyPrivate::setProxy(self, proxy);
   };
 }
@@ -107,25 +130,109 @@ Promise<void> BrightnessProxyPrivate::ensureBrightness(BrightnessProxy *self) {
   return promise;
 }
 
+void BrightnessProxyPrivate::write(BrightnessProxy *self, int value) {
+  self->writing = true;
+  brightnessSetter(self->proxy, value).then([=] {
+    onWritten(self, value, nullptr);
+  }, [=](exception_ptr ex) {
+    onWritten(self, value, ex);
+  });
+}
+
+void BrightnessProxyPrivate::onWritten(
+    BrightnessProxy *self,
+    int value,
+    const exception_ptr &ex) {
+  vector<Result<void>> done;
+  done.swap(self->inFlight);
+  int next = self->pending;
+  self->pending = -1;
+  self->writing = false;
+
+  /* start the next write before callbacks can set another value */
+  if (next >= 0 && (ex || next != value)) {
+    /* on failure they wait for the newer value */
+    if (ex) {
+      self->waiting.insert(self->waiting.begin(), done.begin(), done.end());
+      done.clear();
+    }
+    self->inFlight.swap(self->waiting);
+    write(self, next);
+  } else {
+    done.insert(done.end(), self->waiting.begin(), self->waiting.end());
+    self->waiting.clear();
+  }
+
+  for (const Result<void> &result : done) {
+    if (ex)
+      result.reject(ex);
+    else
+      result.resolve();
+  }
+}
+
 Promise<void> BrightnessProxy::pingService() {
-  return newProxy() << [](PGDBusProxy proxy) {
+  return newProxy(SCREEN) << [](PGDBusProxy proxy) {
     return ping(proxy);
   };
 }
 
+BrightnessProxy::BrightnessProxy(const char *interface) :
+    interface(interface) {
+}
+
 Promise<void> BrightnessProxy::connect() {
   return BrightnessProxyPrivate::ensureProxy(this) << [=] {
     return BrightnessProxyPrivate::ensureBrightness(this);
   };
 }
 
+Promise<void> BrightnessProxy::reconnect() {
+  return BrightnessProxyPrivate::ensureProxy(this) << [=] {
+    return brightnessGetter(proxy);
+  } << [=](int value) -> Promise<void> {
+    BrightnessProxyPrivate::setBrightness(this, value);
+    if (target < 0)
+      return resolved();
+    return setBrightness(target);
+  };
+}
+
+void BrightnessProxy::supervise(Supervisor *supervisor) {
+  supervisor->watch(G_BUS_TYPE_SESSION, SERVICE, [=] {
+    return reconnect();
+  });
+}
+
 Promise<void> BrightnessProxy::setBrightness(int value) {
+  target = value;
+
+  Result<void> result;
+  Promise<void> promise = result;
+  if (writing) {
+    if (pending >= 0) {
+      LOGGER_DEBUG(logger) << "Replacing pending brightness: " << pending
+          << ", with: " << value << endl;
+    }
+    pending = value;
+    waiting.push_back(result);
+    return promise;
+  }
+
   if (brightness == value)
     return resolved();
 
-  return brightnessSetter(proxy, value);
+  inFlight.push_back(result);
+  BrightnessProxyPrivate::write(this, value);
+  return promise;
 }
 
 int BrightnessProxy::getBrightness() const {
   return brightness;
 }
+
+Q16 BrightnessProxy::getResolution() const {
+  if (steps < 2)
+    return ONE;
+  return (fromInt(100) + steps - 2) / (steps - 1);
+}
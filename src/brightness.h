@@ -1,9 +1,13 @@
 #ifndef BRIGHTNESS_H_
 #define BRIGHTNESS_H_
 
+#include <vector>
+
+#include "fixed.h"
 #include "gdbus.h"
 #include "promise.h"
 #include "signals.h"
+#include "supervisor.h"
 
 struct IBrightnessProxy {
     signals::Signal<void()> brightnessChanged;
@@ -12,15 +16,54 @@ struct IBrightnessProxy {
     virtual promise::Promise<void> connect() = 0;
     virtual promise::Promise<void> setBrightness(int) = 0;
     virtual int getBrightness() const = 0;
+
+    /**
+     * Brightness in Q16 percent, backends finer than 1% quantize it
+     * to their own resolution.
+     */
+    virtual promise::Promise<void> setBrightnessFixed(fixed::Q16 value) {
+      return setBrightness(fixed::toInt(value));
+    }
+
+    virtual fixed::Q16 getBrightnessFixed() const {
+      return fixed::fromInt(getBrightness());
+    }
+
+    /**
+     * Smallest brightness change the backend can apply, in Q16 percent.
+     */
+    virtual fixed::Q16 getResolution() const {
+      return fixed::ONE;
+    }
+
+    /**
+     * Reconnect when the service restarts, if any.
+     * Supervisor must not outlive this.
+     */
+    virtual void supervise(Supervisor*) {
+    }
 };
 
 class BrightnessProxy: public IBrightnessProxy {
     friend class BrightnessProxyPrivate;
 
+    const char *interface;
     gdbus::PGDBusProxy proxy;
     int brightness = -1;
+    int target = -1;
+
+    /* levels of the keyboard backlight, zero when not published */
+    int steps = 0;
+
+    /* at most one Set in flight, newer values wait in a single slot */
+    bool writing = false;
+    int pending = -1;
+    std::vector<promise::Result<void>> inFlight;
+    std::vector<promise::Result<void>> waiting;
 
   public:
+    static const char *SCREEN;
+    static const char *KEYBOARD;
 
     /**
      * Ping the service.
@@ -28,9 +71,33 @@ class BrightnessProxy: public IBrightnessProxy {
      */
     static promise::Promise<void> pingService();
 
+    /**
+     * Interface of the gnome-settings-daemon power object to use,
+     * SCREEN or KEYBOARD.
+     */
+    BrightnessProxy(const char *interface = SCREEN);
+
     promise::Promise<void> connect();
+
+    /**
+     * Refresh brightness and apply the last value set again,
+     * for example after a service restart.
+     */
+    promise::Promise<void> reconnect();
+
+    void supervise(Supervisor*);
+
+    /**
+     * Resolves when the value, or a newer one, is applied.
+     */
     promise::Promise<void> setBrightness(int);
     int getBrightness() const;
+
+    /**
+     * One of the Steps published by the keyboard interface,
+     * the service rounds the percentage set to them.
+     */
+    fixed::Q16 getResolution() const;
 };
 
 #endif /* BRIGHTNESS_H_ */
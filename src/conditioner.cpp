@@ -0,0 +1,165 @@
+#include "conditioner.h"
+
+using namespace std;
+using namespace promise;
+
+using Unit = ISensor::Unit;
+
+struct SensorConditionerPrivate {
+    static void onSample(SensorConditioner *self);
+    static void onTimeout(SensorConditioner *self);
+    static void process(SensorConditioner *self, int normalized);
+    static int normalize(SensorConditioner *self);
+    static gint64 interval(SensorConditioner *self);
+};
+
+static gboolean gOnTimeout(gpointer user_data) {
+  SensorConditioner *self = (SensorConditioner*) user_data;
+  SensorConditionerPrivate::onTimeout(self);
+  return G_SOURCE_REMOVE;
+}
+
+inline int SensorConditionerPrivate::normalize(SensorConditioner *self) {
+  ISensor *sensor = self->sensor.get();
+  return ISensor::normalize(
+      sensor->getLightLevel(),
+      sensor->getUnit(),
+      self->curve);
+}
+
+inline gint64 SensorConditionerPrivate::interval(SensorConditioner *self) {
+  return self->maxRate > 0 ? 1000000 / self->maxRate : 0;
+}
+
+void SensorConditionerPrivate::onSample(SensorConditioner *self) {
+  self->stats.samples++;
+
+  if (!self->sensor->hasUnit())
+    return;
+
+  /* waiting, the latest sample is taken on timeout */
+  if (self->timerId) {
+    if (self->pending)
+      self->stats.coalesced++;
+    self->pending = true;
+    return;
+  }
+
+  int normalized = normalize(self);
+  if (normalized == self->normalized
+      && self->sensor->getUnit() == self->unit) {
+    self->stats.suppressed++;
+    return;
+  }
+
+  gint64 wait = self->last + interval(self) - g_get_monotonic_time();
+  if (self->last && wait > 0) {
+    self->pending = true;
+    self->timerId = g_timeout_add((wait + 999) / 1000, gOnTimeout, self);
+    return;
+  }
+
+  process(self, normalized);
+}
+
+void SensorConditionerPrivate::onTimeout(SensorConditioner *self) {
+  self->timerId = 0;
+
+  if (!self->pending)
+    return;
+
+  self->pending = false;
+
+  int normalized = normalize(self);
+  if (normalized == self->normalized
+      && self->sensor->getUnit() == self->unit) {
+    self->stats.suppressed++;
+    return;
+  }
+
+  process(self, normalized);
+}
+
+void SensorConditionerPrivate::process(
+    SensorConditioner *self,
+    int normalized) {
+  self->lightLevel = self->sensor->getLightLevel();
+  self->unit = self->sensor->getUnit();
+  self->normalized = normalized;
+  self->last = g_get_monotonic_time();
+  self->stats.processed++;
+  self->lightLevelChanged();
+}
+
+SensorConditioner::SensorConditioner(ISensor *sensor) :
+    sensor(sensor) {
+  handlerId = sensor->lightLevelChanged << [=] {
+    SensorConditionerPrivate::onSample(this);
+  };
+}
+
+SensorConditioner::~SensorConditioner() {
+  sensor->lightLevelChanged.remove(handlerId);
+  if (timerId)
+    g_source_remove(timerId);
+}
+
+Promise<void> SensorConditioner::connect() {
+  return sensor->connect() << [=] {
+    if (!timerId && normalized < 0 && sensor->hasUnit()) {
+      SensorConditionerPrivate::process(
+          this,
+          SensorConditionerPrivate::normalize(this));
+    }
+  };
+}
+
+void SensorConditioner::supervise(Supervisor *supervisor) {
+  sensor->supervise(supervisor);
+}
+
+Promise<void> SensorConditioner::suspend() {
+  return sensor->suspend();
+}
+
+Promise<void> SensorConditioner::resume() {
+  return sensor->resume();
+}
+
+double SensorConditioner::getLightLevel() const {
+  return lightLevel;
+}
+
+Unit SensorConditioner::getUnit() const {
+  return unit;
+}
+
+int SensorConditioner::getNormalized() const {
+  return normalized < 0 ? 0 : normalized;
+}
+
+const SensorConditioner::Stats& SensorConditioner::getStats() const {
+  return stats;
+}
+
+void SensorConditioner::setCurve(const InputCurve &curve) {
+  this->curve = curve;
+
+  /* a pending sample is normalized on timeout */
+  if (timerId || normalized < 0 || !sensor->hasUnit())
+    return;
+
+  int normalized = SensorConditionerPrivate::normalize(this);
+  if (normalized != this->normalized)
+    SensorConditionerPrivate::process(this, normalized);
+}
+
+void SensorConditioner::updateDebugInfo(DebugInfo *info) const {
+  info->unit = unit;
+  info->lightLevel = lightLevel;
+  info->normalized = getNormalized();
+  info->samples = stats.samples;
+  info->suppressed = stats.suppressed;
+  info->coalesced = stats.coalesced;
+  info->processed = stats.processed;
+}
@@ -0,0 +1,79 @@
+#ifndef CONDITIONER_H_
+#define CONDITIONER_H_
+
+#include <memory>
+#include <glib.h>
+
+#include "sensor.h"
+#include "curve.h"
+#include "debug-info.h"
+
+/**
+ * Input stage ahead of the filters.
+ * Samples that do not change the normalized light level are dropped,
+ * the others are processed at most at max rate, keeping the latest
+ * sample when they come faster.
+ */
+class SensorConditioner: public ISensor {
+    friend class SensorConditionerPrivate;
+
+  public:
+    struct Stats {
+        unsigned long long samples = 0;
+        unsigned long long suppressed = 0;
+        unsigned long long coalesced = 0;
+        unsigned long long processed = 0;
+    };
+
+  private:
+    std::unique_ptr<ISensor> sensor;
+    void *handlerId = nullptr;
+    InputCurve curve;
+
+    double lightLevel = 0;
+    Unit unit = UNKNOWN;
+    int normalized = -1;
+
+    gint64 last = 0;
+    guint timerId = 0;
+    bool pending = false;
+    Stats stats;
+
+  public:
+    /**
+     * Max processed samples per second, 0 for no limit.
+     */
+    double maxRate = 10;
+
+    SensorConditioner(ISensor *sensor);
+    SensorConditioner(const SensorConditioner&) = delete;
+    SensorConditioner& operator=(const SensorConditioner&) = delete;
+    ~SensorConditioner();
+
+    promise::Promise<void> connect();
+
+    void supervise(Supervisor*);
+
+    promise::Promise<void> suspend();
+    promise::Promise<void> resume();
+
+    double getLightLevel() const;
+    Unit getUnit() const;
+
+    /**
+     * Light level of the last processed sample, from 0 to 100.
+     */
+    int getNormalized() const;
+
+    const Stats& getStats() const;
+
+    /**
+     * Curve used to normalize lux, the current sample is normalized
+     * again with the new curve.
+     */
+    void setCurve(const InputCurve&);
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+#endif /* CONDITIONER_H_ */
@@ -0,0 +1,141 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "curve.h"
+
+using namespace std;
+using namespace fixed;
+
+/* lux from 2^-5 to 2^17, 16 steps per octave */
+static const int MIN_EXP = -4;
+static const int MAX_EXP = 18;
+static const int STEPS = 16;
+
+const CurvePoints InputCurve::DEFAULT_POINTS = { { 1, 0 }, { 1000, 100 } };
+const CurvePoints OutputCurve::DEFAULT_POINTS = { { 0, 0 }, { 100, 100 } };
+
+inline static int clamp(int value, int min, int max) {
+  if (value < min)
+    return min;
+  if (value > max)
+    return max;
+  return value;
+}
+
+static void validate(const CurvePoints &points) {
+  if (points.empty())
+    throw invalid_argument("Curve has no points");
+  for (size_t i = 1; i < points.size(); i++) {
+    if (points[i].first <= points[i - 1].first)
+      throw invalid_argument("Curve points not increasing");
+  }
+}
+
+/* y at x, with x mapped by scale before interpolating */
+static double interpolate(
+    const CurvePoints &points,
+    double x,
+    double (*scale)(double)) {
+  if (x <= points.front().first)
+    return points.front().second;
+  if (x >= points.back().first)
+    return points.back().second;
+
+  size_t i = 1;
+  while (points[i].first < x)
+    i++;
+
+  const auto &a = points[i - 1];
+  const auto &b = points[i];
+  double t = (scale(x) - scale(a.first)) / (scale(b.first) - scale(a.first));
+  return a.second + t * (b.second - a.second);
+}
+
+static double linear(double x) {
+  return x;
+}
+
+InputCurve::InputCurve(const CurvePoints &points) {
+  validate(points);
+  for (const auto &point : points) {
+    if (point.first <= 0)
+      throw invalid_argument("Curve lux not positive");
+  }
+
+  table.resize((MAX_EXP - MIN_EXP) * STEPS + 1);
+  for (size_t i = 0; i < table.size(); i++) {
+    int e = MIN_EXP + i / STEPS;
+    double lux = ldexp(0.5 + (i % STEPS) * 0.5 / STEPS, e);
+    table[i] = interpolate(points, lux, log10);
+  }
+}
+
+int InputCurve::map(double lux) const {
+  int e;
+  double m = frexp(lux, &e);
+  if (e < MIN_EXP || lux <= 0)
+    return clamp(round(table.front()), 0, 100);
+  if (e >= MAX_EXP)
+    return clamp(round(table.back()), 0, 100);
+
+  double position = (m - 0.5) * 2 * STEPS;
+  int step = position;
+  size_t i = (e - MIN_EXP) * STEPS + step;
+  double t = position - step;
+  double value = table[i] + t * (table[i + 1] - table[i]);
+  return clamp(round(value), 0, 100);
+}
+
+const InputCurve& InputCurve::standard() {
+  static const InputCurve curve;
+  return curve;
+}
+
+OutputCurve::OutputCurve(const CurvePoints &points) {
+  validate(points);
+  bool falling = points.back().second < points.front().second;
+  for (size_t i = 1; i < points.size(); i++) {
+    double d = points[i].second - points[i - 1].second;
+    if (falling ? d > 0 : d < 0)
+      throw invalid_argument("Curve brightness not monotonic");
+  }
+
+  table.resize(101);
+  for (int level = 0; level <= 100; level++) {
+    double brightness = interpolate(points, level, linear);
+    table[level] = clamp(fromDouble(brightness), 0, fromInt(100));
+  }
+
+  /* levels mapped to each brightness, or to the nearest one,
+   * falling curves are walked from the last level */
+  auto at = [&](int level) {
+    return map(falling ? 100 - level : level);
+  };
+  inverseTable.resize(101);
+  int level = 0;
+  for (int brightness = 0; brightness <= 100; brightness++) {
+    while (level < 100 && at(level) < brightness)
+      level++;
+    int below = level > 0 ? brightness - at(level - 1) : -1;
+    int found = level;
+    if (below >= 0 && below <= at(level) - brightness)
+      found = level - 1;
+    inverseTable[brightness] = falling ? 100 - found : found;
+  }
+}
+
+int OutputCurve::map(int level) const {
+  return toInt(table[clamp(level, 0, 100)]);
+}
+
+Q16 OutputCurve::mapFixed(Q16 level) const {
+  level = clamp(level, 0, fromInt(100));
+  int i = level >> SHIFT;
+  if (i == 100)
+    return table[i];
+  return lerp(table[i], table[i + 1], level & (ONE - 1));
+}
+
+int OutputCurve::inverse(int brightness) const {
+  return inverseTable[clamp(brightness, 0, 100)];
+}
@@ -0,0 +1,73 @@
+#ifndef CURVE_H_
+#define CURVE_H_
+
+#include <utility>
+#include <vector>
+
+#include "fixed.h"
+
+/**
+ * Control points of a piecewise linear curve, x strictly increasing.
+ * The curve is flat before the first and after the last point.
+ */
+using CurvePoints = std::vector<std::pair<double, double>>;
+
+/**
+ * Maps light levels in lux to normalized levels from 0 to 100.
+ * Points are interpolated on a log scale of lux, so the default points
+ * (1, 0) and (1000, 100) give a straight log curve, flat at 100 above
+ * 1000 lux where the former mapping kept growing, to 133 at 10000 lux.
+ * The curve is compiled into a table indexed by the binary exponent
+ * and mantissa of the light level.
+ */
+class InputCurve {
+    std::vector<float> table;
+
+  public:
+    static const CurvePoints DEFAULT_POINTS;
+
+    /**
+     * Throws invalid_argument on invalid points.
+     */
+    InputCurve(const CurvePoints &points = DEFAULT_POINTS);
+
+    int map(double lux) const;
+
+    static const InputCurve& standard();
+};
+
+/**
+ * Maps normalized levels to brightness, both from 0 to 100, for
+ * example to follow a perceptual curve.
+ * Brightness must not decrease as level increases, or not increase for
+ * outputs lit in the dark like keyboard backlights, so that the curve
+ * can be inverted to read back levels from brightness.
+ */
+class OutputCurve {
+    std::vector<fixed::Q16> table;
+    std::vector<int> inverseTable;
+
+  public:
+    static const CurvePoints DEFAULT_POINTS;
+
+    /**
+     * Throws invalid_argument on invalid points.
+     */
+    OutputCurve(const CurvePoints &points = DEFAULT_POINTS);
+
+    int map(int level) const;
+
+    /**
+     * Map in Q16, interpolating between table entries.
+     */
+    fixed::Q16 mapFixed(fixed::Q16 level) const;
+
+    /**
+     * Level mapped to the brightness nearest to the given one, the one
+     * nearest to level 0 on rising curves and to level 100 on falling
+     * ones.
+     */
+    int inverse(int brightness) const;
+};
+
+#endif /* CURVE_H_ */
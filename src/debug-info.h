@@ -11,6 +11,22 @@ struct DebugInfo {
     int offset = 0;
     int brightness = 0;
     int flags = 0;
+    unsigned long long samples = 0;
+    unsigned long long suppressed = 0;
+    unsigned long long coalesced = 0;
+    unsigned long long processed = 0;
+    long timeToTarget = -1;
+    unsigned long rampSteps = 0;
+    unsigned long long echoes = 0;
+    unsigned long long adjustments = 0;
+    double valueChangesPerHour = 0;
+    long quiescentTime = 0;
+    unsigned long long wakeupsAvoided = 0;
+    long resumeTime = -1;
+    double dutyCycle = 1;
+    unsigned wakeupsPerMinute = 0;
+    long idleRefreshTime = -1;
+    unsigned long long idleEventsLost = 0;
 };
 
 #endif /* DEBUG_INFO_H_ */
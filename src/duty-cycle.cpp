@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "duty-cycle.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+
+static const Logger logger("[DutyCycle]");
+
+static const gint64 MINUTE = 60 * G_USEC_PER_SEC;
+
+struct DutyCyclePrivate {
+    static int level(DutyCycle *self);
+    static void onSample(DutyCycle *self);
+    static void onTimeout(DutyCycle *self);
+    static void wakeup(DutyCycle *self, gint64 now);
+    static void schedule(DutyCycle *self, long delay);
+    static void cancel(DutyCycle *self);
+    static Promise<void> setRunning(DutyCycle *self, bool running, gint64 now);
+    static void reset(DutyCycle *self, gint64 now);
+    static bool isSteady(DutyCycle *self, gint64 now);
+    static bool isStable(DutyCycle *self, gint64 now);
+    static void sleep(DutyCycle *self, gint64 now);
+    static void read(DutyCycle *self, gint64 now);
+};
+
+static gboolean gOnTimeout(gpointer user_data) {
+  DutyCycle *self = (DutyCycle*) user_data;
+  DutyCyclePrivate::onTimeout(self);
+  return G_SOURCE_REMOVE;
+}
+
+inline int DutyCyclePrivate::level(DutyCycle *self) {
+  return ISensor::normalize(
+      self->sensor->getLightLevel(),
+      self->sensor->getUnit(),
+      self->curve);
+}
+
+void DutyCyclePrivate::onSample(DutyCycle *self) {
+  gint64 now = g_get_monotonic_time();
+  wakeup(self, now);
+
+  if (self->sensor->hasUnit()) {
+    int value = level(self);
+    switch (self->state) {
+      case DutyCycle::CONTINUOUS:
+        if (!self->timerId)
+          break;
+        self->levels.emplace_back(now, value);
+        if (!isSteady(self, now)) {
+          self->stableSince = now;
+          self->levels.clear();
+          self->levels.emplace_back(now, value);
+          schedule(self, self->stableTime);
+        }
+        break;
+      case DutyCycle::READING:
+        if (abs(value - self->reference) > self->deviation) {
+          LOGGER(logger) << "Level changed: " << value
+              << ", from: " << self->reference << endl;
+          reset(self, now);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  self->lightLevelChanged();
+}
+
+void DutyCyclePrivate::onTimeout(DutyCycle *self) {
+  self->timerId = 0;
+  gint64 now = g_get_monotonic_time();
+  wakeup(self, now);
+
+  switch (self->state) {
+    case DutyCycle::CONTINUOUS:
+      if (!isStable(self, now)) {
+        self->stableSince = now;
+        schedule(self, self->stableTime);
+        return;
+      }
+      self->reference = level(self);
+      self->interval = self->minInterval;
+      LOGGER(logger) << "Stable at level: " << self->reference << endl;
+      sleep(self, now);
+      break;
+    case DutyCycle::SLEEPING:
+      read(self, now);
+      break;
+    case DutyCycle::READING:
+      self->interval = min(
+          (long) (self->interval * self->factor),
+          self->maxInterval);
+      sleep(self, now);
+      break;
+  }
+}
+
+void DutyCyclePrivate::wakeup(DutyCycle *self, gint64 now) {
+  self->wakeups.push_back(now);
+  while (self->wakeups.front() <= now - MINUTE)
+    self->wakeups.pop_front();
+}
+
+void DutyCyclePrivate::schedule(DutyCycle *self, long delay) {
+  cancel(self);
+  self->timerId = g_timeout_add(delay, gOnTimeout, self);
+}
+
+void DutyCyclePrivate::cancel(DutyCycle *self) {
+  if (self->timerId) {
+    g_source_remove(self->timerId);
+    self->timerId = 0;
+  }
+}
+
+Promise<void> DutyCyclePrivate::setRunning(
+    DutyCycle *self,
+    bool running,
+    gint64 now) {
+  if (self->running == running)
+    return resolved();
+
+  if (running)
+    self->runningSince = now;
+  else
+    self->runningTime += now - self->runningSince;
+  self->running = running;
+
+  return running ? self->sensor->resume() : self->sensor->suspend();
+}
+
+/* back to continuous sampling, looking for stable light again */
+void DutyCyclePrivate::reset(DutyCycle *self, gint64 now) {
+  self->state = DutyCycle::CONTINUOUS;
+  self->interval = 0;
+  self->reference = -1;
+  self->stableSince = now;
+  self->levels.clear();
+  if (self->sensor->hasUnit())
+    self->levels.emplace_back(now, level(self));
+
+  cancel(self);
+  if (self->enabled && self->connected && !self->suspended)
+    schedule(self, self->stableTime);
+
+  if (!self->suspended)
+    setRunning(self, true, now).grab(PROMISE_LOG_EX);
+}
+
+/* the level held at the start of the window counts as a sample */
+bool DutyCyclePrivate::isSteady(DutyCycle *self, gint64 now) {
+  gint64 start = now - self->stableTime * 1000;
+  while (self->levels.size() > 1 && self->levels[1].first <= start)
+    self->levels.pop_front();
+
+  if (self->levels.empty())
+    return false;
+
+  double sum = 0;
+  double sum2 = 0;
+  for (const auto &sample : self->levels) {
+    sum += sample.second;
+    sum2 += sample.second * sample.second;
+  }
+  double n = self->levels.size();
+  double mean = sum / n;
+  double variance = sum2 / n - mean * mean;
+  return variance <= self->threshold * self->threshold;
+}
+
+bool DutyCyclePrivate::isStable(DutyCycle *self, gint64 now) {
+  return now - self->stableSince >= self->stableTime * 1000
+      && isSteady(self, now);
+}
+
+void DutyCyclePrivate::sleep(DutyCycle *self, gint64 now) {
+  self->state = DutyCycle::SLEEPING;
+  schedule(self, self->interval);
+  setRunning(self, false, now).grab(PROMISE_LOG_EX);
+}
+
+/* a deviating sample may reset the state while resuming */
+void DutyCyclePrivate::read(DutyCycle *self, gint64 now) {
+  self->state = DutyCycle::READING;
+  schedule(self, self->readWindow);
+  setRunning(self, true, now).grab(PROMISE_LOG_EX);
+}
+
+DutyCycle::DutyCycle(ISensor *sensor) : sensor(sensor) {
+  handlerId = sensor->lightLevelChanged << [=] {
+    DutyCyclePrivate::onSample(this);
+  };
+}
+
+DutyCycle::~DutyCycle() {
+  sensor->lightLevelChanged.remove(handlerId);
+  DutyCyclePrivate::cancel(this);
+}
+
+Promise<void> DutyCycle::connect() {
+  return sensor->connect() << [=] {
+    if (connected)
+      return;
+
+    gint64 now = g_get_monotonic_time();
+    connected = true;
+    started = now;
+    runningSince = now;
+    DutyCyclePrivate::reset(this, now);
+  };
+}
+
+void DutyCycle::supervise(Supervisor *supervisor) {
+  sensor->supervise(supervisor);
+}
+
+Promise<void> DutyCycle::suspend() {
+  if (suspended)
+    return resolved();
+
+  suspended = true;
+  state = CONTINUOUS;
+  DutyCyclePrivate::cancel(this);
+  return DutyCyclePrivate::setRunning(this, false, g_get_monotonic_time());
+}
+
+Promise<void> DutyCycle::resume() {
+  if (!suspended)
+    return resolved();
+
+  gint64 now = g_get_monotonic_time();
+  suspended = false;
+  Promise<void> promise = DutyCyclePrivate::setRunning(this, true, now);
+  DutyCyclePrivate::reset(this, now);
+  return promise;
+}
+
+double DutyCycle::getLightLevel() const {
+  return sensor->getLightLevel();
+}
+
+DutyCycle::Unit DutyCycle::getUnit() const {
+  return sensor->getUnit();
+}
+
+void DutyCycle::setCurve(const InputCurve &curve) {
+  this->curve = curve;
+  if (connected)
+    DutyCyclePrivate::reset(this, g_get_monotonic_time());
+}
+
+void DutyCycle::setEnabled(bool value) {
+  if (enabled == value)
+    return;
+
+  enabled = value;
+  if (connected)
+    DutyCyclePrivate::reset(this, g_get_monotonic_time());
+}
+
+bool DutyCycle::isEnabled() const {
+  return enabled;
+}
+
+DutyCycle::State DutyCycle::getState() const {
+  return state;
+}
+
+long DutyCycle::getInterval() const {
+  return interval;
+}
+
+double DutyCycle::getDutyCycle(gint64 now) const {
+  if (!connected || now <= started)
+    return 1;
+
+  gint64 time = runningTime;
+  if (running)
+    time += now - runningSince;
+  return (double) time / (now - started);
+}
+
+unsigned DutyCycle::getWakeupsPerMinute(gint64 now) const {
+  return count_if(wakeups.begin(), wakeups.end(), [=](gint64 time) {
+    return time > now - MINUTE;
+  });
+}
+
+void DutyCycle::updateDebugInfo(DebugInfo *info) const {
+  info->dutyCycle = getDutyCycle();
+  info->wakeupsPerMinute = getWakeupsPerMinute();
+}
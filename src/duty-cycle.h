@@ -0,0 +1,132 @@
+#ifndef DUTY_CYCLE_H_
+#define DUTY_CYCLE_H_
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <glib.h>
+
+#include "sensor.h"
+#include "debug-info.h"
+
+/**
+ * Suspends the wrapped sensor while the light is stable, resuming it
+ * for short read windows at lengthening intervals.
+ * The light is stable when the levels seen over the stable time vary
+ * less than the threshold, a read deviating from the level when
+ * sampling stopped returns to continuous sampling.
+ * Levels are normalized with the input curve, the standard one unless
+ * set.
+ */
+class DutyCycle: public ISensor {
+    friend class DutyCyclePrivate;
+
+  public:
+    enum State {
+      CONTINUOUS,
+      SLEEPING,
+      READING
+    };
+
+  private:
+    std::unique_ptr<ISensor> sensor;
+    void *handlerId = nullptr;
+    InputCurve curve;
+
+    bool enabled = false;
+    bool connected = false;
+    bool suspended = false;
+    bool running = true;
+    State state = CONTINUOUS;
+    guint timerId = 0;
+    long interval = 0;
+    int reference = -1;
+
+    /* levels seen in the stable time */
+    std::deque<std::pair<gint64, int>> levels;
+    gint64 stableSince = 0;
+
+    /* sensor samples and timer wakeups in the last minute */
+    std::deque<gint64> wakeups;
+
+    gint64 started = 0;
+    gint64 runningSince = 0;
+    gint64 runningTime = 0;
+
+  public:
+    /**
+     * Milliseconds the light has to be stable before duty cycling.
+     */
+    long stableTime = 60000;
+
+    /**
+     * Max standard deviation of stable levels.
+     */
+    double threshold = 1.5;
+
+    /**
+     * Level difference from the reference that resumes sampling.
+     */
+    int deviation = 3;
+
+    /**
+     * Milliseconds the sensor is resumed for each read.
+     */
+    long readWindow = 1500;
+
+    /**
+     * Milliseconds between reads, from min to max growing by factor.
+     */
+    long minInterval = 5000;
+    long maxInterval = 60000;
+    double factor = 2;
+
+    DutyCycle(ISensor *sensor);
+    DutyCycle(const DutyCycle&) = delete;
+    DutyCycle& operator=(const DutyCycle&) = delete;
+    ~DutyCycle();
+
+    promise::Promise<void> connect();
+
+    void supervise(Supervisor*);
+
+    /**
+     * Suspended by the owner, duty cycling restarts on resume.
+     */
+    promise::Promise<void> suspend();
+    promise::Promise<void> resume();
+
+    double getLightLevel() const;
+    Unit getUnit() const;
+
+    /**
+     * Curve used to normalize lux, as the conditioner does, duty cycling
+     * restarts since levels seen so far do not compare.
+     */
+    void setCurve(const InputCurve&);
+
+    /**
+     * When disabled, the default, the sensor samples continuously.
+     */
+    void setEnabled(bool);
+    bool isEnabled() const;
+
+    State getState() const;
+
+    /**
+     * Current interval between reads in milliseconds, 0 if sampling
+     * continuously.
+     */
+    long getInterval() const;
+
+    /**
+     * Fraction of time the sensor was running since connected.
+     */
+    double getDutyCycle(gint64 now = g_get_monotonic_time()) const;
+
+    unsigned getWakeupsPerMinute(gint64 now = g_get_monotonic_time()) const;
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+#endif /* DUTY_CYCLE_H_ */
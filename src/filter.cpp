@@ -1,27 +1,38 @@
+#include <algorithm>
 #include <math.h>
+#include <stdlib.h>
 
 #include "filter.h"
 
 struct PressureFilterPrivate {
-    static void addValue(PressureFilter *self, int value);
-    static int midValue(PressureFilter *self);
+    static double rate(const PressureFilter *self, int value);
+    static void addValue(PressureFilter *self, int value, double weight);
+    static double midValue(PressureFilter *self);
     static void reset(PressureFilter *self);
 };
 
-void PressureFilterPrivate::addValue(PressureFilter *self, int value) {
+/* pressure per time constant */
+double PressureFilterPrivate::rate(const PressureFilter *self, int value) {
   int d = value - self->value;
   if (d > 0) {
-    self->pressure += (d * d * 0.01) * (value * 0.01);
+    return (d * d * 0.01) * (value * 0.01);
   } else if (d < 0) {
-    self->pressure -= (d * d * 0.01) * (self->value * 0.01);
+    return -(d * d * 0.01) * (self->value * 0.01);
   }
+  return 0;
+}
 
-  self->vpSum += value * 0.01;
-  self->vpNum += 0.01;
+void PressureFilterPrivate::addValue(
+    PressureFilter *self,
+    int value,
+    double weight) {
+  self->pressure += rate(self, value) * weight;
+  self->vpSum += value * 0.01 * weight;
+  self->vpNum += 0.01 * weight;
 }
 
-int PressureFilterPrivate::midValue(PressureFilter *self) {
-  return self->vpNum ? round(self->vpSum / self->vpNum) : 0;
+double PressureFilterPrivate::midValue(PressureFilter *self) {
+  return self->vpNum ? self->vpSum / self->vpNum : 0;
 }
 
 void PressureFilterPrivate::reset(PressureFilter *self) {
@@ -32,28 +43,679 @@ void PressureFilterPrivate::reset(PressureFilter *self) {
 
 void PressureFilter::setValue(int value) {
   this->value = value;
+  this->fixedValue = fixed::fromInt(value);
+  this->input = value;
+  PressureFilterPrivate::reset(this);
+}
+
+int PressureFilter::filter(int v, gint64 now) {
+  update(now);
+
+  input = v;
+  if (v == value || (v > value && pressure < 0) || (v < value && pressure > 0))
+    PressureFilterPrivate::reset(this);
+
+  return value;
 }
 
-int PressureFilter::filter(int v) {
-  if (v > value && pressure >= 0) {
-    PressureFilterPrivate::addValue(this, v);
-    if (pressure >= 1) {
-      value = PressureFilterPrivate::midValue(this);
-      PressureFilterPrivate::reset(this);
-    }
-  } else if (v < value && pressure <= 0) {
-    PressureFilterPrivate::addValue(this, v);
-    if (pressure <= -1) {
-      value = PressureFilterPrivate::midValue(this);
-      PressureFilterPrivate::reset(this);
-    }
-  } else {
+int PressureFilter::update(gint64 now) {
+  gint64 dt = time >= 0 ? now - time : 0;
+  time = now;
+
+  if (dt <= 0 || input == value)
+    return value;
+
+  double weight = dt / (timeConstant * 1000.0);
+  PressureFilterPrivate::addValue(this, input, weight);
+  if (pressure >= 1 || pressure <= -1) {
+    double mid = PressureFilterPrivate::midValue(this);
+    value = round(mid);
+    fixedValue = fixed::fromDouble(mid);
     PressureFilterPrivate::reset(this);
   }
   return value;
 }
 
+long PressureFilter::nextUpdate() const {
+  double r = PressureFilterPrivate::rate(this, input);
+  if (!r)
+    return -1;
+
+  double remaining = (r > 0 ? 1 - pressure : -1 - pressure) / r;
+  return remaining > 0 ? ceil(remaining * timeConstant) : 0;
+}
+
 void PressureFilter::updateDebugInfo(DebugInfo *info) const {
   info->pressure = pressure;
   info->filtered = value;
 }
+
+int PressureFilter::getValue() const {
+  return value;
+}
+
+fixed::Q16 PressureFilter::getFixed() const {
+  return fixedValue;
+}
+
+struct EmaFilterPrivate {
+    static double alpha(const EmaFilter *self, double dt);
+};
+
+inline double EmaFilterPrivate::alpha(const EmaFilter *self, double dt) {
+  return 1 - exp(-dt / (self->timeConstant * 1000.0));
+}
+
+void EmaFilter::setValue(int value) {
+  average = value;
+  input = value;
+}
+
+int EmaFilter::getValue() const {
+  return round(average);
+}
+
+int EmaFilter::filter(int v, gint64 now) {
+  update(now);
+  input = v;
+  return getValue();
+}
+
+int EmaFilter::update(gint64 now) {
+  gint64 dt = time >= 0 ? now - time : 0;
+  time = now;
+
+  if (dt > 0)
+    average += EmaFilterPrivate::alpha(this, dt) * (input - average);
+
+  return getValue();
+}
+
+long EmaFilter::nextUpdate() const {
+  double level = round(average / step) * step;
+  if (fabs(input - level) <= step / 2)
+    return -1;
+
+  /* time to cross the next rounding boundary towards input */
+  double boundary = level + (input > level ? step : -step) / 2;
+  double t = -timeConstant * log((input - boundary) / (input - average));
+  return t > 0 ? ceil(t) : 0;
+}
+
+fixed::Q16 EmaFilter::getFixed() const {
+  return fixed::fromDouble(average);
+}
+
+void EmaFilter::setStep(fixed::Q16 step) {
+  this->step = fixed::toDouble(step);
+}
+
+void EmaFilter::updateDebugInfo(DebugInfo *info) const {
+  info->pressure = (input - average) * 0.01;
+  info->filtered = getValue();
+}
+
+struct MedianFilterPrivate {
+    static bool lower(MedianFilter *self, int heap, size_t a, size_t b);
+    static std::vector<int>& heapOf(MedianFilter *self, int heap);
+    static void place(MedianFilter *self, int heap, size_t pos, int slot);
+    static size_t posOf(MedianFilter *self, int slot);
+    static void siftUp(MedianFilter *self, int heap, size_t pos);
+    static void siftDown(MedianFilter *self, int heap, size_t pos);
+    static void push(MedianFilter *self, int heap, int slot);
+    static int pop(MedianFilter *self, int heap);
+    static void add(MedianFilter *self, int value);
+    static int median(MedianFilter *self);
+};
+
+enum {
+  LOW,
+  HIGH
+};
+
+inline std::vector<int>& MedianFilterPrivate::heapOf(
+    MedianFilter *self,
+    int heap) {
+  return heap == LOW ? self->low : self->high;
+}
+
+/* true if a should be above b, max heap for low, min heap for high */
+inline bool MedianFilterPrivate::lower(
+    MedianFilter *self,
+    int heap,
+    size_t a,
+    size_t b) {
+  std::vector<int> &h = heapOf(self, heap);
+  int va = self->ring[h[a]];
+  int vb = self->ring[h[b]];
+  return heap == LOW ? va > vb : va < vb;
+}
+
+/* positions in high heap are stored negative */
+inline void MedianFilterPrivate::place(
+    MedianFilter *self,
+    int heap,
+    size_t pos,
+    int slot) {
+  heapOf(self, heap)[pos] = slot;
+  self->where[slot] = heap == LOW ? pos : -(int) pos - 1;
+}
+
+inline size_t MedianFilterPrivate::posOf(MedianFilter *self, int slot) {
+  int w = self->where[slot];
+  return w >= 0 ? w : -w - 1;
+}
+
+void MedianFilterPrivate::siftUp(MedianFilter *self, int heap, size_t pos) {
+  std::vector<int> &h = heapOf(self, heap);
+  while (pos > 0) {
+    size_t parent = (pos - 1) / 2;
+    if (!lower(self, heap, pos, parent))
+      break;
+    int slot = h[pos];
+    place(self, heap, pos, h[parent]);
+    place(self, heap, parent, slot);
+    pos = parent;
+  }
+}
+
+void MedianFilterPrivate::siftDown(MedianFilter *self, int heap, size_t pos) {
+  std::vector<int> &h = heapOf(self, heap);
+  size_t n = heap == LOW ? self->nLow : self->nHigh;
+  for (;;) {
+    size_t top = pos;
+    size_t left = 2 * pos + 1;
+    size_t right = left + 1;
+    if (left < n && lower(self, heap, left, top))
+      top = left;
+    if (right < n && lower(self, heap, right, top))
+      top = right;
+    if (top == pos)
+      break;
+    int slot = h[pos];
+    place(self, heap, pos, h[top]);
+    place(self, heap, top, slot);
+    pos = top;
+  }
+}
+
+void MedianFilterPrivate::push(MedianFilter *self, int heap, int slot) {
+  size_t &n = heap == LOW ? self->nLow : self->nHigh;
+  place(self, heap, n, slot);
+  siftUp(self, heap, n++);
+}
+
+int MedianFilterPrivate::pop(MedianFilter *self, int heap) {
+  std::vector<int> &h = heapOf(self, heap);
+  size_t &n = heap == LOW ? self->nLow : self->nHigh;
+  int slot = h[0];
+  n--;
+  if (n) {
+    place(self, heap, 0, h[n]);
+    siftDown(self, heap, 0);
+  }
+  return slot;
+}
+
+void MedianFilterPrivate::add(MedianFilter *self, int value) {
+  size_t window = self->ring.size();
+  int slot = self->next;
+  self->next = (self->next + 1) % window;
+  self->ring[slot] = value;
+
+  if (self->nLow + self->nHigh < window) {
+    if (!self->nLow || value <= self->ring[self->low[0]])
+      push(self, LOW, slot);
+    else
+      push(self, HIGH, slot);
+
+    if (self->nLow > self->nHigh + 1)
+      push(self, HIGH, pop(self, LOW));
+    else if (self->nHigh > self->nLow)
+      push(self, LOW, pop(self, HIGH));
+    return;
+  }
+
+  /* replace the oldest sample in its heap */
+  int heap = self->where[slot] >= 0 ? LOW : HIGH;
+  siftUp(self, heap, posOf(self, slot));
+  siftDown(self, heap, posOf(self, slot));
+
+  if (self->nHigh && self->ring[self->low[0]] > self->ring[self->high[0]]) {
+    int l = self->low[0];
+    int h = self->high[0];
+    place(self, LOW, 0, h);
+    place(self, HIGH, 0, l);
+    siftDown(self, LOW, 0);
+    siftDown(self, HIGH, 0);
+  }
+}
+
+int MedianFilterPrivate::median(MedianFilter *self) {
+  int l = self->ring[self->low[0]];
+  if (self->nLow > self->nHigh)
+    return l;
+  return round((l + self->ring[self->high[0]]) * 0.5);
+}
+
+MedianFilter::MedianFilter(size_t window) :
+    ring(window ? window : 1),
+    where(ring.size()),
+    low(ring.size()),
+    high(ring.size()) {
+}
+
+void MedianFilter::setValue(int value) {
+  nLow = 0;
+  nHigh = 0;
+  next = 0;
+  for (size_t i = 0; i < ring.size(); i++) {
+    MedianFilterPrivate::add(this, value);
+  }
+  this->value = value;
+  input = value;
+}
+
+int MedianFilter::getValue() const {
+  return value;
+}
+
+int MedianFilter::filter(int v, gint64 now) {
+  input = v;
+  time = now;
+  MedianFilterPrivate::add(this, v);
+  value = MedianFilterPrivate::median(this);
+  return value;
+}
+
+int MedianFilter::update(gint64 now) {
+  if (time >= 0 && now - time >= interval * 1000)
+    filter(input, now);
+  return value;
+}
+
+long MedianFilter::nextUpdate() const {
+  return value == input ? -1 : interval;
+}
+
+void MedianFilter::updateDebugInfo(DebugInfo *info) const {
+  info->filtered = value;
+}
+
+struct KalmanFilterPrivate {
+    static void predict(KalmanFilter *self, gint64 now);
+    static void correct(KalmanFilter *self, int measurement, gint64 now);
+};
+
+void KalmanFilterPrivate::predict(KalmanFilter *self, gint64 now) {
+  if (self->time >= 0 && now > self->time)
+    self->variance += self->processNoise * (now - self->time) * 1e-6;
+  self->time = now;
+}
+
+void KalmanFilterPrivate::correct(
+    KalmanFilter *self,
+    int measurement,
+    gint64 now) {
+  double gain = self->variance / (self->variance + self->measurementNoise);
+  self->estimate += gain * (measurement - self->estimate);
+  self->variance *= 1 - gain;
+  self->measured = now;
+}
+
+void KalmanFilter::setValue(int value) {
+  estimate = value;
+  variance = measurementNoise;
+  input = value;
+}
+
+int KalmanFilter::getValue() const {
+  return round(estimate);
+}
+
+int KalmanFilter::filter(int v, gint64 now) {
+  input = v;
+  KalmanFilterPrivate::predict(this, now);
+  KalmanFilterPrivate::correct(this, v, now);
+  return getValue();
+}
+
+int KalmanFilter::update(gint64 now) {
+  if (measured >= 0 && now - measured >= interval * 1000)
+    filter(input, now);
+  return getValue();
+}
+
+long KalmanFilter::nextUpdate() const {
+  return getValue() == input ? -1 : interval;
+}
+
+fixed::Q16 KalmanFilter::getFixed() const {
+  return fixed::fromDouble(estimate);
+}
+
+void KalmanFilter::updateDebugInfo(DebugInfo *info) const {
+  info->pressure = variance * 0.01;
+  info->filtered = getValue();
+}
+
+void HysteresisFilter::setValue(int value) {
+  this->value = value;
+}
+
+int HysteresisFilter::getValue() const {
+  return value;
+}
+
+int HysteresisFilter::filter(int v, gint64 now) {
+  if (abs(v - value) >= threshold)
+    value = v;
+  return value;
+}
+
+void HysteresisFilter::updateDebugInfo(DebugInfo *info) const {
+  info->filtered = value;
+}
+
+struct FastPathFilterPrivate {
+    static void check(FastPathFilter *self, gint64 now);
+};
+
+void FastPathFilterPrivate::check(FastPathFilter *self, gint64 now) {
+  self->time = now;
+
+  int d = self->input - self->inner->getValue();
+  if (self->threshold <= 0 || abs(d) < self->threshold) {
+    self->since = -1;
+    return;
+  }
+
+  int side = d > 0 ? 1 : -1;
+  if (self->since < 0 || side != self->side) {
+    self->since = now;
+    self->side = side;
+  }
+
+  if (now - self->since >= self->confirmTime * 1000) {
+    self->inner->setValue(self->input);
+    self->since = -1;
+  }
+}
+
+FastPathFilter::FastPathFilter(IFilter *inner) :
+    inner(inner) {
+}
+
+void FastPathFilter::setValue(int value) {
+  inner->setValue(value);
+  input = value;
+  since = -1;
+}
+
+int FastPathFilter::getValue() const {
+  return inner->getValue();
+}
+
+int FastPathFilter::filter(int v, gint64 now) {
+  inner->filter(v, now);
+  input = v;
+  FastPathFilterPrivate::check(this, now);
+  return getValue();
+}
+
+int FastPathFilter::update(gint64 now) {
+  inner->update(now);
+  FastPathFilterPrivate::check(this, now);
+  return getValue();
+}
+
+long FastPathFilter::nextUpdate() const {
+  long next = inner->nextUpdate();
+  if (since < 0)
+    return next;
+
+  long remaining = confirmTime - (time - since) / 1000;
+  if (remaining < 0)
+    remaining = 0;
+  return next < 0 || remaining < next ? remaining : next;
+}
+
+fixed::Q16 FastPathFilter::getFixed() const {
+  return inner->getFixed();
+}
+
+void FastPathFilter::setStep(fixed::Q16 step) {
+  inner->setStep(step);
+}
+
+void FastPathFilter::updateDebugInfo(DebugInfo *info) const {
+  inner->updateDebugInfo(info);
+}
+
+struct PredictiveFilterPrivate {
+    static void expire(PredictiveFilter *self, gint64 now);
+    static void add(PredictiveFilter *self, int input, gint64 now);
+    static double fit(const PredictiveFilter *self, gint64 now, double &level);
+    static void predict(PredictiveFilter *self, gint64 now);
+};
+
+void PredictiveFilterPrivate::expire(PredictiveFilter *self, gint64 now) {
+  gint64 oldest = now - self->window * 1000;
+  while (self->count && self->points[self->first].time < oldest) {
+    self->first = (self->first + 1) % PredictiveFilter::SIZE;
+    self->count--;
+  }
+}
+
+/* full, forget the oldest */
+void PredictiveFilterPrivate::add(
+    PredictiveFilter *self,
+    int input,
+    gint64 now) {
+  if (self->count == PredictiveFilter::SIZE) {
+    self->first = (self->first + 1) % PredictiveFilter::SIZE;
+    self->count--;
+  }
+  int i = (self->first + self->count) % PredictiveFilter::SIZE;
+  self->points[i] = { now, input };
+  self->count++;
+}
+
+/* least squares line of the inputs, slope in levels per millisecond
+ * and level at now */
+double PredictiveFilterPrivate::fit(
+    const PredictiveFilter *self,
+    gint64 now,
+    double &level) {
+  level = self->input;
+  if (self->count < 3)
+    return 0;
+
+  double st = 0, sv = 0, stt = 0, stv = 0;
+  for (int n = 0; n < self->count; n++) {
+    int i = (self->first + n) % PredictiveFilter::SIZE;
+    const auto &point = self->points[i];
+    double t = (point.time - now) / 1000.0;
+    st += t;
+    sv += point.input;
+    stt += t * t;
+    stv += t * point.input;
+  }
+
+  double d = self->count * stt - st * st;
+  if (d <= 0)
+    return 0;
+
+  double slope = (self->count * stv - st * sv) / d;
+  level = (sv - slope * st) / self->count;
+  return slope;
+}
+
+void PredictiveFilterPrivate::predict(PredictiveFilter *self, gint64 now) {
+  self->time = now;
+  expire(self, now);
+
+  double level;
+  double slope = fit(self, now, level);
+  int lead = round(slope * self->leadTime);
+  lead = std::max(-self->limit, std::min(self->limit, lead));
+
+  /* a fading trend is taken over by the filter catching up */
+  int value = self->inner->getValue();
+  int held = self->output - value;
+  if (self->lead > 0 && lead < self->lead)
+    lead = std::max(lead, std::min(held, self->lead));
+  else if (self->lead < 0 && lead > self->lead)
+    lead = std::min(lead, std::max(held, self->lead));
+
+  /* less than a level past the fitted level, that is less noisy than
+   * the input */
+  double behind = level - value;
+  if (lead > 0)
+    lead = std::max(0, std::min(lead, (int) ceil(behind)));
+  else if (lead < 0)
+    lead = std::min(0, std::max(lead, (int) floor(behind)));
+  lead = std::max(-value, std::min(100 - value, lead));
+  self->lead = lead;
+  self->output = value + lead;
+}
+
+PredictiveFilter::PredictiveFilter(IFilter *inner) :
+    inner(inner) {
+}
+
+void PredictiveFilter::setValue(int value) {
+  inner->setValue(value);
+  input = value;
+  output = value;
+  count = 0;
+  lead = 0;
+}
+
+int PredictiveFilter::getValue() const {
+  return inner->getValue() + lead;
+}
+
+int PredictiveFilter::filter(int v, gint64 now) {
+  inner->filter(v, now);
+  input = v;
+  PredictiveFilterPrivate::add(this, v, now);
+  PredictiveFilterPrivate::predict(this, now);
+  return getValue();
+}
+
+int PredictiveFilter::update(gint64 now) {
+  inner->update(now);
+  PredictiveFilterPrivate::predict(this, now);
+  return getValue();
+}
+
+/* the lead must also go when the trend leaves the window */
+long PredictiveFilter::nextUpdate() const {
+  long next = inner->nextUpdate();
+  if (!lead || !count)
+    return next;
+
+  gint64 expiry = points[first].time + window * 1000;
+  long remaining = expiry > time ? (expiry - time + 999) / 1000 : 0;
+  return next < 0 || remaining < next ? remaining : next;
+}
+
+fixed::Q16 PredictiveFilter::getFixed() const {
+  return inner->getFixed() + fixed::fromInt(lead);
+}
+
+void PredictiveFilter::setStep(fixed::Q16 step) {
+  inner->setStep(step);
+}
+
+void PredictiveFilter::updateDebugInfo(DebugInfo *info) const {
+  inner->updateDebugInfo(info);
+  info->filtered = getValue();
+}
+
+struct DeadBandPrivate {
+    static bool passes(const DeadBand *self);
+};
+
+/* input far enough, regardless of dwell */
+bool DeadBandPrivate::passes(const DeadBand *self) {
+  fixed::Q16 d = self->input - self->value;
+  if (d > 0)
+    return d >= self->up;
+  if (d < 0)
+    return -d >= self->down;
+  return false;
+}
+
+void DeadBand::setValue(fixed::Q16 value) {
+  this->value = value;
+  this->input = value;
+  valid = true;
+}
+
+fixed::Q16 DeadBand::getValue() const {
+  return value;
+}
+
+fixed::Q16 DeadBand::filter(fixed::Q16 v, gint64 now) {
+  input = v;
+  if (!valid)
+    setValue(v);
+  if (start < 0)
+    start = now;
+  return update(now);
+}
+
+fixed::Q16 DeadBand::update(gint64 now) {
+  time = now;
+  if (!DeadBandPrivate::passes(this))
+    return value;
+  if (changed >= 0 && now - changed < dwell * 1000)
+    return value;
+
+  value = input;
+  changed = now;
+  changes++;
+  return value;
+}
+
+long DeadBand::nextUpdate(gint64 now) const {
+  if (!DeadBandPrivate::passes(this))
+    return -1;
+
+  gint64 remaining = changed >= 0 ? changed + dwell * 1000 - now : 0;
+  return remaining > 0 ? (remaining + 999) / 1000 : 0;
+}
+
+unsigned long long DeadBand::getChanges() const {
+  return changes;
+}
+
+double DeadBand::changesPerHour() const {
+  gint64 elapsed = time - start;
+  return elapsed > 0 ? changes * 3600e6 / elapsed : 0;
+}
+
+void TimeToTarget::update(int input, int value, gint64 now) {
+  int d = abs(input - value);
+  if (start < 0) {
+    if (d >= threshold)
+      start = now;
+    return;
+  }
+
+  if (d > tolerance)
+    return;
+
+  last = (now - start) / 1000;
+  if (last > max)
+    max = last;
+  total += last;
+  count++;
+  start = -1;
+}
+
+double TimeToTarget::mean() const {
+  return count ? total / count : -1;
+}
@@ -1,21 +1,368 @@
 #ifndef FILTER_H_
 #define FILTER_H_
 
+#include <memory>
+#include <vector>
+#include <glib.h>
+
 #include "debug-info.h"
+#include "fixed.h"
+
+/**
+ * Smooths normalized light levels, time is monotonic in microseconds.
+ * Filters must not allocate per sample.
+ */
+struct IFilter {
+    virtual ~IFilter() = default;
+
+    virtual void setValue(int) = 0;
+    virtual int getValue() const = 0;
+    virtual int filter(int, gint64 now) = 0;
+
+    /**
+     * Value in Q16, filters that keep a finer value than the integer
+     * one override this.
+     */
+    virtual fixed::Q16 getFixed() const {
+      return fixed::fromInt(getValue());
+    }
+
+    /**
+     * Smallest change of value worth an update, in Q16, for filters
+     * that change with time.
+     */
+    virtual void setStep(fixed::Q16) {
+    }
+
+    /**
+     * Account for the input held up to now.
+     */
+    virtual int update(gint64 now) {
+      return getValue();
+    }
 
-class PressureFilter {
+    /**
+     * Milliseconds until value may change if input is held,
+     * -1 if it would not.
+     */
+    virtual long nextUpdate() const {
+      return -1;
+    }
+
+    virtual void updateDebugInfo(DebugInfo*) const = 0;
+};
+
+/**
+ * Changes value once enough pressure is built by inputs on the same side
+ * of it. Pressure grows with the square of the distance and with the
+ * time the input is held.
+ */
+class PressureFilter: public IFilter {
     friend class PressureFilterPrivate;
 
     int value = 0;
+    fixed::Q16 fixedValue = 0;
+    int input = 0;
+    gint64 time = -1;
     double pressure = 0;
     double vpSum = 0;
     double vpNum = 0;
 
   public:
+    /**
+     * Time scale in milliseconds, pressure builds as it did per sample
+     * when samples came this far apart.
+     */
+    long timeConstant = 1000;
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
+
+    /**
+     * Time weighted mean of the inputs that moved the value, unrounded.
+     */
+    fixed::Q16 getFixed() const;
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Exponential moving average of the held input, reaching 63% of a step
+ * in the time constant.
+ */
+class EmaFilter: public IFilter {
+    friend class EmaFilterPrivate;
+
+    double average = 0;
+    int input = 0;
+    gint64 time = -1;
+    double step = 1;
+
+  public:
+    long timeConstant = 1000;
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
+    fixed::Q16 getFixed() const;
+    void setStep(fixed::Q16);
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Median of the last window samples, rejects spikes shorter than half
+ * the window. The held input counts as a new sample every interval.
+ * Samples are kept in a ring indexed into two heaps, low values in a
+ * max heap and high values in a min heap, so each sample is O(log n).
+ */
+class MedianFilter: public IFilter {
+    friend class MedianFilterPrivate;
+
+    std::vector<int> ring;
+    std::vector<int> where;
+    std::vector<int> low;
+    std::vector<int> high;
+    size_t nLow = 0;
+    size_t nHigh = 0;
+    size_t next = 0;
+    int value = 0;
+    int input = 0;
+    gint64 time = -1;
+
+  public:
+    long interval = 1000;
+
+    explicit MedianFilter(size_t window = 5);
+
     void setValue(int);
-    int filter(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
 
     void updateDebugInfo(DebugInfo*) const;
 };
 
+/**
+ * One dimensional Kalman filter with constant level model.
+ * The held input counts as a new measurement every interval.
+ */
+class KalmanFilter: public IFilter {
+    friend class KalmanFilterPrivate;
+
+    double estimate = 0;
+    double variance = 0;
+    int input = 0;
+    gint64 time = -1;
+    gint64 measured = -1;
+
+  public:
+    /**
+     * Variance of light level changes per second.
+     */
+    double processNoise = 1;
+
+    /**
+     * Variance of measurements.
+     */
+    double measurementNoise = 4;
+
+    long interval = 1000;
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
+    fixed::Q16 getFixed() const;
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Follows the input only when it moves at least threshold away.
+ */
+class HysteresisFilter: public IFilter {
+    int value = 0;
+
+  public:
+    int threshold = 5;
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Snaps to the input when it stays at least threshold away from value
+ * for the confirm time, smaller changes go through the wrapped filter.
+ */
+class FastPathFilter: public IFilter {
+    friend class FastPathFilterPrivate;
+
+    std::unique_ptr<IFilter> inner;
+    int input = 0;
+    int side = 0;
+    gint64 time = -1;
+    gint64 since = -1;
+
+  public:
+    /**
+     * Distance from value to snap, 0 to never snap.
+     */
+    int threshold = 25;
+
+    /**
+     * Milliseconds the input must stay away.
+     */
+    long confirmTime = 500;
+
+    explicit FastPathFilter(IFilter *inner);
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
+    fixed::Q16 getFixed() const;
+    void setStep(fixed::Q16);
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Leads the wrapped filter along the trend of the input, by the input
+ * slope over the window times the lead time.
+ * The lead is in whole levels, at most limit, and never goes past the
+ * input level fitted over the window, so it only takes back part of the
+ * filter lag. A fading trend is taken over by the wrapped filter, so
+ * value does not step back.
+ */
+class PredictiveFilter: public IFilter {
+    friend class PredictiveFilterPrivate;
+
+    static const int SIZE = 32;
+
+    struct Point {
+        gint64 time;
+        int input;
+    };
+
+    std::unique_ptr<IFilter> inner;
+    Point points[SIZE];
+    int first = 0;
+    int count = 0;
+    int input = 0;
+    int lead = 0;
+    int output = 0;
+    gint64 time = -1;
+
+  public:
+    /**
+     * Milliseconds of inputs to estimate the slope from.
+     */
+    long window = 5000;
+
+    /**
+     * Milliseconds to extrapolate the slope for.
+     */
+    long leadTime = 2000;
+
+    /**
+     * Largest lead in levels.
+     */
+    int limit = 10;
+
+    explicit PredictiveFilter(IFilter *inner);
+
+    void setValue(int);
+    int getValue() const;
+    int filter(int, gint64 now);
+    int update(gint64 now);
+    long nextUpdate() const;
+    fixed::Q16 getFixed() const;
+    void setStep(fixed::Q16);
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+/**
+ * Output stage holding the value until the input moves at least up or
+ * down from it, and for at least the dwell time after each change.
+ * Values are in Q16, time is monotonic in microseconds.
+ */
+class DeadBand {
+    friend class DeadBandPrivate;
+
+    fixed::Q16 input = 0;
+    fixed::Q16 value = 0;
+    bool valid = false;
+    gint64 changed = -1;
+    gint64 start = -1;
+    gint64 time = -1;
+    unsigned long long changes = 0;
+
+  public:
+    fixed::Q16 up = fixed::ONE;
+    fixed::Q16 down = 2 * fixed::ONE;
+
+    /**
+     * Milliseconds to hold each value.
+     */
+    long dwell = 1000;
+
+    /**
+     * Start from value, not counted as a change.
+     */
+    void setValue(fixed::Q16);
+    fixed::Q16 getValue() const;
+    fixed::Q16 filter(fixed::Q16, gint64 now);
+
+    /**
+     * Account for the input held up to now.
+     */
+    fixed::Q16 update(gint64 now);
+
+    /**
+     * Milliseconds until a held input passes, -1 if it would not.
+     */
+    long nextUpdate(gint64 now) const;
+
+    /**
+     * Changes of value since the first input.
+     */
+    unsigned long long getChanges() const;
+    double changesPerHour() const;
+};
+
+/**
+ * Time for value to get within tolerance of the input, after the input
+ * moved at least threshold away from it.
+ */
+struct TimeToTarget {
+    int threshold = 20;
+    int tolerance = 2;
+    gint64 start = -1;
+
+    long last = -1;
+    long max = 0;
+    long count = 0;
+    double total = 0;
+
+    void update(int input, int value, gint64 now);
+
+    /**
+     * Mean in milliseconds, -1 if no transition completed.
+     */
+    double mean() const;
+};
+
 #endif /* FILTER_H_ */
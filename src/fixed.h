@@ -0,0 +1,54 @@
+#ifndef FIXED_H_
+#define FIXED_H_
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Q16 fixed point percentages, carried from the filters to the
+ * brightness backends so that backends with more than 100 steps are
+ * not limited to 1% changes.
+ * Integer views round half away from zero.
+ */
+namespace fixed {
+
+  using Q16 = int32_t;
+
+  static const int SHIFT = 16;
+  static const Q16 ONE = 1 << SHIFT;
+  static const Q16 HALF = ONE / 2;
+
+  inline Q16 fromInt(int value) {
+    return value * ONE;
+  }
+
+  inline Q16 fromDouble(double value) {
+    return std::lround(value * ONE);
+  }
+
+  inline int toInt(Q16 value) {
+    return value >= 0 ? (value + HALF) >> SHIFT : -((HALF - value) >> SHIFT);
+  }
+
+  inline double toDouble(Q16 value) {
+    return value / (double) ONE;
+  }
+
+  /**
+   * Value from a to b at fraction t, t in Q16 from 0 to ONE.
+   */
+  inline Q16 lerp(Q16 a, Q16 b, Q16 t) {
+    return a + (((int64_t) (b - a) * t) >> SHIFT);
+  }
+
+  /**
+   * Scale value by num / den, rounding to nearest.
+   */
+  inline int64_t scale(int64_t value, int64_t num, int64_t den) {
+    int64_t n = value * num;
+    return n >= 0 ? (n + den / 2) / den : -((den / 2 - n) / den);
+  }
+
+}
+
+#endif /* FIXED_H_ */
@@ -0,0 +1,136 @@
+#include <cmath>
+
+#include "gdbus-stats.h"
+
+using namespace std;
+
+static const char *OTHER = "(other)";
+
+namespace gdbus {
+
+  int Histogram::indexOf(long value) {
+    if (value < SUB)
+      return value < 0 ? 0 : value;
+
+    if (value >= (1L << MAX_BITS))
+      value = (1L << MAX_BITS) - 1;
+
+    int msb = 63 - __builtin_clzl(value);
+    int sub = (value >> (msb - SUB_BITS)) & (SUB - 1);
+    return (msb - SUB_BITS + 1) * SUB + sub;
+  }
+
+  long Histogram::lowestAt(int index) {
+    if (index < SUB)
+      return index;
+
+    int msb = index / SUB + SUB_BITS - 1;
+    int sub = index % SUB;
+    return (long) (SUB + sub) << (msb - SUB_BITS);
+  }
+
+  long Histogram::highestAt(int index) {
+    if (index < SUB)
+      return index;
+
+    int msb = index / SUB + SUB_BITS - 1;
+    return lowestAt(index) + (1L << (msb - SUB_BITS)) - 1;
+  }
+
+  void Histogram::record(long value) {
+    counts[indexOf(value)]++;
+    total++;
+    if (value > maxValue)
+      maxValue = value;
+  }
+
+  long Histogram::percentile(double p) const {
+    if (!total)
+      return 0;
+
+    unsigned long target = ceil(p / 100 * total);
+    if (target < 1)
+      target = 1;
+
+    unsigned long seen = 0;
+    for (int i = 0; i < SIZE; i++) {
+      seen += counts[i];
+      if (seen >= target)
+        return highestAt(i) < maxValue ? highestAt(i) : maxValue;
+    }
+    return maxValue;
+  }
+
+  long Histogram::max() const {
+    return maxValue;
+  }
+
+  unsigned long Histogram::count() const {
+    return total;
+  }
+
+  CallStats* CallStatsTable::lookup(const char *iface, const char *method) {
+    iface = g_intern_string(iface);
+    method = g_intern_string(method);
+
+    for (int i = 0; i < size; i++) {
+      if (entries[i].iface == iface && entries[i].method == method)
+        return &entries[i];
+    }
+
+    if (size >= SIZE - 1) {
+      CallStats *other = &entries[SIZE - 1];
+      other->iface = OTHER;
+      other->method = OTHER;
+      size = SIZE;
+      return other;
+    }
+
+    CallStats *stats = &entries[size++];
+    stats->iface = iface;
+    stats->method = method;
+    return stats;
+  }
+
+  void CallStatsTable::reset() {
+    for (int i = 0; i < size; i++) {
+      entries[i] = CallStats();
+    }
+    size = 0;
+  }
+
+  CallStatsTable& callStats() {
+    static CallStatsTable table;
+    return table;
+  }
+
+  void recordCall(CallStats *stats, gint64 start, const GException &error) {
+    switch (error.kind()) {
+      case GException::NONE:
+        break;
+      case GException::CANCELLED:
+        stats->cancelled++;
+        return;
+      case GException::TIMEOUT:
+        stats->timeouts++;
+        break;
+      default:
+        stats->errors++;
+        break;
+    }
+
+    stats->latency.record(g_get_monotonic_time() - start);
+  }
+
+  ostream& operator<<(ostream &out, const CallStats &stats) {
+    return out << stats.iface << " " << stats.method
+        << ": calls: " << stats.calls
+        << ", errors: " << stats.errors
+        << ", timeouts: " << stats.timeouts
+        << ", cancelled: " << stats.cancelled
+        << ", p50: " << stats.latency.percentile(50) << "us"
+        << ", p99: " << stats.latency.percentile(99) << "us"
+        << ", max: " << stats.latency.max() << "us";
+  }
+
+}
@@ -0,0 +1,76 @@
+#ifndef GDBUS_STATS_H_
+#define GDBUS_STATS_H_
+
+#include <cstddef>
+#include <ostream>
+#include <glib.h>
+
+#include "gexception.h"
+
+namespace gdbus {
+
+  /**
+   * Log-linear latency histogram (HDR style).
+   * Values are microseconds, each power of two is split in SUB buckets,
+   * so the relative error of a recorded value is at most 1 / SUB.
+   */
+  class Histogram {
+    public:
+      static const int SUB_BITS = 3;
+      static const int SUB = 1 << SUB_BITS;
+      static const int MAX_BITS = 27;
+      static const int SIZE = (MAX_BITS - SUB_BITS + 1) * SUB;
+
+    private:
+      unsigned int counts[SIZE] = { };
+      unsigned long total = 0;
+      long maxValue = 0;
+
+    public:
+      static int indexOf(long value);
+      static long lowestAt(int index);
+      static long highestAt(int index);
+
+      void record(long value);
+      long percentile(double p) const;
+      long max() const;
+      unsigned long count() const;
+  };
+
+  struct CallStats {
+      const char *iface = nullptr;
+      const char *method = nullptr;
+      unsigned long calls = 0;
+      unsigned long errors = 0;
+      unsigned long timeouts = 0;
+      unsigned long cancelled = 0;
+      Histogram latency;
+  };
+
+  /**
+   * Fixed-size table of per-method stats.
+   * Entries are keyed by interned interface and method names,
+   * the last slot is reserved for everything that does not fit.
+   */
+  struct CallStatsTable {
+      static const int SIZE = 16;
+
+      CallStats entries[SIZE];
+      int size = 0;
+
+      CallStats* lookup(const char *iface, const char *method);
+      void reset();
+  };
+
+  CallStatsTable& callStats();
+
+  /**
+   * Record the completion of a call started at the given monotonic time.
+   */
+  void recordCall(CallStats *stats, gint64 start, const GException &error);
+
+  std::ostream& operator<<(std::ostream&, const CallStats&);
+
+}
+
+#endif /* GDBUS_STATS_H_ */
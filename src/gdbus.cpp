@@ -1,6 +1,7 @@
 #include <string>
 
 #include "gdbus.h"
+#include "gdbus-stats.h"
 #include "closure.h"
 #include "gexception.h"
 
@@ -8,6 +9,8 @@ using namespace std;
 using namespace gdbus;
 using namespace closure;
 
+static const char *NEW_PROXY = "(new)";
+
 template<typename T, typename V>
 static void finish(
     const Result<T> &result,
@@ -31,13 +34,18 @@ namespace gdbus {
       GDBusInterfaceInfo *info,
       GCancellable *cancellable) {
 
+    CallStats *stats = callStats().lookup(ifaceName, NEW_PROXY);
+    gint64 start = g_get_monotonic_time();
+    stats->calls++;
+
     Result<PGDBusProxy> result;
     Promise<PGDBusProxy> promise = result;
-    Closure<void(GObject*, GAsyncResult*)> c = [result](
+    Closure<void(GObject*, GAsyncResult*)> c = [result, stats, start](
         GObject *source,
         GAsyncResult *res) {
       GException error;
       PGDBusProxy proxy(g_dbus_proxy_new_for_bus_finish(res, error.get()));
+      recordCall(stats, start, error);
       finish(result, error, proxy);
     };
 
@@ -67,14 +75,21 @@ namespace gdbus {
       return rejected<PUGVariant>(invalid_argument("Proxy is null"));
     }
 
+    CallStats *stats = callStats().lookup(
+        g_dbus_proxy_get_interface_name(proxy.get()),
+        methodName);
+    gint64 start = g_get_monotonic_time();
+    stats->calls++;
+
     Result<PUGVariant> result;
     Promise<PUGVariant> promise = result;
-    Closure<void(GObject*, GAsyncResult*)> c = [result](
+    Closure<void(GObject*, GAsyncResult*)> c = [result, stats, start](
         GObject *source,
         GAsyncResult *res) {
       GException error;
       PUGVariant value(g_dbus_proxy_call_finish(
           (GDBusProxy*) source, res, error.get()));
+      recordCall(stats, start, error);
       finish(result, error, move(value));
     };
 
@@ -116,6 +131,11 @@ namespace gdbus {
   void gVariantGet<void>(GVariant*) {
   }
 
+  template<>
+  bool gVariantGet<bool>(GVariant *value) {
+    return g_variant_get_boolean(value);
+  }
+
   template<>
   int gVariantGet<int>(GVariant *value) {
     return g_variant_get_int32(value);
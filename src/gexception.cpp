@@ -1,4 +1,5 @@
 #include <utility>
+#include <gio/gio.h>
 
 #include "gexception.h"
 
@@ -55,6 +56,109 @@ const char* GException::what() const noexcept {
   return ptr ? ptr->message : "No reason";
 }
 
+static GException::Kind dbusErrorKind(int code) noexcept {
+  switch (code) {
+    case G_DBUS_ERROR_NO_REPLY:
+    case G_DBUS_ERROR_TIMEOUT:
+    case G_DBUS_ERROR_TIMED_OUT:
+      return GException::TIMEOUT;
+    case G_DBUS_ERROR_SERVICE_UNKNOWN:
+    case G_DBUS_ERROR_NAME_HAS_NO_OWNER:
+      return GException::SERVICE_UNKNOWN;
+    case G_DBUS_ERROR_DISCONNECTED:
+    case G_DBUS_ERROR_NO_SERVER:
+      return GException::DISCONNECTED;
+    case G_DBUS_ERROR_ACCESS_DENIED:
+    case G_DBUS_ERROR_AUTH_FAILED:
+      return GException::ACCESS_DENIED;
+    case G_DBUS_ERROR_UNKNOWN_METHOD:
+    case G_DBUS_ERROR_UNKNOWN_OBJECT:
+    case G_DBUS_ERROR_UNKNOWN_INTERFACE:
+    case G_DBUS_ERROR_UNKNOWN_PROPERTY:
+    case G_DBUS_ERROR_NOT_SUPPORTED:
+      return GException::UNKNOWN_METHOD;
+    case G_DBUS_ERROR_INVALID_ARGS:
+    case G_DBUS_ERROR_INVALID_SIGNATURE:
+    case G_DBUS_ERROR_PROPERTY_READ_ONLY:
+      return GException::INVALID_ARGS;
+    default:
+      return GException::OTHER;
+  }
+}
+
+static GException::Kind ioErrorKind(int code) noexcept {
+  switch (code) {
+    case G_IO_ERROR_CANCELLED:
+      return GException::CANCELLED;
+    case G_IO_ERROR_TIMED_OUT:
+      return GException::TIMEOUT;
+    case G_IO_ERROR_CLOSED:
+    case G_IO_ERROR_BROKEN_PIPE:
+    case G_IO_ERROR_NOT_CONNECTED:
+      return GException::DISCONNECTED;
+    case G_IO_ERROR_PERMISSION_DENIED:
+      return GException::ACCESS_DENIED;
+    case G_IO_ERROR_NOT_SUPPORTED:
+      return GException::UNKNOWN_METHOD;
+    case G_IO_ERROR_INVALID_ARGUMENT:
+      return GException::INVALID_ARGS;
+    default:
+      return GException::OTHER;
+  }
+}
+
+GException::Kind GException::kind() const noexcept {
+  if (!ptr)
+    return NONE;
+  if (ptr->domain == G_DBUS_ERROR)
+    return dbusErrorKind(ptr->code);
+  if (ptr->domain == G_IO_ERROR)
+    return ioErrorKind(ptr->code);
+  return OTHER;
+}
+
+bool GException::isTransient() const noexcept {
+  return isTransient(kind());
+}
+
+bool GException::isPermanent() const noexcept {
+  return isPermanent(kind());
+}
+
+bool GException::isTransient(Kind kind) noexcept {
+  switch (kind) {
+    case TIMEOUT:
+    case SERVICE_UNKNOWN:
+    case DISCONNECTED:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool GException::isPermanent(Kind kind) noexcept {
+  switch (kind) {
+    case ACCESS_DENIED:
+    case UNKNOWN_METHOD:
+    case INVALID_ARGS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+GException::Kind GException::kindOf(const std::exception_ptr &ex) noexcept {
+  if (!ex)
+    return NONE;
+  try {
+    std::rethrow_exception(ex);
+  } catch (const GException &e) {
+    return e.kind();
+  } catch (...) {
+    return OTHER;
+  }
+}
+
 bool operator==(const GException &a, const GException &b) noexcept {
   return a.ptr == b.ptr;
 }
@@ -5,6 +5,23 @@
 #include <glib.h>
 
 class GException: public std::exception {
+  public:
+    /**
+     * Error categories, from G_DBUS_ERROR and G_IO_ERROR domains.
+     * Errors from other domains are classified as OTHER.
+     */
+    enum Kind {
+      NONE,
+      OTHER,
+      CANCELLED,
+      TIMEOUT,
+      SERVICE_UNKNOWN,
+      DISCONNECTED,
+      ACCESS_DENIED,
+      UNKNOWN_METHOD,
+      INVALID_ARGS
+    };
+
   private:
     GError *ptr;
 
@@ -27,6 +44,27 @@ class GException: public std::exception {
 
     const char* what() const noexcept;
 
+    Kind kind() const noexcept;
+
+    /**
+     * Error may go away by itself, for example service restarting.
+     * Worth retrying.
+     */
+    bool isTransient() const noexcept;
+
+    /**
+     * Error will not go away by retrying the same call.
+     */
+    bool isPermanent() const noexcept;
+
+    static bool isTransient(Kind) noexcept;
+    static bool isPermanent(Kind) noexcept;
+
+    /**
+     * Kind of the exception, OTHER if it is not a GException.
+     */
+    static Kind kindOf(const std::exception_ptr&) noexcept;
+
     friend bool operator==(const GException &a, const GException &b) noexcept;
 
     friend bool operator!=(const GException &a, const GException &b) noexcept;
@@ -6,17 +6,20 @@
 
 using namespace std;
 using namespace promise;
+using namespace fixed;
 
 static const Logger logger("[IdleAware]");
 
 struct IdleAwarePrivate {
     static Promise<void> addIdleWatch(IdleAware *self);
+    static Promise<void> armActiveWatch(IdleAware *self);
     static void onBrightnessChanged(IdleAware *self);
     static void onActive(IdleAware *self);
     static void onIdle(IdleAware *self);
-    static Promise<void> updateAsync(IdleAware *self);
-    static Promise<void> updateIdle(IdleAware *self);
-    static Promise<void> updateInactive(IdleAware *self);
+    static void onArmed(IdleAware *self);
+    static void onInactive(IdleAware *self);
+    static void onUntracked(IdleAware *self, const exception_ptr &ex);
+    static void updatePending(IdleAware *self);
     static void updateBrightness(IdleAware *self);
     static string flagsToString(int flags);
 };
@@ -50,76 +53,109 @@ Promise<void> IdleAwarePrivate::addIdleWatch(IdleAware *self) {
   };
 }
 
+Promise<void> IdleAwarePrivate::armActiveWatch(IdleAware *self) {
+  if (self->activeWatchId)
+    return self->idleMonitor.rearmWatch(self->activeWatchId);
+
+  Promise<void*> p = self->idleMonitor.addUserActiveWatch([=] {
+    timeoutOnActive(self->inactiveTimeout, self);
+  }, true);
+
+  return p << [=](void *id) {
+    self->activeWatchId = id;
+  };
+}
+
 void IdleAwarePrivate::onBrightnessChanged(IdleAware *self) {
-  LOGGER(logger) << "Brightness changed: " << self->proxy.getBrightness()
-      << ", current: " << self->brightness
+  LOGGER(logger) << "Brightness changed: " << self->proxy->getBrightness()
+      << ", current: " << toDouble(self->brightness)
       << ", flags: " << flagsToString(self->flags)
       << endl;
 
+  /* the first change while idle is the session dimming the screen,
+   * once the user active watch is armed to tell when it ends, unless
+   * it is the echo of the value set */
   if (self->flags == IdleAware::IDLE) {
-    updateAsync(self).grab(PROMISE_LOG_EX);
-  } else {
-    updateBrightness(self);
+    if (!self->armed) {
+      self->pending = true;
+      return;
+    }
+    if (toInt(self->brightness) != self->proxy->getBrightness())
+      onInactive(self);
   }
+  updateBrightness(self);
 }
 
 void IdleAwarePrivate::onActive(IdleAware *self) {
+  bool inactive = self->isInactive();
   self->flags = IdleAware::NONE;
-  LOGGER(logger) << "Active, brightness: " << self->brightness << endl;
-  self->proxy.setBrightness(self->brightness).grab(PROMISE_LOG_EX);
+  self->armed = false;
+  self->pending = false;
+  LOGGER(logger) << "Active, brightness: " << toDouble(self->brightness)
+      << endl;
+  self->proxy->setBrightnessFixed(self->brightness).grab(PROMISE_LOG_EX);
+  if (inactive)
+    self->inactiveChanged();
 }
 
 void IdleAwarePrivate::onIdle(IdleAware *self) {
+  if (self->flags & IdleAware::IDLE)
+    return;
+
   self->flags |= IdleAware::IDLE;
+  armActiveWatch(self).then([=] {
+    onArmed(self);
+  }, [=](exception_ptr ex) {
+    onUntracked(self, ex);
+  });
 }
 
-Promise<void> IdleAwarePrivate::updateAsync(IdleAware *self) {
-  return updateIdle(self) << [=] {
-    return updateInactive(self);
-  } << [=] {
-    updateBrightness(self);
-  };
+void IdleAwarePrivate::onArmed(IdleAware *self) {
+  if (!(self->flags & IdleAware::IDLE))
+    return;
+
+  self->armed = true;
+  updatePending(self);
 }
 
-Promise<void> IdleAwarePrivate::updateIdle(IdleAware *self) {
-  if (self->flags != IdleAware::IDLE)
-    return resolved();
+void IdleAwarePrivate::onInactive(IdleAware *self) {
+  self->flags |= IdleAware::INACTIVE;
+  self->inactiveCount++;
+  LOGGER(logger) << "Inactive, count: " << self->inactiveCount << endl;
+  self->inactiveChanged();
+}
 
-  return self->idleMonitor.getIdleTime() << [=](long idleTime) {
-    if (idleTime < self->idleInterval) {
-      self->flags = IdleAware::NONE;
-    } else {
-      LOGGER(logger) << "Idle, time: " << idleTime << endl;
-    }
-  };
+void IdleAwarePrivate::onUntracked(
+    IdleAware *self,
+    const exception_ptr &ex) {
+  /* without the user active watch the idle state would never end */
+  LOGGER_WARN(logger) << "Cannot watch user activity: " << ex << endl;
+  self->flags &= ~IdleAware::IDLE;
+  updatePending(self);
 }
 
-Promise<void> IdleAwarePrivate::updateInactive(IdleAware *self) {
-  if (self->flags != IdleAware::IDLE)
-    return resolved();
+void IdleAwarePrivate::updatePending(IdleAware *self) {
+  if (!self->pending)
+    return;
 
-  self->inactiveCount++;
-  return self->idleMonitor.addUserActiveWatch([=] {
-    timeoutOnActive(self->inactiveTimeout, self);
-  }) << [=](...) {
-    self->flags |= IdleAware::INACTIVE;
-    LOGGER(logger) << "Inactive, count: " << self->inactiveCount << endl;
-  };
+  self->pending = false;
+  onBrightnessChanged(self);
 }
 
 void IdleAwarePrivate::updateBrightness(IdleAware *self) {
   if (self->flags & IdleAware::DISABLED)
     return;
 
+  /* compared at 1%, backends may quantize the brightness set */
   if ((self->flags & IdleAware::INACTIVE)
-      && self->brightness != self->proxy.getBrightness()) {
+      && toInt(self->brightness) != self->proxy->getBrightness()) {
 
     self->flags |= IdleAware::DISABLED;
     LOGGER(logger) << "Disabled" << endl;
     return;
   }
 
-  self->brightness = self->proxy.getBrightness();
+  self->brightness = self->proxy->getBrightnessFixed();
   self->brightnessChanged();
 }
 
@@ -143,8 +179,8 @@ Promise<void> IdleAware::pingService() {
   };
 }
 
-IdleAware::IdleAware() {
-  proxy.brightnessChanged << [=] {
+IdleAware::IdleAware(IBrightnessProxy *proxy) : proxy(proxy) {
+  proxy->brightnessChanged << [=] {
     IdleAwarePrivate::onBrightnessChanged(this);
   };
 }
@@ -154,16 +190,25 @@ IdleAware::~IdleAware() {
 }
 
 Promise<void> IdleAware::connect() {
-  return proxy.connect() << [=] {
+  return proxy->connect() << [=] {
     return idleMonitor.connect();
   } << [=] {
     return IdleAwarePrivate::addIdleWatch(this);
   };
 }
 
+void IdleAware::supervise(Supervisor *supervisor) {
+  proxy->supervise(supervisor);
+  idleMonitor.supervise(supervisor);
+}
+
 Promise<void> IdleAware::setBrightness(int value) {
-  LOGGER(logger) << "Setting brightness: " << value
-      << ", current: " << brightness
+  return setBrightnessFixed(fromInt(value));
+}
+
+Promise<void> IdleAware::setBrightnessFixed(Q16 value) {
+  LOGGER(logger) << "Setting brightness: " << toDouble(value)
+      << ", current: " << toDouble(brightness)
       << ", flags: " << IdleAwarePrivate::flagsToString(flags)
       << endl;
 
@@ -172,13 +217,27 @@ Promise<void> IdleAware::setBrightness(int value) {
   if (flags & DISABLED)
     return resolved();
 
-  return proxy.setBrightness(value);
+  return proxy->setBrightnessFixed(value);
 }
 
 int IdleAware::getBrightness() const {
-  return proxy.getBrightness();
+  return proxy->getBrightness();
+}
+
+Q16 IdleAware::getBrightnessFixed() const {
+  return proxy->getBrightnessFixed();
+}
+
+Q16 IdleAware::getResolution() const {
+  return proxy->getResolution();
+}
+
+bool IdleAware::isInactive() const {
+  return flags & (INACTIVE | DISABLED);
 }
 
 void IdleAware::updateDebugInfo(DebugInfo *info) const {
   info->flags = flags;
+  info->idleRefreshTime = idleMonitor.getRefreshTime();
+  info->idleEventsLost = idleMonitor.getLostEvents();
 }
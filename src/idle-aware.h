@@ -1,10 +1,18 @@
 #ifndef IDLE_AWARE_H_
 #define IDLE_AWARE_H_
 
+#include <memory>
+
 #include "brightness.h"
 #include "idle-monitor.h"
 #include "debug-info.h"
 
+/**
+ * Idle state is driven by watch events only: the idle watch sets it,
+ * a persistent user active watch, rearmed on every idle, clears it.
+ * A brightness change while idle, once the watch is armed, is the
+ * session dimming the screen: the session is then inactive.
+ */
 class IdleAware: public IBrightnessProxy {
     friend class IdleAwarePrivate;
 
@@ -15,17 +23,25 @@ class IdleAware: public IBrightnessProxy {
       DISABLED = 1 << 2
     };
 
-    BrightnessProxy proxy;
-    int brightness = -1;
+    std::unique_ptr<IBrightnessProxy> proxy;
+    fixed::Q16 brightness = fixed::fromInt(-1);
     int flags = NONE;
 
     IdleMonitorProxy idleMonitor;
     long idleInterval = 5000;
     void *idleWatchId = 0;
+    void *activeWatchId = 0;
     long inactiveTimeout = 500;
     int inactiveCount = 0;
+    bool armed = false;
+    bool pending = false;
 
   public:
+    /**
+     * Emitted when the session dims the screen on idle, and when the
+     * user is active again.
+     */
+    signals::Signal<void()> inactiveChanged;
 
     /**
      * Ping the service.
@@ -33,12 +49,27 @@ class IdleAware: public IBrightnessProxy {
      */
     static promise::Promise<void> pingService();
 
-    IdleAware();
+    IdleAware(IBrightnessProxy *proxy);
     ~IdleAware();
 
     promise::Promise<void> connect();
+
+    /**
+     * Reconnect to services when they restart.
+     * Supervisor must not outlive this.
+     */
+    void supervise(Supervisor*);
+
     promise::Promise<void> setBrightness(int);
     int getBrightness() const;
+    promise::Promise<void> setBrightnessFixed(fixed::Q16);
+    fixed::Q16 getBrightnessFixed() const;
+    fixed::Q16 getResolution() const;
+
+    /**
+     * Screen dimmed by the session while idle.
+     */
+    bool isInactive() const;
 
     void updateDebugInfo(DebugInfo*) const;
 };
@@ -1,4 +1,6 @@
 #include <string.h>
+#include <memory>
+#include <unordered_map>
 
 #include "idle-monitor.h"
 
@@ -25,16 +27,23 @@ static const Method<void()> _resetIdletime {
     "ResetIdletime"
 };
 
+static const char *SERVICE = "org.gnome.Mutter.IdleMonitor";
+
 const Logger IdleMonitorProxy::logger(::logger);
 
 struct IdleMonitorProxyPrivate {
+    struct Refresh {
+        int oldKey = 0;
+        int newKey = 0;
+        bool swapped = false;
+    };
+    using Batch = unordered_map<void*, Refresh>;
+
     static void setProxy(IdleMonitorProxy *self, PGDBusProxy proxy);
     static void onWatchFired(IdleMonitorProxy *self, int key);
     static WatchBase* findWatch(IdleMonitorProxy *self, void *id);
-    static Promise<void> refreshKey(IdleMonitorProxy *self, void *id);
-    static Promise<void> refreshKeys(
-        IdleMonitorProxy *self,
-        const list<void*> &ids);
+    static void swapKeys(IdleMonitorProxy *self, Batch &batch);
+    static void replay(IdleMonitorProxy *self);
     static bool compareAndSetKey(
         IdleMonitorProxy *self,
         void *id,
@@ -45,7 +54,7 @@ struct IdleMonitorProxyPrivate {
 static Promise<PGDBusProxy> newProxy() {
   return newForBus(
       G_BUS_TYPE_SESSION,
-      "org.gnome.Mutter.IdleMonitor",
+      SERVICE,
       "/org/gnome/Mutter/IdleMonitor/Core",
       "org.gnome.Mutter.IdleMonitor");
 }
@@ -63,21 +72,6 @@ static void onSignal(
   }
 }
 
-static void onOwnerChanged(
-    GObject *object,
-    GParamSpec *pspec,
-    gpointer user_data) {
-  GDBusProxy *proxy = G_DBUS_PROXY(object);
-  // TODO: check pointer type is correct
-  unique_ptr<char> owner(g_dbus_proxy_get_name_owner(proxy));
-  LOGGER_DEBUG(logger) << "Owner changed: " << owner.get() << endl;
-  if (!owner)
-    return;
-
-  IdleMonitorProxy *self = (IdleMonitorProxy*) user_data;
-  self->refreshAll().grab(PROMISE_LOG_EX);
-}
-
 void IdleMonitorProxyPrivate::setProxy(
     IdleMonitorProxy *self,
     PGDBusProxy proxy) {
@@ -96,12 +90,6 @@ void IdleMonitorProxyPrivate::setProxy(
         "g-signal",
         G_CALLBACK(onSignal),
         self);
-
-    g_signal_connect(
-        proxy.get(),
-        "notify::g-name-owner",
-        G_CALLBACK(onOwnerChanged),
-        self);
   }
 }
 
@@ -110,6 +98,13 @@ void IdleMonitorProxyPrivate::onWatchFired(
     int key) {
   int handled = 0;
   self->watchFired(key, handled);
+
+  /* could be a new key not yet swapped in */
+  if (!handled && self->refreshing) {
+    self->deferred.push_back(key);
+    return;
+  }
+
   if (handled != 1) {
     LOGGER_WARN(logger) << "watchFired handled: " << handled << endl;
   }
@@ -126,45 +121,48 @@ WatchBase* IdleMonitorProxyPrivate::findWatch(
   return nullptr;
 }
 
-Promise<void> IdleMonitorProxyPrivate::refreshKey(
+void IdleMonitorProxyPrivate::swapKeys(
     IdleMonitorProxy *self,
-    void *id) {
-  WatchBase *watch = findWatch(self, id);
-  if (!watch)
-    return rejected<void>(invalid_argument("Watch not found"));
-
-  Promise<unsigned int> p = watch->interval ?
-      _addIdleWatch(self->proxy, watch->interval) :
-      _addUserActiveWatch(self->proxy);
+    Batch &batch) {
+  for (const WatchFired::P &handler : self->watchFired.handlers()) {
+    auto itr = batch.find(handler->pdata());
+    if (itr == batch.end())
+      continue;
 
-  int oldKey = watch->key;
+    WatchBase *watch = (WatchBase*) handler->pdata();
+    Refresh &refresh = itr->second;
+    if (refresh.newKey && watch->key == refresh.oldKey) {
+      watch->key = refresh.newKey;
+      refresh.swapped = true;
+    }
+  }
 
-  return p << [=](int newKey) {
-    if (compareAndSetKey(self, id, oldKey, newKey)) {
-      LOGGER_INFO(logger) << "Refreshed "
-          << (watch->interval ? "idle" : "user active")
-          << " watch: " << oldKey << " -> " << newKey
-          << endl;
+  for (const auto &entry : batch) {
+    const Refresh &refresh = entry.second;
+    if (!refresh.newKey) {
+      LOGGER_ERROR(logger) << "Failed to refresh watch: "
+          << refresh.oldKey << endl;
+    } else if (!refresh.swapped) {
+      /* fired or removed in the meantime */
+      _removeWatch(self->proxy, refresh.newKey).grab(PROMISE_LOG_EX);
     } else {
-      LOGGER_ERROR(logger) << "Failed to refresh "
-          << (watch->interval ? "idle" : "user active")
-          << " watch: " << oldKey << " -> " << newKey
-          << endl;
+      LOGGER_DEBUG(logger) << "Refreshed watch: " << refresh.oldKey
+          << " -> " << refresh.newKey << endl;
     }
-  };
+  }
 }
 
-Promise<void> IdleMonitorProxyPrivate::refreshKeys(
-    IdleMonitorProxy *self,
-    const list<void*> &ids) {
-  Result<void> result;
-  Promise<void> promise = result;
-  ResolveLatch rl = result;
-  LogException eh = PROMISE_LOG_EX;
-  for (void *id : ids) {
-    refreshKey(self, id).then(rl, eh);
+void IdleMonitorProxyPrivate::replay(IdleMonitorProxy *self) {
+  vector<int> keys;
+  keys.swap(self->deferred);
+  for (int key : keys) {
+    int handled = 0;
+    self->watchFired(key, handled);
+    if (!handled) {
+      self->lostEvents++;
+      LOGGER_WARN(logger) << "Lost event of watch: " << key << endl;
+    }
   }
-  return promise;
 }
 
 bool IdleMonitorProxyPrivate::compareAndSetKey(
@@ -210,6 +208,27 @@ Promise<int> IdleMonitorProxy::addUserActiveWatch() {
   return _addUserActiveWatch(proxy);
 }
 
+Promise<void> IdleMonitorProxy::rearmWatch(void *id) {
+  WatchBase *watch = IdleMonitorProxyPrivate::findWatch(this, id);
+  if (!watch)
+    return rejected<void>(invalid_argument("Watch not found"));
+
+  if (watch->key)
+    return resolved();
+
+  return _addUserActiveWatch(proxy) << [=](int key) {
+    if (!key)
+      throw runtime_error("Service returned invalid key");
+
+    if (IdleMonitorProxyPrivate::compareAndSetKey(this, id, 0, key)) {
+      LOGGER_DEBUG(logger) << "Rearmed user active watch: " << key << endl;
+    } else {
+      /* rearmed or removed in the meantime */
+      _removeWatch(proxy, key).grab(PROMISE_LOG_EX);
+    }
+  };
+}
+
 Promise<void> IdleMonitorProxy::removeWatch(void *id) {
   WatchBase *watch = IdleMonitorProxyPrivate::findWatch(this, id);
   if (!watch)
@@ -219,6 +238,9 @@ Promise<void> IdleMonitorProxy::removeWatch(void *id) {
 
   watchFired.remove(id);
 
+  if (!key)
+    return resolved();
+
   Promise<void> p = _removeWatch(proxy, key);
   if (logger.isDebug()) {
     p.then([=] {
@@ -244,17 +266,63 @@ Promise<void> IdleMonitorProxy::removeAll() {
 }
 
 Promise<void> IdleMonitorProxy::refreshAll() {
-  list<void*> ids;
+  using Batch = IdleMonitorProxyPrivate::Batch;
+
+  gint64 start = g_get_monotonic_time();
+  shared_ptr<Batch> batch(new Batch);
+  vector<WatchBase*> watches;
+
   Result<void> result;
   Promise<void> promise = result;
   ResolveLatch rl = result;
   LogException eh = PROMISE_LOG_EX;
+
+  /* calls are served in order, removals go first so that
+   * none of them can hit a new key that happens to be the same */
   for (const WatchFired::P &handler : watchFired.handlers()) {
-    ids.push_back(handler->pdata());
     WatchBase *watch = (WatchBase*) handler->pdata();
+    if (!watch->key)
+      continue;
+
+    (*batch)[watch].oldKey = watch->key;
+    watches.push_back(watch);
     _removeWatch(proxy, watch->key).then(rl, eh);
   }
+
+  for (WatchBase *watch : watches) {
+    Promise<unsigned int> p = watch->interval ?
+        _addIdleWatch(proxy, watch->interval) :
+        _addUserActiveWatch(proxy);
+    (p << [=](int key) {
+      (*batch)[watch].newKey = key;
+    }).then(rl, eh);
+  }
+
+  refreshing++;
   return promise << [=] {
-    return IdleMonitorProxyPrivate::refreshKeys(this, ids);
+    IdleMonitorProxyPrivate::swapKeys(this, *batch);
+    if (--refreshing)
+      return;
+
+    size_t deferred = this->deferred.size();
+    IdleMonitorProxyPrivate::replay(this);
+    refreshTime = (g_get_monotonic_time() - start) / 1000;
+    LOGGER_INFO(logger) << "Refreshed " << batch->size() << " watches in "
+        << refreshTime << "ms, events deferred: " << deferred
+        << ", lost: " << lostEvents << endl;
   };
 }
+
+long IdleMonitorProxy::getRefreshTime() const {
+  return refreshTime;
+}
+
+unsigned long long IdleMonitorProxy::getLostEvents() const {
+  return lostEvents;
+}
+
+void IdleMonitorProxy::supervise(Supervisor *supervisor) {
+  supervisor->watch(G_BUS_TYPE_SESSION, SERVICE, [=] {
+    return refreshAll();
+  });
+}
@@ -2,10 +2,12 @@
 #define IDLE_MONITOR_H_
 
 #include <stdexcept>
+#include <vector>
 
 #include "gdbus.h"
 #include "promise.h"
 #include "signals.h"
+#include "supervisor.h"
 #include "logger.h"
 
 namespace idle {
@@ -20,24 +22,35 @@ namespace idle {
       WatchFired *signal = nullptr;
       int key = 0;
       long interval = 0;
+      bool persistent = false;
   };
 
   template<typename Fn>
   struct Watch: public WatchBase {
       Fn handler;
 
-      Watch(WatchFired *signal, int key, long interval, const Fn &handler) :
+      Watch(
+          WatchFired *signal,
+          int key,
+          long interval,
+          const Fn &handler,
+          bool persistent = false) :
           handler(handler) {
         this->signal = signal;
         this->key = key;
         this->interval = interval;
+        this->persistent = persistent;
       }
 
       void operator()(int key, int &handled) {
         if (this->key != key)
           return;
 
-        if (!interval)
+        /* user active watches fire once, a persistent one
+         * stays disarmed until it is rearmed */
+        if (!interval && persistent)
+          this->key = 0;
+        else if (!interval)
           signal->remove(*this);
 
         handler();
@@ -55,6 +68,11 @@ class IdleMonitorProxy {
     gdbus::PGDBusProxy proxy;
     idle::WatchFired watchFired;
 
+    int refreshing = 0;
+    std::vector<int> deferred;
+    long refreshTime = -1;
+    unsigned long long lostEvents = 0;
+
     promise::Promise<int> addIdleWatch(long interval);
     promise::Promise<int> addUserActiveWatch();
 
@@ -81,22 +99,54 @@ class IdleMonitorProxy {
       };
     }
 
+    /**
+     * A persistent watch is kept when it fires, see rearmWatch.
+     */
     template<typename Fn>
-    promise::Promise<void*> addUserActiveWatch(const Fn &handler) {
+    promise::Promise<void*> addUserActiveWatch(
+        const Fn &handler,
+        bool persistent = false) {
       using Watch = idle::Watch<Fn>;
       return addUserActiveWatch() << [=](int key) {
         if (!key)
           throw std::runtime_error("Service returned invalid key");
 
         LOGGER_DEBUG(logger) << "Added user active watch: " << key << std::endl;
-        return watchFired << Watch(&watchFired, key, 0, handler);
+        return watchFired << Watch(&watchFired, key, 0, handler, persistent);
       };
     }
 
+    /**
+     * Arm again a persistent user active watch that has fired,
+     * nothing to do if it is still armed.
+     */
+    promise::Promise<void> rearmWatch(void *id);
     promise::Promise<void> removeWatch(void *id);
     promise::Promise<void> resetIdleTime();
     promise::Promise<void> removeAll();
+
+    /**
+     * Register all watches again, all at once.
+     * Keys are swapped when every call is done, events fired meanwhile
+     * for the new keys are delivered then.
+     */
     promise::Promise<void> refreshAll();
+
+    /**
+     * Duration of the last refresh in milliseconds, -1 if none.
+     */
+    long getRefreshTime() const;
+
+    /**
+     * Events that could not be delivered after a refresh.
+     */
+    unsigned long long getLostEvents() const;
+
+    /**
+     * Refresh all watches when the service restarts.
+     * Supervisor must not outlive this.
+     */
+    void supervise(Supervisor*);
 };
 
 #endif /* IDLE_MONITOR_H_ */
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "iio-sensor.h"
+#include "sysfs.h"
+#include "gexception.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+using namespace sysfs;
+
+using Unit = IioSensor::Unit;
+using ScanFormat = IioSensor::ScanFormat;
+
+static const Logger logger("[IioSensor]");
+
+const char *IioSensor::DEFAULT_ROOT = "/sys/bus/iio/devices";
+
+const char *IioSensor::DEFAULT_DEV_ROOT = "/dev";
+
+static const char *CHANNELS[] = { "in_illuminance", "in_illuminance0" };
+
+struct IioSensorPrivate {
+    static bool probe(IioSensor *self, const string &name);
+    static void find(IioSensor *self);
+    static double toLux(IioSensor *self, double raw);
+    static void setLightLevel(IioSensor *self, double value);
+    static void setStale(IioSensor *self, bool value);
+    static void poll(IioSensor *self);
+    static bool startBuffer(IioSensor *self);
+    static void stopBuffer(IioSensor *self);
+    static void startPolling(IioSensor *self);
+    static bool onReadable(IioSensor *self, GIOCondition condition);
+};
+
+struct ScanElement {
+    string channel;
+    int index;
+    ScanFormat format;
+};
+
+static gboolean gPoll(gpointer user_data) {
+  IioSensor *self = (IioSensor*) user_data;
+  try {
+    IioSensorPrivate::poll(self);
+  } catch (const exception &e) {
+    LOGGER_ERROR(logger) << "Cannot read light level: " << e.what() << endl;
+    IioSensorPrivate::setStale(self, true);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean gOnReadable(
+    gint fd,
+    GIOCondition condition,
+    gpointer user_data) {
+  IioSensor *self = (IioSensor*) user_data;
+  return IioSensorPrivate::onReadable(self, condition);
+}
+
+static bool endsWith(const string &s, const string &suffix) {
+  return s.size() >= suffix.size()
+      && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/* scan elements enabled in the buffer, by index */
+static vector<ScanElement> readScanElements(const string &dir) {
+  vector<ScanElement> elements;
+
+  GException error;
+  GDir *gdir = g_dir_open(dir.c_str(), 0, error.get());
+  if (!gdir)
+    throw error;
+
+  const char *name;
+  while ((name = g_dir_read_name(gdir))) {
+    string entry(name);
+    if (!endsWith(entry, "_en"))
+      continue;
+
+    string channel = entry.substr(0, entry.size() - 3);
+    string base = dir + "/" + channel;
+    if (!readInt(base + "_en"))
+      continue;
+
+    ScanElement element;
+    element.channel = channel;
+    element.index = readInt(base + "_index");
+    if (!IioSensor::parseFormat(readString(base + "_type"), element.format))
+      throw runtime_error("Invalid scan element type: " + base);
+    elements.push_back(element);
+  }
+  g_dir_close(gdir);
+
+  sort(elements.begin(), elements.end(),
+      [](const ScanElement &a, const ScanElement &b) {
+        return a.index < b.index;
+      });
+  return elements;
+}
+
+bool IioSensorPrivate::probe(IioSensor *self, const string &name) {
+  string path = self->root + "/" + name;
+  for (const char *channel : CHANNELS) {
+    string base = path + "/" + channel;
+    string attribute;
+    if (exists(base + "_input")) {
+      attribute = base + "_input";
+    } else if (exists(base + "_raw")) {
+      attribute = base + "_raw";
+    } else {
+      continue;
+    }
+
+    self->name = name;
+    self->path = path;
+    self->channel = channel;
+    self->attribute = attribute;
+    self->raw = endsWith(attribute, "_raw");
+
+    bool scaled = exists(base + "_scale");
+    if (self->raw) {
+      if (scaled)
+        self->scale = readDouble(base + "_scale");
+      if (exists(base + "_offset"))
+        self->offset = readDouble(base + "_offset");
+    }
+
+    /* raw values without scale are in device units */
+    self->unit = !self->raw || scaled ? Unit::LUX : Unit::VENDOR;
+    return true;
+  }
+  return false;
+}
+
+void IioSensorPrivate::find(IioSensor *self) {
+  if (!self->name.empty()) {
+    if (!probe(self, self->name))
+      throw runtime_error("No illuminance channel on " + self->name);
+    return;
+  }
+
+  GException error;
+  GDir *dir = g_dir_open(self->root.c_str(), 0, error.get());
+  if (!dir)
+    throw error;
+
+  vector<string> names;
+  const char *name;
+  while ((name = g_dir_read_name(dir))) {
+    if (g_str_has_prefix(name, "iio:device"))
+      names.push_back(name);
+  }
+  g_dir_close(dir);
+
+  sort(names.begin(), names.end());
+  for (const string &name : names) {
+    if (probe(self, name))
+      return;
+  }
+
+  throw runtime_error("No light sensor in " + self->root);
+}
+
+inline double IioSensorPrivate::toLux(IioSensor *self, double raw) {
+  return (raw + self->offset) * self->scale;
+}
+
+void IioSensorPrivate::setLightLevel(IioSensor *self, double value) {
+  setStale(self, false);
+  if (self->lightLevel == value)
+    return;
+
+  self->lightLevel = value;
+  self->lightLevelChanged();
+}
+
+void IioSensorPrivate::setStale(IioSensor *self, bool value) {
+  if (self->stale == value)
+    return;
+
+  self->stale = value;
+  self->staleChanged();
+}
+
+void IioSensorPrivate::poll(IioSensor *self) {
+  double value = readDouble(self->attribute);
+  setLightLevel(self, self->raw ? toLux(self, value) : value);
+}
+
+bool IioSensorPrivate::startBuffer(IioSensor *self) {
+  /* only raw samples are buffered */
+  string scanDir = self->path + "/scan_elements";
+  string enable = self->path + "/buffer/enable";
+  if (!self->raw || !exists(scanDir) || !exists(enable))
+    return false;
+
+  string dev = self->devRoot + "/" + self->name;
+  try {
+    writeInt(scanDir + "/" + self->channel + "_en", 1);
+    self->scanEnabled = true;
+
+    ScanFormat &format = self->format;
+    unsigned size = 0;
+    unsigned align = 1;
+    bool found = false;
+    for (const ScanElement &element : readScanElements(scanDir)) {
+      unsigned storage = element.format.storage;
+      size = (size + storage - 1) / storage * storage;
+      if (element.channel == self->channel) {
+        format = element.format;
+        format.offset = size;
+        found = true;
+      }
+      size += storage;
+      align = max(align, storage);
+    }
+    if (!found) {
+      stopBuffer(self);
+      return false;
+    }
+    format.size = (size + align - 1) / align * align;
+
+    self->fd = open(dev.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (self->fd < 0) {
+      LOGGER_WARN(logger) << "Cannot open " << dev << ": "
+          << g_strerror(errno) << endl;
+      stopBuffer(self);
+      return false;
+    }
+
+    writeInt(enable, 1);
+  } catch (const exception &e) {
+    LOGGER_WARN(logger) << "Cannot enable buffer: " << e.what() << endl;
+    stopBuffer(self);
+    return false;
+  }
+
+  self->sourceId = g_unix_fd_add(
+      self->fd,
+      (GIOCondition) (G_IO_IN | G_IO_HUP | G_IO_ERR),
+      gOnReadable,
+      self);
+
+  LOGGER(logger) << "Streaming from " << dev
+      << ", sample size: " << self->format.size << endl;
+  return true;
+}
+
+void IioSensorPrivate::stopBuffer(IioSensor *self) {
+  if (self->fd >= 0) {
+    close(self->fd);
+    self->fd = -1;
+    self->pending.clear();
+
+    try {
+      writeInt(self->path + "/buffer/enable", 0);
+    } catch (const exception &e) {
+      LOGGER_WARN(logger) << "Cannot disable buffer: " << e.what() << endl;
+    }
+  }
+
+  /* scan elements can be changed only with the buffer disabled */
+  if (self->scanEnabled) {
+    self->scanEnabled = false;
+    try {
+      writeInt(self->path + "/scan_elements/" + self->channel + "_en", 0);
+    } catch (const exception &e) {
+      LOGGER_WARN(logger) << "Cannot disable scan element: " << e.what()
+          << endl;
+    }
+  }
+}
+
+void IioSensorPrivate::startPolling(IioSensor *self) {
+  if (self->pollInterval > 0)
+    self->sourceId = g_timeout_add(self->pollInterval, gPoll, self);
+}
+
+bool IioSensorPrivate::onReadable(IioSensor *self, GIOCondition condition) {
+  guint8 buffer[4096];
+  ssize_t n;
+  while ((n = read(self->fd, buffer, sizeof(buffer))) > 0) {
+    self->pending.append((const char*) buffer, n);
+  }
+  /* before the light level handlers may change it */
+  int error = n < 0 ? errno : 0;
+
+  const ScanFormat &format = self->format;
+  size_t count = self->pending.size() / format.size;
+  if (count) {
+    /* only the latest sample matters */
+    const guint8 *sample = (const guint8*) self->pending.data()
+        + (count - 1) * format.size;
+    setLightLevel(self, toLux(self, IioSensor::decode(format, sample)));
+    self->pending.erase(0, count * format.size);
+  }
+
+  if (error == EAGAIN || error == EINTR)
+    return G_SOURCE_CONTINUE;
+
+  /* end of stream or error, fall back to polling */
+  LOGGER_WARN(logger) << "Buffer closed, polling " << self->attribute << endl;
+  self->sourceId = 0;
+  stopBuffer(self);
+  startPolling(self);
+  return G_SOURCE_REMOVE;
+}
+
+IioSensor::IioSensor(
+    const string &name,
+    const string &root,
+    const string &devRoot,
+    long pollInterval) :
+    name(name),
+    root(root),
+    devRoot(devRoot),
+    pollInterval(pollInterval) {
+}
+
+IioSensor::~IioSensor() {
+  if (sourceId)
+    g_source_remove(sourceId);
+  IioSensorPrivate::stopBuffer(this);
+}
+
+Promise<void> IioSensor::connect() {
+  if (!path.empty())
+    return resolved();
+
+  try {
+    IioSensorPrivate::find(this);
+    LOGGER(logger) << "Using " << attribute << endl;
+    IioSensorPrivate::poll(this);
+  } catch (...) {
+    path.clear();
+    return rejected<void>(current_exception());
+  }
+
+  if (!IioSensorPrivate::startBuffer(this))
+    IioSensorPrivate::startPolling(this);
+
+  return resolved();
+}
+
+Promise<void> IioSensor::suspend() {
+  if (sourceId) {
+    g_source_remove(sourceId);
+    sourceId = 0;
+  }
+  IioSensorPrivate::stopBuffer(this);
+  return resolved();
+}
+
+Promise<void> IioSensor::resume() {
+  if (path.empty() || sourceId || fd >= 0)
+    return resolved();
+
+  try {
+    IioSensorPrivate::poll(this);
+  } catch (...) {
+    return rejected<void>(current_exception());
+  }
+
+  if (!IioSensorPrivate::startBuffer(this))
+    IioSensorPrivate::startPolling(this);
+
+  return resolved();
+}
+
+double IioSensor::getLightLevel() const {
+  return lightLevel;
+}
+
+IioSensor::Unit IioSensor::getUnit() const {
+  return unit;
+}
+
+bool IioSensor::isStale() const {
+  return stale;
+}
+
+bool IioSensor::isBuffered() const {
+  return fd >= 0;
+}
+
+const string& IioSensor::getName() const {
+  return name;
+}
+
+bool IioSensor::parseFormat(const string &type, ScanFormat &format) {
+  char endian;
+  char sign;
+  unsigned bits;
+  unsigned storage;
+  unsigned shift = 0;
+  int n = sscanf(type.c_str(), "%ce:%c%u/%u>>%u",
+      &endian, &sign, &bits, &storage, &shift);
+  if (n < 4)
+    return false;
+  if (endian != 'b' && endian != 'l')
+    return false;
+  if (sign != 's' && sign != 'u')
+    return false;
+  if (storage != 8 && storage != 16 && storage != 32 && storage != 64)
+    return false;
+  if (!bits || bits + shift > storage)
+    return false;
+
+  format.be = endian == 'b';
+  format.sign = sign == 's';
+  format.bits = bits;
+  format.shift = shift;
+  format.storage = storage / 8;
+  return true;
+}
+
+long long IioSensor::decode(const ScanFormat &format, const guint8 *sample) {
+  const guint8 *p = sample + format.offset;
+  unsigned long long value = 0;
+  for (unsigned i = 0; i < format.storage; i++) {
+    unsigned byte = format.be ? i : format.storage - 1 - i;
+    value = (value << 8) | p[byte];
+  }
+
+  value >>= format.shift;
+  if (format.bits < 64)
+    value &= (1ULL << format.bits) - 1;
+
+  if (format.sign && format.bits < 64 && (value >> (format.bits - 1)) & 1)
+    value |= ~0ULL << format.bits;
+
+  return (long long) value;
+}
@@ -0,0 +1,107 @@
+#ifndef IIO_SENSOR_H_
+#define IIO_SENSOR_H_
+
+#include <string>
+#include <glib.h>
+
+#include "promise.h"
+#include "sensor.h"
+
+/**
+ * Ambient light sensor read directly from an IIO device, without
+ * iio-sensor-proxy.
+ * Samples are streamed from the buffered character device when it can
+ * be enabled, otherwise the illuminance attribute is polled.
+ */
+class IioSensor: public ISensor {
+    friend class IioSensorPrivate;
+
+  public:
+    static const char *DEFAULT_ROOT;
+    static const char *DEFAULT_DEV_ROOT;
+
+    /**
+     * Layout of the illuminance channel in buffered samples.
+     */
+    struct ScanFormat {
+        bool be = false;
+        bool sign = false;
+        unsigned bits = 0;
+        unsigned shift = 0;
+        unsigned offset = 0;
+        unsigned storage = 0;
+        unsigned size = 0;
+    };
+
+  private:
+    std::string name;
+    std::string root;
+    std::string devRoot;
+    long pollInterval;
+
+    std::string path;
+    std::string channel;
+    std::string attribute;
+    bool raw = false;
+    double scale = 1;
+    double offset = 0;
+    ScanFormat format;
+
+    double lightLevel = 0;
+    Unit unit = Unit::UNKNOWN;
+    bool stale = false;
+
+    int fd = -1;
+    bool scanEnabled = false;
+    guint sourceId = 0;
+    std::string pending;
+
+  public:
+    /**
+     * Use the named device, or the first one with an illuminance
+     * channel if name is empty.
+     */
+    IioSensor(
+        const std::string &name = "",
+        const std::string &root = DEFAULT_ROOT,
+        const std::string &devRoot = DEFAULT_DEV_ROOT,
+        long pollInterval = 500);
+    IioSensor(const IioSensor&) = delete;
+    IioSensor& operator=(const IioSensor&) = delete;
+    ~IioSensor();
+
+    promise::Promise<void> connect();
+
+    /**
+     * Stop streaming or polling, until resumed.
+     */
+    promise::Promise<void> suspend();
+    promise::Promise<void> resume();
+
+    double getLightLevel() const;
+    Unit getUnit() const;
+
+    /**
+     * Polling the attribute failed, until a read succeeds.
+     */
+    bool isStale() const;
+
+    /**
+     * True if samples are streamed from the character device.
+     */
+    bool isBuffered() const;
+
+    const std::string& getName() const;
+
+    /**
+     * Parse a scan element type, for example "le:u16/16>>0".
+     */
+    static bool parseFormat(const std::string &type, ScanFormat &format);
+
+    /**
+     * Decode the channel value from a sample.
+     */
+    static long long decode(const ScanFormat &format, const guint8 *sample);
+};
+
+#endif /* IIO_SENSOR_H_ */
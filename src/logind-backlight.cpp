@@ -0,0 +1,62 @@
+#include "logind-backlight.h"
+#include "logger.h"
+
+using namespace std;
+using namespace gdbus;
+using namespace promise;
+
+static const Logger logger("[LogindBacklight]");
+
+static const char *SERVICE = "org.freedesktop.login1";
+
+static const Method<void(const char*, const char*, guint32)> sessionSetBrightness {
+    "SetBrightness",
+    "(ssu)" };
+
+const char *LogindBacklight::DEFAULT_SESSION_PATH =
+    "/org/freedesktop/login1/session/auto";
+
+struct LogindBacklightPrivate {
+    static Promise<void> ensureProxy(LogindBacklight *self);
+};
+
+Promise<void> LogindBacklightPrivate::ensureProxy(LogindBacklight *self) {
+  if (self->proxy)
+    return resolved();
+
+  /* only calls are needed, properties would be loaded synchronously */
+  GDBusProxyFlags flags = (GDBusProxyFlags) (
+      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+      G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+      G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START);
+
+  return newForBus(
+      G_BUS_TYPE_SYSTEM,
+      SERVICE,
+      self->sessionPath.c_str(),
+      "org.freedesktop.login1.Session",
+      flags) << [=](PGDBusProxy proxy) {
+    LOGGER(logger) << "Session: " << self->sessionPath << endl;
+    self->proxy = proxy;
+  };
+}
+
+LogindBacklight::LogindBacklight(
+    const string &root,
+    const string &sessionPath) :
+    SysfsBacklight(root),
+    sessionPath(sessionPath) {
+}
+
+Promise<void> LogindBacklight::connect() {
+  return LogindBacklightPrivate::ensureProxy(this) << [=] {
+    return SysfsBacklight::connect();
+  };
+}
+
+Promise<void> LogindBacklight::writeRaw(const Device &device, int raw) {
+  if (!proxy)
+    return rejected<void>(logic_error("Not connected"));
+
+  return sessionSetBrightness(proxy, "backlight", device.name.c_str(), raw);
+}
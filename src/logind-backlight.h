@@ -0,0 +1,31 @@
+#ifndef LOGIND_BACKLIGHT_H_
+#define LOGIND_BACKLIGHT_H_
+
+#include "sysfs-backlight.h"
+#include "gdbus.h"
+
+/**
+ * Backlight devices are discovered and read from sysfs, but written
+ * through logind Session.SetBrightness, that does not require write
+ * permissions on the devices for processes in an active session.
+ */
+class LogindBacklight: public SysfsBacklight {
+    friend class LogindBacklightPrivate;
+
+    std::string sessionPath;
+    gdbus::PGDBusProxy proxy;
+
+  public:
+    static const char *DEFAULT_SESSION_PATH;
+
+    LogindBacklight(
+        const std::string &root = DEFAULT_ROOT,
+        const std::string &sessionPath = DEFAULT_SESSION_PATH);
+
+    promise::Promise<void> connect();
+
+  protected:
+    promise::Promise<void> writeRaw(const Device &device, int raw);
+};
+
+#endif /* LOGIND_BACKLIGHT_H_ */
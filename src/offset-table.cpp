@@ -0,0 +1,84 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "offset-table.h"
+
+using namespace std;
+using namespace fixed;
+
+inline static int clamp(int value, int min, int max) {
+  if (value < min)
+    return min;
+  if (value > max)
+    return max;
+  return value;
+}
+
+/* bucket position of level, in Q16 */
+inline static Q16 position(Q16 level) {
+  level = clamp(level, 0, fromInt(100));
+  return scale(level, OffsetTable::SIZE - 1, 100);
+}
+
+int OffsetTable::get(Q16 level) const {
+  Q16 pos = position(level);
+  int i = pos >> SHIFT;
+  if (i == SIZE - 1)
+    return offsets[i];
+  return toInt(lerp(
+      fromInt(offsets[i]),
+      fromInt(offsets[i + 1]),
+      pos & (ONE - 1)));
+}
+
+bool OffsetTable::learn(Q16 level, int offset) {
+  int delta = clamp(offset, -100, 100) - get(level);
+  if (!delta)
+    return false;
+
+  /* buckets around the level take the whole correction */
+  Q16 pos = position(level);
+  int low = pos >> SHIFT;
+  int high = (pos & (ONE - 1)) ? low + 1 : low;
+
+  bool changed = false;
+  for (int i = 0; i < SIZE; i++) {
+    int distance = i < low ? low - i : i > high ? i - high : 0;
+    int step = round(delta * pow(decay, distance));
+    int value = clamp(offsets[i] + step, -100, 100);
+    if (offsets[i] != value) {
+      offsets[i] = value;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void OffsetTable::fill(int offset) {
+  offset = clamp(offset, -100, 100);
+  for (int i = 0; i < SIZE; i++)
+    offsets[i] = offset;
+}
+
+vector<int16_t> OffsetTable::pack() const {
+  return vector<int16_t>(offsets, offsets + SIZE);
+}
+
+void OffsetTable::unpack(const vector<int16_t> &packed) {
+  if (packed.size() != SIZE)
+    throw invalid_argument("Offset table size mismatch");
+  for (int i = 0; i < SIZE; i++)
+    offsets[i] = clamp(packed[i], -100, 100);
+}
+
+bool OffsetTable::operator==(const OffsetTable &other) const {
+  for (int i = 0; i < SIZE; i++) {
+    if (offsets[i] != other.offsets[i])
+      return false;
+  }
+  return true;
+}
+
+bool OffsetTable::operator!=(const OffsetTable &other) const {
+  return !(*this == other);
+}
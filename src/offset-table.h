@@ -0,0 +1,59 @@
+#ifndef OFFSET_TABLE_H_
+#define OFFSET_TABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "fixed.h"
+
+/**
+ * Offsets learnt per ambient level, in buckets evenly spread over the
+ * normalized levels from 0 to 100, that are log lux with the default
+ * input curve.
+ * The offset at a level is interpolated between the two buckets around
+ * it, a correction moves both of them and decays towards the others.
+ */
+class OffsetTable {
+  public:
+    static const int SIZE = 32;
+
+  private:
+    int8_t offsets[SIZE] = {};
+
+  public:
+    /**
+     * Fraction of a correction kept by each further bucket.
+     */
+    double decay = 0.5;
+
+    /**
+     * Offset at level, rounded.
+     */
+    int get(fixed::Q16 level) const;
+
+    /**
+     * Move the offset at level to offset, return whether the table
+     * changed.
+     */
+    bool learn(fixed::Q16 level, int offset);
+
+    /**
+     * Same offset at every level.
+     */
+    void fill(int offset);
+
+    /**
+     * Offsets by bucket, for storage.
+     */
+    std::vector<int16_t> pack() const;
+
+    /**
+     * Throws invalid_argument if the packed table has a different size.
+     */
+    void unpack(const std::vector<int16_t> &packed);
+
+    bool operator==(const OffsetTable &other) const;
+    bool operator!=(const OffsetTable &other) const;
+};
+
+#endif /* OFFSET_TABLE_H_ */
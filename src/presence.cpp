@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "presence.h"
+#include "logger.h"
+
+using namespace std;
+using namespace gdbus;
+using namespace promise;
+
+static const Logger logger("[Presence]");
+
+static const char *SCREEN_SAVER = "org.gnome.ScreenSaver";
+static const char *LOGIN = "org.freedesktop.login1";
+
+static const Method<bool()> _getActive {
+    "GetActive"
+};
+
+const char *Presence::DEFAULT_SESSION_PATH =
+    "/org/freedesktop/login1/session/auto";
+
+struct PresencePrivate {
+    static Promise<void> connectScreenSaver(Presence *self);
+    static Promise<void> connectSession(Presence *self);
+    static Promise<void> connectManager(Presence *self);
+    static Promise<void> updateScreenSaver(Presence *self);
+    static void updateSession(Presence *self);
+    static void updateManager(Presence *self);
+    static void setScreenSaverActive(Presence *self, bool value);
+    static void setSessionActive(Presence *self, bool value);
+    static void setSleeping(Presence *self, bool value);
+    static void setLidClosed(Presence *self, bool value);
+};
+
+static Promise<void> tolerate(const Promise<void> &promise, const char *what) {
+  return promise.then([] {
+  }, [=](exception_ptr ex) {
+    LOGGER_WARN(logger) << "Cannot watch " << what << ": " << ex << endl;
+  });
+}
+
+static void onScreenSaverSignal(
+    GDBusProxy *proxy,
+    const gchar *sender_name,
+    const gchar *signal_name,
+    GVariant *parameters,
+    gpointer user_data) {
+  Presence *self = (Presence*) user_data;
+  if (strcmp(signal_name, "ActiveChanged") == 0) {
+    bool active = gVariantGetChild<bool>(parameters, 0);
+    PresencePrivate::setScreenSaverActive(self, active);
+  }
+}
+
+static void onManagerSignal(
+    GDBusProxy *proxy,
+    const gchar *sender_name,
+    const gchar *signal_name,
+    GVariant *parameters,
+    gpointer user_data) {
+  Presence *self = (Presence*) user_data;
+  if (strcmp(signal_name, "PrepareForSleep") == 0) {
+    bool sleeping = gVariantGetChild<bool>(parameters, 0);
+    PresencePrivate::setSleeping(self, sleeping);
+  }
+}
+
+static void onSessionPropertiesChanged(
+    GDBusProxy *proxy,
+    GVariant *changed_properties,
+    const gchar *const*invalidated_properties,
+    gpointer user_data) {
+  Presence *self = (Presence*) user_data;
+  PresencePrivate::updateSession(self);
+}
+
+static void onManagerPropertiesChanged(
+    GDBusProxy *proxy,
+    GVariant *changed_properties,
+    const gchar *const*invalidated_properties,
+    gpointer user_data) {
+  Presence *self = (Presence*) user_data;
+  PresencePrivate::updateManager(self);
+}
+
+Promise<void> PresencePrivate::connectScreenSaver(Presence *self) {
+  if (self->screenSaver)
+    return updateScreenSaver(self);
+
+  return newForBus(
+      G_BUS_TYPE_SESSION,
+      SCREEN_SAVER,
+      "/org/gnome/ScreenSaver",
+      SCREEN_SAVER) << [=](PGDBusProxy proxy) {
+    self->screenSaver = proxy;
+    g_signal_connect(
+        proxy.get(),
+        "g-signal",
+        G_CALLBACK(onScreenSaverSignal),
+        self);
+    return updateScreenSaver(self);
+  };
+}
+
+Promise<void> PresencePrivate::connectSession(Presence *self) {
+  if (self->session)
+    return resolved();
+
+  return newForBus(
+      G_BUS_TYPE_SYSTEM,
+      LOGIN,
+      self->sessionPath.c_str(),
+      "org.freedesktop.login1.Session") << [=](PGDBusProxy proxy) {
+    self->session = proxy;
+    g_signal_connect(
+        proxy.get(),
+        "g-properties-changed",
+        G_CALLBACK(onSessionPropertiesChanged),
+        self);
+    updateSession(self);
+  };
+}
+
+Promise<void> PresencePrivate::connectManager(Presence *self) {
+  if (self->manager)
+    return resolved();
+
+  return newForBus(
+      G_BUS_TYPE_SYSTEM,
+      LOGIN,
+      "/org/freedesktop/login1",
+      "org.freedesktop.login1.Manager",
+      G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START) << [=](PGDBusProxy proxy) {
+    self->manager = proxy;
+    g_signal_connect(
+        proxy.get(),
+        "g-signal",
+        G_CALLBACK(onManagerSignal),
+        self);
+    g_signal_connect(
+        proxy.get(),
+        "g-properties-changed",
+        G_CALLBACK(onManagerPropertiesChanged),
+        self);
+    updateManager(self);
+  };
+}
+
+Promise<void> PresencePrivate::updateScreenSaver(Presence *self) {
+  return _getActive(self->screenSaver) << [=](bool active) {
+    setScreenSaverActive(self, active);
+  };
+}
+
+void PresencePrivate::updateSession(Presence *self) {
+  PUGVariant active(
+      g_dbus_proxy_get_cached_property(self->session.get(), "Active"));
+  if (active)
+    setSessionActive(self, g_variant_get_boolean(active.get()));
+}
+
+void PresencePrivate::updateManager(Presence *self) {
+  PUGVariant lidClosed(
+      g_dbus_proxy_get_cached_property(self->manager.get(), "LidClosed"));
+  if (lidClosed)
+    setLidClosed(self, g_variant_get_boolean(lidClosed.get()));
+}
+
+void PresencePrivate::setScreenSaverActive(Presence *self, bool value) {
+  if (self->screenSaverActive == value)
+    return;
+
+  LOGGER(logger) << "Screen saver active: " << value << endl;
+  self->screenSaverActive = value;
+  self->changed();
+}
+
+void PresencePrivate::setSessionActive(Presence *self, bool value) {
+  if (self->sessionActive == value)
+    return;
+
+  LOGGER(logger) << "Session active: " << value << endl;
+  self->sessionActive = value;
+  self->changed();
+}
+
+void PresencePrivate::setSleeping(Presence *self, bool value) {
+  if (self->sleeping == value)
+    return;
+
+  LOGGER(logger) << (value ? "Going to sleep" : "Resumed") << endl;
+  self->sleeping = value;
+  if (!value)
+    self->resumed();
+  self->changed();
+}
+
+void PresencePrivate::setLidClosed(Presence *self, bool value) {
+  if (self->lidClosed == value)
+    return;
+
+  LOGGER(logger) << "Lid closed: " << value << endl;
+  self->lidClosed = value;
+  self->changed();
+}
+
+Presence::Presence(const string &sessionPath) : sessionPath(sessionPath) {
+}
+
+Presence::~Presence() {
+  if (screenSaver)
+    g_signal_handlers_disconnect_by_data(screenSaver.get(), this);
+  if (session)
+    g_signal_handlers_disconnect_by_data(session.get(), this);
+  if (manager)
+    g_signal_handlers_disconnect_by_data(manager.get(), this);
+}
+
+Promise<void> Presence::connect() {
+  return tolerate(PresencePrivate::connectScreenSaver(this), "screen saver")
+      << [=] {
+        return tolerate(PresencePrivate::connectSession(this), "session");
+      } << [=] {
+        return tolerate(PresencePrivate::connectManager(this), "sleep");
+      };
+}
+
+void Presence::supervise(Supervisor *supervisor) {
+  supervisor->watch(G_BUS_TYPE_SESSION, SCREEN_SAVER, [=] {
+    return PresencePrivate::connectScreenSaver(this);
+  });
+}
+
+void Presence::setUserIdle(bool value) {
+  if (userIdle == value)
+    return;
+
+  LOGGER(logger) << "User idle: " << value << endl;
+  userIdle = value;
+  changed();
+}
+
+bool Presence::isPresent() const {
+  return sessionActive && !screenSaverActive && !sleeping && !lidClosed
+      && !userIdle;
+}
+
+bool Presence::isScreenSaverActive() const {
+  return screenSaverActive;
+}
+
+bool Presence::isSessionActive() const {
+  return sessionActive;
+}
+
+bool Presence::isSleeping() const {
+  return sleeping;
+}
+
+bool Presence::isLidClosed() const {
+  return lidClosed;
+}
+
+bool Presence::isUserIdle() const {
+  return userIdle;
+}
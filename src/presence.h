@@ -0,0 +1,69 @@
+#ifndef PRESENCE_H_
+#define PRESENCE_H_
+
+#include <string>
+
+#include "gdbus.h"
+#include "signals.h"
+#include "supervisor.h"
+
+/**
+ * Whether someone may be looking at the screen: the screen saver is not
+ * active, the logind session is active, the lid is open, the user is
+ * not idle and the system is not going to sleep.
+ * Services that cannot be reached are assumed present.
+ */
+class Presence {
+    friend class PresencePrivate;
+
+    std::string sessionPath;
+    gdbus::PGDBusProxy screenSaver;
+    gdbus::PGDBusProxy session;
+    gdbus::PGDBusProxy manager;
+    bool screenSaverActive = false;
+    bool sessionActive = true;
+    bool sleeping = false;
+    bool lidClosed = false;
+    bool userIdle = false;
+
+  public:
+    static const char *DEFAULT_SESSION_PATH;
+
+    signals::Signal<void()> changed;
+
+    /**
+     * Emitted on resume from sleep, before changed.
+     */
+    signals::Signal<void()> resumed;
+
+    Presence(const std::string &sessionPath = DEFAULT_SESSION_PATH);
+    Presence(const Presence&) = delete;
+    Presence& operator=(const Presence&) = delete;
+    ~Presence();
+
+    /**
+     * Watch the screen saver, the session, sleep and the lid, failures
+     * are only logged.
+     */
+    promise::Promise<void> connect();
+
+    /**
+     * Read the screen saver state again when it restarts.
+     * Supervisor must not outlive this.
+     */
+    void supervise(Supervisor*);
+
+    /**
+     * Screen dimmed by the session for idle, see IdleAware.
+     */
+    void setUserIdle(bool);
+
+    bool isPresent() const;
+    bool isScreenSaverActive() const;
+    bool isSessionActive() const;
+    bool isSleeping() const;
+    bool isLidClosed() const;
+    bool isUserIdle() const;
+};
+
+#endif /* PRESENCE_H_ */
@@ -0,0 +1,102 @@
+#include "quiescence.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+
+static const Logger logger("[Quiescence]");
+
+struct QuiescencePrivate {
+    static void update(Quiescence *self);
+    static void onSample(Quiescence *self);
+};
+
+void QuiescencePrivate::update(Quiescence *self) {
+  bool quiescent = self->enabled && !self->presence->isPresent();
+  if (self->quiescent == quiescent)
+    return;
+
+  gint64 now = g_get_monotonic_time();
+  if (self->quiescent)
+    self->quiescentTime += now - self->since;
+  else
+    self->activeTime += now - self->since;
+  self->since = now;
+  self->quiescent = quiescent;
+
+  if (quiescent) {
+    LOGGER(logger) << "Quiescent, releasing sensor" << endl;
+    self->sensor->suspend().grab(PROMISE_LOG_EX);
+    self->changed();
+  } else {
+    LOGGER(logger) << "Active, claiming sensor, quiescent for: "
+        << self->getQuiescentTime(now) << "ms" << endl;
+    /* sensors may emit the first sample before resume returns */
+    self->changed();
+    self->sensor->resume().grab(PROMISE_LOG_EX);
+  }
+}
+
+void QuiescencePrivate::onSample(Quiescence *self) {
+  if (self->quiescent)
+    self->quiescentSamples++;
+  else
+    self->activeSamples++;
+}
+
+Quiescence::Quiescence(ISensor *sensor, Presence *presence) :
+    sensor(sensor),
+    presence(presence),
+    since(g_get_monotonic_time()) {
+
+  sensorId = sensor->lightLevelChanged << [=] {
+    QuiescencePrivate::onSample(this);
+  };
+  presenceId = presence->changed << [=] {
+    QuiescencePrivate::update(this);
+  };
+}
+
+Quiescence::~Quiescence() {
+  sensor->lightLevelChanged.remove(sensorId);
+  presence->changed.remove(presenceId);
+}
+
+void Quiescence::setEnabled(bool value) {
+  enabled = value;
+  QuiescencePrivate::update(this);
+}
+
+bool Quiescence::isEnabled() const {
+  return enabled;
+}
+
+bool Quiescence::isQuiescent() const {
+  return quiescent;
+}
+
+long Quiescence::getQuiescentTime(gint64 now) const {
+  gint64 time = quiescentTime;
+  if (quiescent)
+    time += now - since;
+  return time / 1000;
+}
+
+unsigned long long Quiescence::getWakeupsAvoided(gint64 now) const {
+  gint64 active = activeTime;
+  if (!quiescent)
+    active += now - since;
+  if (active <= 0)
+    return 0;
+
+  double expected = (double) activeSamples * getQuiescentTime(now) * 1000
+      / active;
+  if (expected <= quiescentSamples)
+    return 0;
+  return expected - quiescentSamples;
+}
+
+void Quiescence::updateDebugInfo(DebugInfo *info) const {
+  info->quiescentTime = getQuiescentTime();
+  info->wakeupsAvoided = getWakeupsAvoided();
+}
@@ -0,0 +1,64 @@
+#ifndef QUIESCENCE_H_
+#define QUIESCENCE_H_
+
+#include <glib.h>
+
+#include "sensor.h"
+#include "presence.h"
+#include "signals.h"
+#include "debug-info.h"
+
+/**
+ * Suspends the sensor while nobody is present, resuming it on presence.
+ * Wakeups avoided are estimated from the sample rate seen while active,
+ * less the samples still received while quiescent.
+ */
+class Quiescence {
+    friend class QuiescencePrivate;
+
+    ISensor *sensor;
+    Presence *presence;
+    void *sensorId = nullptr;
+    void *presenceId = nullptr;
+
+    bool enabled = true;
+    bool quiescent = false;
+    gint64 since;
+    gint64 activeTime = 0;
+    gint64 quiescentTime = 0;
+    unsigned long long activeSamples = 0;
+    unsigned long long quiescentSamples = 0;
+
+  public:
+    /**
+     * Emitted after the sensor is suspended, and before it is resumed.
+     */
+    signals::Signal<void()> changed;
+
+    /**
+     * Neither sensor nor presence are owned.
+     */
+    Quiescence(ISensor *sensor, Presence *presence);
+    Quiescence(const Quiescence&) = delete;
+    Quiescence& operator=(const Quiescence&) = delete;
+    ~Quiescence();
+
+    /**
+     * When disabled the sensor is resumed and kept running.
+     */
+    void setEnabled(bool);
+    bool isEnabled() const;
+    bool isQuiescent() const;
+
+    /**
+     * Total time spent quiescent in milliseconds.
+     */
+    long getQuiescentTime(gint64 now = g_get_monotonic_time()) const;
+
+    unsigned long long getWakeupsAvoided(
+        gint64 now = g_get_monotonic_time()) const;
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+#endif /* QUIESCENCE_H_ */
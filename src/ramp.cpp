@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <algorithm>
+
+#include "ramp.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+using namespace fixed;
+
+static const Logger logger("[Ramp]");
+
+struct RampPrivate {
+    static Promise<void> step(Ramp *self, bool &done);
+    static Promise<void> write(Ramp *self, Q16 value);
+    static void finish(Ramp *self);
+    static void stop(Ramp *self);
+    static Q16 tolerance(const Ramp *self);
+    static bool hasEchoes(const Ramp *self);
+    static bool isEcho(Ramp *self, Q16 value);
+    static void onBrightnessChanged(Ramp *self);
+};
+
+static gboolean gOnStep(gpointer user_data) {
+  Ramp *self = (Ramp*) user_data;
+  bool done;
+  RampPrivate::step(self, done).grab(PROMISE_LOG_EX);
+  return done ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+
+/* done when the target is reached */
+Promise<void> RampPrivate::step(Ramp *self, bool &done) {
+  gint64 now = g_get_monotonic_time();
+  gint64 dt = now - self->time;
+  self->time = now;
+
+  Q16 delta = fromDouble(self->rate * dt / 1000000.0);
+  Q16 resolution = self->proxy->getResolution();
+  if (delta < resolution)
+    delta = resolution;
+
+  Q16 d = self->target - self->current;
+  done = abs(d) <= delta;
+  if (done) {
+    Promise<void> promise = write(self, self->target);
+    finish(self);
+    return promise;
+  }
+
+  return write(self, self->current + (d > 0 ? delta : -delta));
+}
+
+Promise<void> RampPrivate::write(Ramp *self, Q16 value) {
+  if (!hasEchoes(self))
+    self->echoes = false;
+
+  self->current = value;
+  if (!self->echoes || value < self->low)
+    self->low = value;
+  if (!self->echoes || value > self->high)
+    self->high = value;
+  self->echoes = true;
+  self->written = g_get_monotonic_time();
+
+  self->steps++;
+  self->stats.steps++;
+  return self->proxy->setBrightnessFixed(value);
+}
+
+void RampPrivate::finish(Ramp *self) {
+  self->timerId = 0;
+  self->stats.transitions++;
+  self->stats.lastSteps = self->steps;
+
+  LOGGER_DEBUG(logger) << "Reached: " << toDouble(self->target)
+      << ", steps: " << self->steps << endl;
+  self->steps = 0;
+
+  /* backends that apply writes at once have no echoes left,
+   * the others are in range until confirmed or the window ends */
+  if (abs(self->proxy->getBrightnessFixed() - self->current) <= HALF)
+    self->echoes = false;
+}
+
+void RampPrivate::stop(Ramp *self) {
+  if (self->timerId) {
+    g_source_remove(self->timerId);
+    self->timerId = 0;
+  }
+}
+
+/* backends may report the brightness quantized to their steps */
+inline Q16 RampPrivate::tolerance(const Ramp *self) {
+  return max(HALF, self->proxy->getResolution());
+}
+
+/* echoes not seen in time are not coming */
+inline bool RampPrivate::hasEchoes(const Ramp *self) {
+  return self->echoes && (self->timerId
+      || g_get_monotonic_time() - self->written <= self->echoWindow * 1000);
+}
+
+inline bool RampPrivate::isEcho(Ramp *self, Q16 value) {
+  return hasEchoes(self)
+      && value >= self->low - tolerance(self)
+      && value <= self->high + tolerance(self);
+}
+
+void RampPrivate::onBrightnessChanged(Ramp *self) {
+  Q16 brightness = self->proxy->getBrightnessFixed();
+
+  if (isEcho(self, brightness)) {
+    self->stats.echoes++;
+    if (!self->timerId && abs(brightness - self->current) <= HALF)
+      self->echoes = false;
+    return;
+  }
+
+  if (self->timerId) {
+    LOGGER(logger) << "Cancelled by brightness change: "
+        << toDouble(brightness)
+        << ", target: " << toDouble(self->target) << endl;
+    stop(self);
+    self->stats.cancelled++;
+    self->stats.lastSteps = self->steps;
+    self->steps = 0;
+  }
+
+  self->echoes = false;
+  self->target = brightness;
+  self->current = brightness;
+  self->brightnessChanged();
+}
+
+Ramp::Ramp(IBrightnessProxy *proxy) : proxy(proxy) {
+  bchid = proxy->brightnessChanged << [=] {
+    RampPrivate::onBrightnessChanged(this);
+  };
+}
+
+Ramp::~Ramp() {
+  proxy->brightnessChanged.remove(bchid);
+  RampPrivate::stop(this);
+}
+
+Promise<void> Ramp::connect() {
+  return proxy->connect();
+}
+
+Promise<void> Ramp::setBrightness(int value) {
+  return setBrightnessFixed(fromInt(value));
+}
+
+int Ramp::getBrightness() const {
+  return toInt(getBrightnessFixed());
+}
+
+Promise<void> Ramp::setBrightnessFixed(Q16 value) {
+  if (value < 0)
+    value = 0;
+  if (value > fromInt(100))
+    value = fromInt(100);
+
+  target = value;
+  if (timerId && rate > 0 && !atOnce)
+    return resolved();
+
+  if (!RampPrivate::hasEchoes(this)) {
+    echoes = false;
+    current = proxy->getBrightnessFixed();
+  }
+
+  /* nothing to ramp from, rate dropped to 0 in flight, or asked to */
+  if (rate <= 0 || current < 0 || atOnce) {
+    RampPrivate::stop(this);
+    return RampPrivate::write(this, value);
+  }
+
+  if (current == value)
+    return resolved();
+
+  steps = 0;
+  time = g_get_monotonic_time() - interval * 1000;
+  bool done;
+  Promise<void> promise = RampPrivate::step(this, done);
+  if (!done)
+    timerId = g_timeout_add(interval, gOnStep, this);
+  return promise;
+}
+
+Q16 Ramp::getBrightnessFixed() const {
+  return timerId || RampPrivate::hasEchoes(this) ?
+      target : proxy->getBrightnessFixed();
+}
+
+Q16 Ramp::getResolution() const {
+  return proxy->getResolution();
+}
+
+void Ramp::setAtOnce(bool value) {
+  atOnce = value;
+}
+
+bool Ramp::isRamping() const {
+  return timerId;
+}
+
+const Ramp::Stats& Ramp::getStats() const {
+  return stats;
+}
+
+void Ramp::updateDebugInfo(DebugInfo *info) const {
+  info->rampSteps = stats.lastSteps;
+}
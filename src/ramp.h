@@ -0,0 +1,92 @@
+#ifndef RAMP_H_
+#define RAMP_H_
+
+#include <glib.h>
+
+#include "brightness.h"
+#include "debug-info.h"
+
+/**
+ * Moves the brightness of the wrapped proxy towards the value set at
+ * a limited rate, one write per interval at most.
+ * A new value retargets the ramp in flight, a brightness change not
+ * caused by the ramp cancels it and is passed on.
+ * Brightness reads return the target while ramping, so that changes
+ * made by the ramp itself are not seen as changes of the user.
+ * Echoes are matched within the backend resolution, for a limited time
+ * after the last write.
+ */
+class Ramp: public IBrightnessProxy {
+    friend class RampPrivate;
+
+  public:
+    struct Stats {
+        unsigned long long transitions = 0;
+        unsigned long long cancelled = 0;
+        unsigned long long steps = 0;
+        unsigned long lastSteps = 0;
+        unsigned long long echoes = 0;
+    };
+
+  private:
+    IBrightnessProxy *proxy;
+    void *bchid = nullptr;
+    guint timerId = 0;
+    gint64 time = 0;
+
+    fixed::Q16 target = 0;
+    fixed::Q16 current = 0;
+
+    /* range written by the ramp, changes in it are echoes */
+    bool echoes = false;
+    fixed::Q16 low = 0;
+    fixed::Q16 high = 0;
+    gint64 written = 0;
+
+    bool atOnce = false;
+    unsigned long steps = 0;
+    Stats stats;
+
+  public:
+    /**
+     * Percent per second, 0 to set brightness at once.
+     */
+    double rate = 40;
+
+    /**
+     * Milliseconds between writes.
+     */
+    long interval = 50;
+
+    /**
+     * Milliseconds after the last write within which echoes are expected.
+     */
+    long echoWindow = 2000;
+
+    Ramp(IBrightnessProxy *proxy);
+    Ramp(const Ramp&) = delete;
+    Ramp& operator=(const Ramp&) = delete;
+    ~Ramp();
+
+    promise::Promise<void> connect();
+
+    promise::Promise<void> setBrightness(int);
+    int getBrightness() const;
+    promise::Promise<void> setBrightnessFixed(fixed::Q16);
+    fixed::Q16 getBrightnessFixed() const;
+    fixed::Q16 getResolution() const;
+
+    /**
+     * While set, values set are written at once, ending the ramp in
+     * flight.
+     */
+    void setAtOnce(bool);
+
+    bool isRamping() const;
+
+    const Stats& getStats() const;
+
+    void updateDebugInfo(DebugInfo*) const;
+};
+
+#endif /* RAMP_H_ */
@@ -0,0 +1,154 @@
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include "replay.h"
+#include "gexception.h"
+
+using namespace std;
+
+using Sample = Replay::Sample;
+using Result = Replay::Result;
+
+static const gint64 MS = 1000;
+
+struct ReplayPrivate {
+    struct Run {
+        Result &result;
+        IFilter *filter;
+        DeadBand *deadBand;
+        int input;
+        fixed::Q16 value;
+        gint64 now;
+        int settled;
+        gint64 time;
+    };
+
+    static void record(Run &run, int filtered);
+    static long nextUpdate(Run &run);
+    static void advance(Run &run, gint64 until);
+};
+
+void ReplayPrivate::record(Run &run, int filtered) {
+  Result &result = run.result;
+
+  /* the previous value was held against the previous input */
+  fixed::Q16 d = run.value - fixed::fromInt(run.settled);
+  result.error += fixed::toDouble(abs(d)) * (run.now - run.time);
+  run.settled = run.input;
+  run.time = run.now;
+
+  fixed::Q16 value = run.filter->getFixed();
+  if (run.deadBand)
+    value = run.deadBand->filter(value, run.now);
+  if (value != run.value) {
+    run.value = value;
+    result.changes++;
+  }
+
+  int shown = run.deadBand ? fixed::toInt(value) : filtered;
+  if (result.values.empty() || result.values.back().second != shown)
+    result.values.push_back({ run.now / MS, shown });
+  result.timeToTarget.update(run.input, shown, run.now);
+  result.duration = run.now;
+}
+
+long ReplayPrivate::nextUpdate(Run &run) {
+  long next = run.filter->nextUpdate();
+  if (run.deadBand) {
+    long held = run.deadBand->nextUpdate(run.now);
+    if (held >= 0 && (next < 0 || held < next))
+      next = held;
+  }
+  return next;
+}
+
+/* fire timers due before until */
+void ReplayPrivate::advance(Run &run, gint64 until) {
+  long next;
+  while ((next = nextUpdate(run)) >= 0) {
+    gint64 due = run.now + (next ? next : 1) * MS;
+    if (due >= until)
+      break;
+    run.now = due;
+    record(run, run.filter->update(run.now));
+  }
+}
+
+double Result::changesPerHour() const {
+  return duration > 0 ? changes * 3600e6 / duration : 0;
+}
+
+double Result::meanAbsoluteError() const {
+  return duration > 0 ? error / duration : 0;
+}
+
+vector<Sample> Replay::parse(const string &text) {
+  vector<Sample> samples;
+  istringstream in(text);
+  string line;
+  int n = 0;
+  while (getline(in, line)) {
+    n++;
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos || line[start] == '#')
+      continue;
+
+    istringstream fields(line);
+    Sample sample;
+    if (!(fields >> sample.time >> sample.lightLevel))
+      throw runtime_error("Invalid sample at line " + to_string(n));
+    if (!samples.empty() && sample.time < samples.back().time)
+      throw runtime_error("Sample out of order at line " + to_string(n));
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+vector<Sample> Replay::load(const string &path) {
+  GException error;
+  gchar *contents;
+  if (!g_file_get_contents(path.c_str(), &contents, NULL, error.get()))
+    throw error;
+
+  string text(contents);
+  g_free(contents);
+  return parse(text);
+}
+
+Result Replay::run(
+    IFilter *filter,
+    const vector<Sample> &samples,
+    DeadBand *deadBand) const {
+  Result result;
+  if (samples.empty())
+    return result;
+
+  gint64 origin = samples.front().time;
+  int input = ISensor::normalize(
+      samples.front().lightLevel,
+      unit,
+      curve);
+  filter->setValue(input);
+  if (deadBand)
+    deadBand->setValue(fixed::fromInt(input));
+
+  ReplayPrivate::Run run {
+      result, filter, deadBand, input, fixed::fromInt(input), 0, input, 0 };
+  ReplayPrivate::record(run, input);
+
+  for (size_t i = 1; i < samples.size(); i++) {
+    gint64 time = (samples[i].time - origin) * MS;
+    ReplayPrivate::advance(run, time);
+
+    run.now = time;
+    run.input = ISensor::normalize(
+        samples[i].lightLevel,
+        unit,
+        curve);
+    ReplayPrivate::record(run, filter->filter(run.input, run.now));
+  }
+
+  ReplayPrivate::advance(run, run.now + tail * MS);
+  return result;
+}
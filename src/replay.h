@@ -0,0 +1,64 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <glib.h>
+
+#include "sensor.h"
+#include "curve.h"
+#include "filter.h"
+
+/**
+ * Runs a recorded light level trace through a filter, and optionally
+ * a dead band, with timers fired as they would be in the service.
+ * Traces have one sample per line, milliseconds and light level,
+ * lines starting with # are comments.
+ */
+class Replay {
+  public:
+    struct Sample {
+        gint64 time;
+        double lightLevel;
+    };
+
+    struct Result {
+        /* filtered values in milliseconds from the first sample */
+        std::vector<std::pair<gint64, int>> values;
+        TimeToTarget timeToTarget;
+
+        /* changes of the fixed point value, as set on the adapter */
+        unsigned long long changes = 0;
+        gint64 duration = 0;
+
+        /* integral of the distance from the input, levels by microsecond */
+        double error = 0;
+
+        double changesPerHour() const;
+
+        /**
+         * Mean distance in levels of the value from the input, that is
+         * the level the value would settle to.
+         */
+        double meanAbsoluteError() const;
+    };
+
+    /**
+     * Time to keep firing filter timers after the last sample.
+     */
+    long tail = 60000;
+
+    ISensor::Unit unit = ISensor::LUX;
+    InputCurve curve;
+
+    static std::vector<Sample> parse(const std::string &text);
+    static std::vector<Sample> load(const std::string &path);
+
+    Result run(
+        IFilter *filter,
+        const std::vector<Sample> &samples,
+        DeadBand *deadBand = nullptr) const;
+};
+
+#endif /* REPLAY_H_ */
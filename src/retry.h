@@ -6,6 +6,7 @@
 
 #include "promise.h"
 #include "closure.h"
+#include "gexception.h"
 
 namespace _retry {
 
@@ -15,6 +16,30 @@ namespace _retry {
   using _promise::FnRet;
   using _promise::TPromise;
 
+  /**
+   * Exponential backoff with a ceiling and random jitter.
+   * Jitter is the fraction of the delay that may be randomly taken off,
+   * so that peers retrying together do not hit the service in lockstep.
+   */
+  struct Backoff {
+      long initial = 1000;
+      double factor = 2;
+      long ceiling = 60000;
+      double jitter = 0;
+
+      long delay(int attempt) const {
+        double d = initial;
+        for (int i = 0; i < attempt && d < ceiling; i++) {
+          d *= factor;
+        }
+        if (d > ceiling)
+          d = ceiling;
+        if (jitter > 0)
+          d -= d * jitter * g_random_double();
+        return d;
+      }
+  };
+
   template<typename Fn>
   struct Retry {
       using T = TPromise<FnRet<Fn>>;
@@ -70,7 +95,12 @@ namespace _retry {
       Retry<Fn> retry;
 
       void operator()(const exception_ptr &ex) {
-        if (retry) {
+        /* no point in waiting for errors that will not go away,
+         * nor in calling again what the caller cancelled */
+        GException::Kind kind = GException::kindOf(ex);
+        if (retry
+            && kind != GException::CANCELLED
+            && !GException::isPermanent(kind)) {
           retry.retry(result);
         } else {
           result.reject(ex);
@@ -106,6 +136,8 @@ namespace _retry {
 
 namespace retry {
 
+  using _retry::Backoff;
+
   template<typename Fn>
   promise::Promise<typename _retry::Retry<Fn>::T> retry(Fn &&fn,
       long backoff = 1000,
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "sensor-fusion.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+using Unit = ISensor::Unit;
+
+static const Logger logger("[SensorFusion]");
+
+struct SensorFusionPrivate {
+    using Source = SensorFusion::Source;
+
+    static bool isLive(const Source *source);
+    static void update(SensorFusion *self);
+};
+
+inline bool SensorFusionPrivate::isLive(const Source *source) {
+  return source->connected && !source->suspended
+      && !source->sensor->isStale();
+}
+
+void SensorFusionPrivate::update(SensorFusion *self) {
+  Unit unit = ISensor::UNKNOWN;
+  for (const auto &source : self->sources) {
+    Unit u = source->sensor->getUnit();
+    if (!isLive(source.get()) || u == ISensor::UNKNOWN)
+      continue;
+    if (u == ISensor::LUX || unit == ISensor::UNKNOWN)
+      unit = u;
+  }
+
+  if (unit == ISensor::UNKNOWN)
+    return;
+
+  vector<pair<double, double>> values;
+  for (const auto &source : self->sources) {
+    if (!isLive(source.get()) || source->sensor->getUnit() != unit)
+      continue;
+    values.emplace_back(source->sensor->getLightLevel(), source->weight);
+  }
+
+  if (values.empty())
+    return;
+
+  double value;
+  switch (self->policy) {
+    case SensorFusion::MAX:
+      value = max_element(values.begin(), values.end())->first;
+      break;
+    default:
+      value = SensorFusion::weightedMedian(move(values));
+      break;
+  }
+
+  if (self->unit == unit && self->lightLevel == value)
+    return;
+
+  self->unit = unit;
+  self->lightLevel = value;
+  self->lightLevelChanged();
+}
+
+SensorFusion::~SensorFusion() {
+  for (const auto &source : sources) {
+    source->sensor->lightLevelChanged.remove(source->handlerId);
+    source->sensor->staleChanged.remove(source->staleHandlerId);
+  }
+}
+
+void SensorFusion::add(ISensor *sensor, double weight) {
+  Source *source = new Source { unique_ptr<ISensor>(sensor), weight };
+  sources.emplace_back(source);
+  source->handlerId = sensor->lightLevelChanged << [=] {
+    SensorFusionPrivate::update(this);
+  };
+  source->staleHandlerId = sensor->staleChanged << [=] {
+    SensorFusionPrivate::update(this);
+  };
+}
+
+Promise<void> SensorFusion::connect() {
+  if (sources.empty())
+    return rejected<void>(logic_error("No sources"));
+
+  Result<void> result;
+  Promise<void> promise = result;
+  auto pending = make_shared<size_t>(sources.size());
+  auto connected = make_shared<bool>(false);
+
+  for (const auto &p : sources) {
+    Source *source = p.get();
+    auto done = [=] {
+      if (--*pending)
+        return;
+      if (*connected)
+        result.resolve();
+      else
+        result.reject(runtime_error("No source connected"));
+    };
+    source->sensor->connect().then([=] {
+      source->connected = true;
+      *connected = true;
+      SensorFusionPrivate::update(this);
+      done();
+    }, [=](exception_ptr ex) {
+      LOGGER_WARN(logger) << "Cannot connect source: " << ex << endl;
+      done();
+    });
+  }
+
+  return promise;
+}
+
+void SensorFusion::supervise(Supervisor *supervisor) {
+  for (const auto &source : sources) {
+    source->sensor->supervise(supervisor);
+  }
+}
+
+Promise<void> SensorFusion::suspend() {
+  for (const auto &source : sources) {
+    if (!source->connected)
+      continue;
+    source->suspended = true;
+    source->sensor->suspend().grab(PROMISE_LOG_EX);
+  }
+  return resolved();
+}
+
+Promise<void> SensorFusion::resume() {
+  for (const auto &source : sources) {
+    if (!source->connected)
+      continue;
+    source->suspended = false;
+    source->sensor->resume().grab(PROMISE_LOG_EX);
+  }
+  SensorFusionPrivate::update(this);
+  return resolved();
+}
+
+double SensorFusion::getLightLevel() const {
+  return lightLevel;
+}
+
+SensorFusion::Unit SensorFusion::getUnit() const {
+  return unit;
+}
+
+double SensorFusion::weightedMedian(vector<pair<double, double>> values) {
+  if (values.empty())
+    throw invalid_argument("No values");
+
+  sort(values.begin(), values.end());
+
+  double total = 0;
+  for (const auto &value : values) {
+    total += value.second;
+  }
+
+  double half = total / 2;
+  double sum = 0;
+  for (size_t i = 0; i < values.size(); i++) {
+    sum += values[i].second;
+    if (sum > half)
+      return values[i].first;
+    if (sum == half && i + 1 < values.size())
+      return (values[i].first + values[i + 1].first) / 2;
+  }
+  return values.back().first;
+}
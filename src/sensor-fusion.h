@@ -0,0 +1,76 @@
+#ifndef SENSOR_FUSION_H_
+#define SENSOR_FUSION_H_
+
+#include <memory>
+#include <vector>
+
+#include "sensor.h"
+
+/**
+ * Combines several light sensors into one estimate.
+ * Only connected sources that are neither suspended nor stale are
+ * combined, sources emit on change only so a steady value is as good as
+ * a new one.
+ * Lux sources are preferred over vendor ones.
+ */
+class SensorFusion: public ISensor {
+    friend class SensorFusionPrivate;
+
+  public:
+    enum Policy {
+      WEIGHTED_MEDIAN,
+      MAX
+    };
+
+  private:
+    struct Source {
+        std::unique_ptr<ISensor> sensor;
+        double weight;
+        void *handlerId = nullptr;
+        void *staleHandlerId = nullptr;
+        bool connected = false;
+        bool suspended = false;
+    };
+
+    std::vector<std::unique_ptr<Source>> sources;
+    double lightLevel = 0;
+    Unit unit = UNKNOWN;
+
+  public:
+    Policy policy = WEIGHTED_MEDIAN;
+
+    SensorFusion() = default;
+    SensorFusion(const SensorFusion&) = delete;
+    SensorFusion& operator=(const SensorFusion&) = delete;
+    ~SensorFusion();
+
+    /**
+     * Add a source, taking ownership.
+     */
+    void add(ISensor *sensor, double weight = 1);
+
+    /**
+     * Connect all sources, fails only if none can be connected.
+     */
+    promise::Promise<void> connect();
+
+    void supervise(Supervisor*);
+
+    /**
+     * Suspend or resume all connected sources, failures are only logged.
+     */
+    promise::Promise<void> suspend();
+    promise::Promise<void> resume();
+
+    double getLightLevel() const;
+    Unit getUnit() const;
+
+    /**
+     * Weighted median of values, halfway between the two middle values
+     * when the weights split evenly.
+     */
+    static double weightedMedian(
+        std::vector<std::pair<double, double>> values);
+};
+
+#endif /* SENSOR_FUSION_H_ */
@@ -8,6 +8,8 @@ using namespace gdbus;
 using namespace promise;
 using namespace signals;
 
+static const char *SERVICE = "net.hadess.SensorProxy";
+
 static const Method<void()> _claimLight {
     "ClaimLight"
 };
@@ -43,7 +45,7 @@ struct ResolveOnUnit {
 static Promise<PGDBusProxy> newProxy() {
   return newForBus(
       G_BUS_TYPE_SYSTEM,
-      "net.hadess.SensorProxy",
+      SERVICE,
       "/net/hadess/SensorProxy",
       "net.hadess.SensorProxy");
 }
@@ -151,10 +153,12 @@ Promise<void> SensorProxy::pingService() {
   };
 }
 
+/* pending calls keep the proxy alive, stop its signals reaching us */
 SensorProxy::~SensorProxy() {
-  if (proxy) {
+  if (proxy && !suspended) {
     SensorProxyPrivate::releaseLight(this).grab(PROMISE_LOG_EX);
   }
+  SensorProxyPrivate::setProxy(this, PGDBusProxy());
 }
 
 Promise<void> SensorProxy::connect() {
@@ -165,6 +169,43 @@ Promise<void> SensorProxy::connect() {
   };
 }
 
+Promise<void> SensorProxy::reconnect() {
+  if (suspended)
+    return resolved();
+
+  if (!proxy)
+    return connect();
+
+  return SensorProxyPrivate::claimLight(this) << [=] {
+    updateLightLevel(this, proxy.get());
+  };
+}
+
+Promise<void> SensorProxy::suspend() {
+  if (suspended)
+    return resolved();
+
+  suspended = true;
+  if (!proxy)
+    return resolved();
+  return SensorProxyPrivate::releaseLight(this);
+}
+
+/* light level may have changed while released */
+Promise<void> SensorProxy::resume() {
+  if (!suspended)
+    return resolved();
+
+  suspended = false;
+  return reconnect();
+}
+
+void SensorProxy::supervise(Supervisor *supervisor) {
+  supervisor->watch(G_BUS_TYPE_SYSTEM, SERVICE, [=] {
+    return reconnect();
+  });
+}
+
 double SensorProxy::getLightLevel() const {
   return lightLevel;
 }
@@ -173,6 +214,16 @@ SensorProxy::Unit SensorProxy::getUnit() const {
   return unit;
 }
 
-bool SensorProxy::hasUnit() const {
-  return unit != UNKNOWN;
+int ISensor::normalize(
+    double lightLevel,
+    Unit unit,
+    const InputCurve &curve) {
+  switch (unit) {
+    case Unit::VENDOR:
+      return lightLevel;
+    case Unit::LUX:
+      return curve.map(lightLevel);
+    default:
+      throw invalid_argument("Unknown unit");
+  }
 }
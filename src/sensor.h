@@ -1,24 +1,79 @@
 #ifndef SENSOR_H_
 #define SENSOR_H_
 
+#include "curve.h"
 #include "gdbus.h"
 #include "promise.h"
 #include "signals.h"
+#include "supervisor.h"
 
-class SensorProxy {
-    friend class SensorProxyPrivate;
-
-  public:
+struct ISensor {
     enum Unit {
       UNKNOWN,
       VENDOR,
       LUX
     };
 
-  private:
+    signals::Signal<void()> lightLevelChanged;
+
+    /**
+     * Emitted when reads start failing, and when they work again.
+     */
+    signals::Signal<void()> staleChanged;
+
+    virtual ~ISensor() = default;
+    virtual promise::Promise<void> connect() = 0;
+    virtual double getLightLevel() const = 0;
+    virtual Unit getUnit() const = 0;
+
+    bool hasUnit() const {
+      return getUnit() != UNKNOWN;
+    }
+
+    /**
+     * The last read failed, the light level is out of date.
+     */
+    virtual bool isStale() const {
+      return false;
+    }
+
+    /**
+     * Stop sampling until resumed, for sensors that can, for example
+     * releasing the light claimed from a service.
+     */
+    virtual promise::Promise<void> suspend() {
+      return promise::resolved();
+    }
+
+    virtual promise::Promise<void> resume() {
+      return promise::resolved();
+    }
+
+    /**
+     * Reconnect when the service restarts, if any.
+     * Supervisor must not outlive this.
+     */
+    virtual void supervise(Supervisor*) {
+    }
+
+    /**
+     * Light level from 0 to 100.
+     * Lux are normalized with the curve, by default on a log scale
+     * where 1000 lux and above are 100.
+     */
+    static int normalize(
+        double lightLevel,
+        Unit unit,
+        const InputCurve &curve = InputCurve::standard());
+};
+
+class SensorProxy: public ISensor {
+    friend class SensorProxyPrivate;
+
     gdbus::PGDBusProxy proxy;
     double lightLevel = 0;
     Unit unit = UNKNOWN;
+    bool suspended = false;
 
   public:
 
@@ -28,14 +83,26 @@ class SensorProxy {
      */
     static promise::Promise<void> pingService();
 
-    signals::Signal<void()> lightLevelChanged;
-
     ~SensorProxy();
 
     promise::Promise<void> connect();
+
+    /**
+     * Claim the light again, for example after a service restart,
+     * unless suspended.
+     */
+    promise::Promise<void> reconnect();
+
+    void supervise(Supervisor*);
+
+    /**
+     * Release the light, claimed again on resume.
+     */
+    promise::Promise<void> suspend();
+    promise::Promise<void> resume();
+
     double getLightLevel() const;
     Unit getUnit() const;
-    bool hasUnit() const;
 };
 
 #endif /* SENSOR_H_ */
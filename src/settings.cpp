@@ -1,44 +1,104 @@
+#include <stdexcept>
+
 #include "settings.h"
+#include "logger.h"
 
-struct SettingsPrivate {
-    static void getOffset(Settings *self);
-    static void setOffset(Settings *self);
-};
+using namespace std;
 
-void SettingsPrivate::getOffset(Settings *self) {
-  int offset = g_settings_get_int(self->gsettings.get(), "offset");
-  self->adapter->setOffset(offset);
-}
+static const Logger logger("[Settings]");
 
-void SettingsPrivate::setOffset(Settings *self) {
-  int offset = self->adapter->getOffset();
-  g_settings_set_int(self->gsettings.get(), "offset", offset);
-}
+struct SettingsPrivate {
+    static void onOffsetsChanged(Settings *self);
+    static void onSave(Settings *self);
+    static void getOffsets(Settings *self);
+    static void setOffsets(Settings *self);
+    static void scheduleSave(Settings *self);
+};
 
-static void onOffsetChanged(
+static void gOnOffsetsChanged(
     GSettings *settings,
     const gchar *key,
     gpointer user_data) {
   Settings *self = (Settings*) user_data;
-  SettingsPrivate::getOffset(self);
+  SettingsPrivate::onOffsetsChanged(self);
+}
+
+static gboolean gSave(gpointer user_data) {
+  Settings *self = (Settings*) user_data;
+  SettingsPrivate::onSave(self);
+  return FALSE;
 }
 
-Settings::Settings(Adapter *adapter, PGSettings gsettings) :
-    adapter(adapter), gsettings(gsettings) {
+void SettingsPrivate::onOffsetsChanged(Settings *self) {
+  /* a pending save is newer */
+  if (!self->saveId)
+    getOffsets(self);
+}
+
+void SettingsPrivate::onSave(Settings *self) {
+  self->saveId = 0;
+  setOffsets(self);
+}
+
+void SettingsPrivate::getOffsets(Settings *self) {
+  GSettings *s = self->gsettings.get();
+  GVariant *value = g_settings_get_value(s, self->tableKey.c_str());
+  gsize n;
+  const gint16 *data = (const gint16*) g_variant_get_fixed_array(
+      value, &n, sizeof(gint16));
+
+  OffsetTable offsets;
+  try {
+    offsets.unpack(vector<int16_t>(data, data + n));
+  } catch (const invalid_argument &e) {
+    /* not learnt yet, start from the global offset */
+    n && LOGGER_WARN(logger) << "Invalid offset table: " << e.what() << endl;
+    offsets.fill(g_settings_get_int(s, self->offsetKey.c_str()));
+  }
+  g_variant_unref(value);
+
+  self->adapter->setOffsets(offsets);
+}
+
+void SettingsPrivate::setOffsets(Settings *self) {
+  vector<int16_t> packed = self->adapter->getOffsets().pack();
+  g_settings_set_value(
+      self->gsettings.get(),
+      self->tableKey.c_str(),
+      g_variant_new_fixed_array(
+          G_VARIANT_TYPE_INT16,
+          packed.data(),
+          packed.size(),
+          sizeof(gint16)));
+}
+
+void SettingsPrivate::scheduleSave(Settings *self) {
+  if (!self->saveId)
+    self->saveId = g_timeout_add(self->saveDelay, gSave, self);
+}
+
+Settings::Settings(
+    Adapter *adapter,
+    PGSettings gsettings,
+    const string &prefix) :
+    adapter(adapter),
+    gsettings(gsettings),
+    offsetKey(prefix + "offset"),
+    tableKey(prefix + "offset-table") {
 
   if (!gsettings)
     return;
 
   g_signal_connect(
       gsettings.get(),
-      "changed::offset",
-      G_CALLBACK(onOffsetChanged),
+      ("changed::" + tableKey).c_str(),
+      G_CALLBACK(gOnOffsetsChanged),
       this);
 
-  SettingsPrivate::getOffset(this);
+  SettingsPrivate::getOffsets(this);
 
-  ochid = adapter->offsetChanged << [=] {
-    SettingsPrivate::setOffset(this);
+  ochid = adapter->offsetsChanged << [=] {
+    SettingsPrivate::scheduleSave(this);
   };
 }
 
@@ -46,7 +106,12 @@ Settings::~Settings() {
   if (!gsettings)
     return;
 
-  adapter->offsetChanged.remove(ochid);
+  adapter->offsetsChanged.remove(ochid);
 
   g_signal_handlers_disconnect_by_data(gsettings.get(), this);
+
+  if (saveId) {
+    g_source_remove(saveId);
+    SettingsPrivate::setOffsets(this);
+  }
 }
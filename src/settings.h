@@ -1,9 +1,18 @@
 #ifndef SETTINGS_H_
 #define SETTINGS_H_
 
+#include <string>
+
 #include "adapter.h"
 #include "gsettings.h"
 
+/**
+ * Keeps the offset table of the adapter in settings.
+ * Learnt offsets are stored after a delay, so that several manual
+ * changes end up in a single write.
+ * Keys are offset and offset-table, after a prefix for outputs other
+ * than the screen.
+ */
 class Settings {
     friend class SettingsPrivate;
 
@@ -11,10 +20,21 @@ class Settings {
 
     Adapter *adapter;
     PGSettings gsettings;
+    std::string offsetKey;
+    std::string tableKey;
     void *ochid;
+    guint saveId = 0;
 
   public:
-    Settings(Adapter *adapter, PGSettings gsettings);
+    /**
+     * Milliseconds from a learnt offset to the write of the table.
+     */
+    long saveDelay = 10000;
+
+    Settings(
+        Adapter *adapter,
+        PGSettings gsettings,
+        const std::string &prefix = "");
     ~Settings();
 };
 
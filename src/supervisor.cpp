@@ -0,0 +1,256 @@
+#include "supervisor.h"
+#include "gexception.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+
+static const Logger logger("[Supervisor]");
+
+struct Supervisor::Entry {
+    Supervisor *self;
+    string name;
+    guint watchId = 0;
+    Reconnect reconnect;
+    string owner;
+    bool lost = false;
+    bool active = true;
+    bool running = false;
+    bool again = false;
+    int attempt = 0;
+    gint64 lostAt = 0;
+    gint64 due = 0;
+};
+
+struct SupervisorPrivate {
+    using Entry = Supervisor::Entry;
+    using PEntry = Supervisor::PEntry;
+
+    static void onAppeared(Entry *entry, const char *owner);
+    static void onVanished(Entry *entry);
+    static void schedule(Entry *entry, long delay);
+    static void arm(Supervisor *self);
+    static void onTimeout(Supervisor *self);
+    static void run(const PEntry &entry);
+    static void onSuccess(Entry *entry);
+    static void onFailure(Entry *entry, const exception_ptr &ex);
+};
+
+static void gOnAppeared(
+    GDBusConnection *connection,
+    const gchar *name,
+    const gchar *name_owner,
+    gpointer user_data) {
+  SupervisorPrivate::PEntry *entry = (SupervisorPrivate::PEntry*) user_data;
+  if ((*entry)->active)
+    SupervisorPrivate::onAppeared(entry->get(), name_owner);
+}
+
+static void gOnVanished(
+    GDBusConnection *connection,
+    const gchar *name,
+    gpointer user_data) {
+  SupervisorPrivate::PEntry *entry = (SupervisorPrivate::PEntry*) user_data;
+  if ((*entry)->active)
+    SupervisorPrivate::onVanished(entry->get());
+}
+
+static void gFreeEntry(gpointer user_data) {
+  delete (SupervisorPrivate::PEntry*) user_data;
+}
+
+static gboolean gOnTimeout(gpointer user_data) {
+  Supervisor *self = (Supervisor*) user_data;
+  SupervisorPrivate::onTimeout(self);
+  return FALSE;
+}
+
+void SupervisorPrivate::onAppeared(Entry *entry, const char *owner) {
+  bool changed = !entry->owner.empty() && entry->owner != owner;
+
+  LOGGER_DEBUG(logger) << "[" << entry->name << "] owner: " << owner << endl;
+
+  if (changed && !entry->lost) {
+    entry->lostAt = g_get_monotonic_time();
+  }
+
+  entry->owner = owner;
+
+  if (entry->lost || changed) {
+    entry->lost = false;
+    entry->attempt = 0;
+    schedule(entry, 0);
+  }
+}
+
+void SupervisorPrivate::onVanished(Entry *entry) {
+  LOGGER_DEBUG(logger) << "[" << entry->name << "] vanished" << endl;
+
+  /* on first watch the service could be not yet started */
+  if (!entry->lost) {
+    entry->lost = true;
+    entry->lostAt = g_get_monotonic_time();
+  }
+
+  entry->owner.clear();
+  entry->due = 0;
+}
+
+void SupervisorPrivate::schedule(Entry *entry, long delay) {
+  entry->due = g_get_monotonic_time() + delay * 1000;
+  arm(entry->self);
+}
+
+void SupervisorPrivate::arm(Supervisor *self) {
+  gint64 due = 0;
+  for (const PEntry &entry : self->entries) {
+    if (entry->due && (!due || entry->due < due))
+      due = entry->due;
+  }
+
+  if (self->timerId && self->timerDue == due)
+    return;
+
+  if (self->timerId) {
+    g_source_remove(self->timerId);
+    self->timerId = 0;
+  }
+
+  if (!due)
+    return;
+
+  gint64 delay = due - g_get_monotonic_time();
+  self->timerDue = due;
+  self->timerId = g_timeout_add(
+      delay > 0 ? (delay + 999) / 1000 : 0,
+      gOnTimeout,
+      self);
+}
+
+void SupervisorPrivate::onTimeout(Supervisor *self) {
+  self->timerId = 0;
+
+  gint64 now = g_get_monotonic_time();
+  list<PEntry> ready;
+  for (const PEntry &entry : self->entries) {
+    if (entry->due && entry->due <= now) {
+      entry->due = 0;
+      ready.push_back(entry);
+    }
+  }
+
+  for (const PEntry &entry : ready) {
+    run(entry);
+  }
+
+  arm(self);
+}
+
+void SupervisorPrivate::run(const PEntry &entry) {
+  if (entry->owner.empty())
+    return;
+
+  /* owner changed while reconnecting, run again when done */
+  if (entry->running) {
+    entry->again = true;
+    return;
+  }
+
+  LOGGER(logger) << "[" << entry->name << "] reconnecting, attempt: "
+      << entry->attempt << endl;
+
+  entry->running = true;
+  PEntry ref = entry;
+  entry->reconnect().then(
+      [ref] {
+        ref->running = false;
+        if (ref->active)
+          onSuccess(ref.get());
+      },
+      [ref](exception_ptr ex) {
+        ref->running = false;
+        if (ref->active)
+          onFailure(ref.get(), ex);
+      });
+}
+
+void SupervisorPrivate::onSuccess(Entry *entry) {
+  if (entry->again) {
+    entry->again = false;
+    schedule(entry, 0);
+    return;
+  }
+
+  gint64 elapsed = g_get_monotonic_time() - entry->lostAt;
+  LOGGER(logger) << "[" << entry->name << "] reconnected in "
+      << elapsed / 1000 << "ms" << endl;
+  entry->attempt = 0;
+}
+
+void SupervisorPrivate::onFailure(Entry *entry, const exception_ptr &ex) {
+  if (entry->again) {
+    entry->again = false;
+    entry->attempt = 0;
+    schedule(entry, 0);
+    return;
+  }
+
+  GException::Kind kind = GException::kindOf(ex);
+  if (GException::isPermanent(kind)) {
+    LOGGER_ERROR(logger) << "[" << entry->name << "] cannot reconnect: "
+        << ex << endl;
+    return;
+  }
+
+  entry->attempt++;
+  long delay = entry->self->backoff.delay(entry->attempt - 1);
+  LOGGER_WARN(logger) << "[" << entry->name << "] reconnect failed: " << ex
+      << ", retry in: " << delay << "ms" << endl;
+
+  /* if the service is gone, wait for it to come back */
+  if (!entry->owner.empty())
+    schedule(entry, delay);
+}
+
+Supervisor::~Supervisor() {
+  for (const PEntry &entry : entries) {
+    entry->active = false;
+    g_bus_unwatch_name(entry->watchId);
+  }
+  if (timerId)
+    g_source_remove(timerId);
+}
+
+void* Supervisor::watch(
+    GBusType busType,
+    const char *name,
+    Reconnect reconnect) {
+  PEntry entry(new Entry);
+  entry->self = this;
+  entry->name = name;
+  entry->reconnect = move(reconnect);
+  entries.push_back(entry);
+
+  entry->watchId = g_bus_watch_name(
+      busType,
+      name,
+      G_BUS_NAME_WATCHER_FLAGS_NONE,
+      gOnAppeared,
+      gOnVanished,
+      new PEntry(entry),
+      gFreeEntry);
+
+  return entry.get();
+}
+
+void Supervisor::unwatch(void *id) {
+  for (auto itr = entries.begin(); itr != entries.end(); ++itr) {
+    if (itr->get() == id) {
+      (*itr)->active = false;
+      g_bus_unwatch_name((*itr)->watchId);
+      entries.erase(itr);
+      break;
+    }
+  }
+  SupervisorPrivate::arm(this);
+}
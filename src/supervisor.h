@@ -0,0 +1,46 @@
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <functional>
+#include <gio/gio.h>
+
+#include "promise.h"
+#include "retry.h"
+
+/**
+ * Watches the name owner of D-Bus services and reconnects to them
+ * when they come back, for example after a service restart.
+ * Failed reconnections are retried with backoff, all scheduled
+ * reconnections share a single timer.
+ */
+class Supervisor {
+    friend class SupervisorPrivate;
+
+    struct Entry;
+    using PEntry = std::shared_ptr<Entry>;
+    using Reconnect = std::function<promise::Promise<void>()>;
+
+    std::list<PEntry> entries;
+    guint timerId = 0;
+    gint64 timerDue = 0;
+
+  public:
+    retry::Backoff backoff { 50, 2, 30000, 0.5 };
+
+    Supervisor() = default;
+    Supervisor(const Supervisor&) = delete;
+    Supervisor& operator=(const Supervisor&) = delete;
+    ~Supervisor();
+
+    /**
+     * Call reconnect each time the name gets a new owner.
+     * The first owner seen is assumed to be already connected.
+     */
+    void* watch(GBusType busType, const char *name, Reconnect reconnect);
+    void unwatch(void *id);
+};
+
+#endif /* SUPERVISOR_H_ */
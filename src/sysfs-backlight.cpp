@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "sysfs-backlight.h"
+#include "sysfs.h"
+#include "gexception.h"
+#include "logger.h"
+
+using namespace std;
+using namespace promise;
+using namespace sysfs;
+using namespace fixed;
+
+using Device = SysfsBacklight::Device;
+
+static const Logger logger("[SysfsBacklight]");
+
+const char *SysfsBacklight::DEFAULT_ROOT = "/sys/class/backlight";
+const char *SysfsBacklight::LEDS_ROOT = "/sys/class/leds";
+const char *SysfsBacklight::KEYBOARD_PATTERN = "*kbd_backlight";
+
+struct SysfsBacklightPrivate {
+    static void enumerate(SysfsBacklight *self);
+    static void watch(SysfsBacklight *self);
+    static void unwatch(SysfsBacklight *self);
+    static void onNotify(SysfsBacklight *self);
+    static void poll(SysfsBacklight *self);
+    static void setBrightness(SysfsBacklight *self, Q16 value);
+};
+
+static int typeOrder(const string &type) {
+  if (type == "firmware")
+    return 0;
+  if (type == "platform")
+    return 1;
+  if (type == "raw")
+    return 2;
+  return 3;
+}
+
+inline static Q16 toPercent(const Device &device, int raw) {
+  return scale(raw, fromInt(100), device.max);
+}
+
+inline static int toRaw(const Device &device, Q16 percent) {
+  return scale(percent, device.max, fromInt(100));
+}
+
+static gboolean gOnNotify(
+    gint fd,
+    GIOCondition condition,
+    gpointer user_data) {
+  SysfsBacklight *self = (SysfsBacklight*) user_data;
+  SysfsBacklightPrivate::onNotify(self);
+  return G_SOURCE_CONTINUE;
+}
+
+/* the attribute must be read again to be notified of the next change */
+static void drain(int fd) {
+  char buffer[32];
+  lseek(fd, 0, SEEK_SET);
+  while (read(fd, buffer, sizeof(buffer)) > 0)
+    ;
+}
+
+void SysfsBacklightPrivate::enumerate(SysfsBacklight *self) {
+  GException error;
+  GDir *dir = g_dir_open(self->root.c_str(), 0, error.get());
+  if (!dir)
+    throw error;
+
+  const char *name;
+  while ((name = g_dir_read_name(dir))) {
+    if (!g_pattern_match_simple(self->pattern.c_str(), name))
+      continue;
+
+    Device device;
+    device.name = name;
+    device.path = self->root + "/" + name;
+    try {
+      device.max = readInt(device.path + "/max_brightness");
+    } catch (const exception &e) {
+      LOGGER_WARN(logger) << "Skipping " << name << ": " << e.what() << endl;
+      continue;
+    }
+    if (device.max <= 0)
+      continue;
+    try {
+      device.type = typeOrder(readString(device.path + "/type"));
+    } catch (const exception &e) {
+      device.type = typeOrder("");
+    }
+    self->devices.push_back(device);
+  }
+  g_dir_close(dir);
+
+  sort(self->devices.begin(), self->devices.end(),
+      [](const Device &a, const Device &b) {
+        return a.type != b.type ? a.type < b.type : a.name < b.name;
+      });
+
+  for (const Device &device : self->devices) {
+    LOGGER(logger) << "Found device: " << device.name
+        << ", max: " << device.max << endl;
+  }
+}
+
+void SysfsBacklightPrivate::watch(SysfsBacklight *self) {
+  const Device &device = self->devices.front();
+  for (const char *name : { "actual_brightness", "brightness_hw_changed" }) {
+    string path = device.path + "/" + name;
+    if (!exists(path))
+      continue;
+
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    drain(fd);
+    self->notifyFd = fd;
+    self->notifyId = g_unix_fd_add(
+        fd,
+        (GIOCondition) (G_IO_PRI | G_IO_ERR),
+        gOnNotify,
+        self);
+    LOGGER(logger) << "Watching " << path << endl;
+    return;
+  }
+
+  LOGGER_WARN(logger) << "Changes to " << device.name
+      << " are not notified" << endl;
+}
+
+void SysfsBacklightPrivate::unwatch(SysfsBacklight *self) {
+  if (self->notifyId) {
+    g_source_remove(self->notifyId);
+    self->notifyId = 0;
+  }
+  if (self->notifyFd >= 0) {
+    close(self->notifyFd);
+    self->notifyFd = -1;
+  }
+}
+
+void SysfsBacklightPrivate::onNotify(SysfsBacklight *self) {
+  drain(self->notifyFd);
+  try {
+    poll(self);
+  } catch (const exception &e) {
+    LOGGER_ERROR(logger) << "Cannot read brightness: " << e.what() << endl;
+  }
+}
+
+void SysfsBacklightPrivate::poll(SysfsBacklight *self) {
+  Device &device = self->devices.front();
+  int raw;
+  try {
+    raw = readInt(device.path + "/actual_brightness");
+  } catch (const exception &e) {
+    raw = readInt(device.path + "/brightness");
+  }
+
+  if (device.raw == raw)
+    return;
+
+  device.raw = raw;
+  setBrightness(self, toPercent(device, raw));
+}
+
+void SysfsBacklightPrivate::setBrightness(SysfsBacklight *self, Q16 value) {
+  if (self->brightness == value)
+    return;
+
+  self->brightness = value;
+  self->brightnessChanged();
+}
+
+SysfsBacklight::SysfsBacklight(
+    const string &root,
+    const string &pattern) :
+    root(root), pattern(pattern) {
+}
+
+SysfsBacklight::~SysfsBacklight() {
+  SysfsBacklightPrivate::unwatch(this);
+}
+
+Promise<void> SysfsBacklight::connect() {
+  if (!devices.empty())
+    return resolved();
+
+  try {
+    SysfsBacklightPrivate::enumerate(this);
+    if (devices.empty())
+      throw runtime_error("No backlight devices in " + root);
+    SysfsBacklightPrivate::poll(this);
+  } catch (...) {
+    devices.clear();
+    return rejected<void>(current_exception());
+  }
+
+  SysfsBacklightPrivate::watch(this);
+  return resolved();
+}
+
+Promise<void> SysfsBacklight::setBrightness(int value) {
+  return setBrightnessFixed(fromInt(value));
+}
+
+Promise<void> SysfsBacklight::setBrightnessFixed(Q16 value) {
+  if (devices.empty())
+    return rejected<void>(logic_error("Not connected"));
+
+  value = clamp(value, 0, fromInt(100));
+
+  Promise<void> promise = resolved();
+  for (size_t i = 0; i < devices.size(); i++) {
+    int raw = toRaw(devices[i], value);
+    if (devices[i].raw == raw)
+      continue;
+
+    promise = promise << [=] {
+      return writeRaw(devices[i], raw);
+    } << [=] {
+      devices[i].raw = raw;
+    };
+  }
+
+  return promise << [=] {
+    SysfsBacklightPrivate::setBrightness(this, value);
+  };
+}
+
+int SysfsBacklight::getBrightness() const {
+  return toInt(brightness);
+}
+
+Q16 SysfsBacklight::getBrightnessFixed() const {
+  return brightness;
+}
+
+Q16 SysfsBacklight::getResolution() const {
+  if (devices.empty())
+    return ONE;
+  return (fromInt(100) + devices.front().max - 1) / devices.front().max;
+}
+
+void SysfsBacklight::refresh() {
+  if (devices.empty())
+    return;
+
+  try {
+    SysfsBacklightPrivate::poll(this);
+  } catch (const exception &e) {
+    LOGGER_ERROR(logger) << "Cannot read brightness: " << e.what() << endl;
+  }
+}
+
+const vector<Device>& SysfsBacklight::getDevices() const {
+  return devices;
+}
+
+Promise<void> SysfsBacklight::writeRaw(const Device &device, int raw) {
+  try {
+    writeInt(device.path + "/brightness", raw);
+    return resolved();
+  } catch (...) {
+    return rejected<void>(current_exception());
+  }
+}
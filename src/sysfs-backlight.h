@@ -0,0 +1,75 @@
+#ifndef SYSFS_BACKLIGHT_H_
+#define SYSFS_BACKLIGHT_H_
+
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "brightness.h"
+
+/**
+ * Brightness of backlight devices under a sysfs class directory,
+ * by default /sys/class/backlight, or of the leds matching a pattern,
+ * for example keyboard backlights under /sys/class/leds.
+ * All devices are set to the same percentage using their own raw
+ * resolution, fixed point brightness is quantized only here.
+ * Brightness is read from the preferred device
+ * (firmware, then platform, then raw, as gnome-settings-daemon does).
+ * Changes made by others are seen when the kernel notifies them
+ * on actual_brightness or brightness_hw_changed, there is no polling.
+ */
+class SysfsBacklight: public IBrightnessProxy {
+    friend class SysfsBacklightPrivate;
+
+  public:
+    static const char *DEFAULT_ROOT;
+    static const char *LEDS_ROOT;
+    static const char *KEYBOARD_PATTERN;
+
+    struct Device {
+        std::string name;
+        std::string path;
+        int type = 0;
+        int max = 0;
+        int raw = -1;
+    };
+
+  private:
+    std::string root;
+    std::string pattern;
+    std::vector<Device> devices;
+    fixed::Q16 brightness = fixed::fromInt(-1);
+    int notifyFd = -1;
+    guint notifyId = 0;
+
+  public:
+    /**
+     * Only devices with a name matching the glob pattern are used.
+     */
+    SysfsBacklight(
+        const std::string &root = DEFAULT_ROOT,
+        const std::string &pattern = "*");
+    ~SysfsBacklight();
+
+    promise::Promise<void> connect();
+    promise::Promise<void> setBrightness(int);
+    int getBrightness() const;
+    promise::Promise<void> setBrightnessFixed(fixed::Q16);
+    fixed::Q16 getBrightnessFixed() const;
+    fixed::Q16 getResolution() const;
+
+    /**
+     * Read the brightness again, for changes that are not notified.
+     */
+    void refresh();
+
+    const std::vector<Device>& getDevices() const;
+
+  protected:
+    /**
+     * Write the raw value to the device.
+     */
+    virtual promise::Promise<void> writeRaw(const Device &device, int raw);
+};
+
+#endif /* SYSFS_BACKLIGHT_H_ */
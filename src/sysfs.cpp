@@ -0,0 +1,52 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "sysfs.h"
+#include "gexception.h"
+
+using namespace std;
+
+namespace sysfs {
+
+  string readString(const string &path) {
+    GException error;
+    gchar *contents = NULL;
+    if (!g_file_get_contents(path.c_str(), &contents, NULL, error.get()))
+      throw error;
+    string value(g_strstrip(contents));
+    g_free(contents);
+    return value;
+  }
+
+  int readInt(const string &path) {
+    return stoi(readString(path));
+  }
+
+  double readDouble(const string &path) {
+    return g_ascii_strtod(readString(path).c_str(), NULL);
+  }
+
+  void writeInt(const string &path, int value) {
+    string s = to_string(value);
+    int fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+    int ret = fd < 0 ? -1 : write(fd, s.c_str(), s.size());
+    int err = errno;
+    if (fd >= 0)
+      close(fd);
+    if (ret < 0) {
+      throw GException(g_error_new(
+          G_IO_ERROR,
+          g_io_error_from_errno(err),
+          "%s: %s",
+          path.c_str(),
+          g_strerror(err)));
+    }
+  }
+
+  bool exists(const string &path) {
+    return g_file_test(path.c_str(), G_FILE_TEST_EXISTS);
+  }
+
+}
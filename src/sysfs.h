@@ -0,0 +1,23 @@
+#ifndef SYSFS_H_
+#define SYSFS_H_
+
+#include <string>
+
+/**
+ * Helpers for sysfs attributes, errors are thrown as GException.
+ */
+namespace sysfs {
+
+  std::string readString(const std::string &path);
+
+  int readInt(const std::string &path);
+
+  double readDouble(const std::string &path);
+
+  void writeInt(const std::string &path, int value);
+
+  bool exists(const std::string &path);
+
+}
+
+#endif /* SYSFS_H_ */
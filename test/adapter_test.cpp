@@ -0,0 +1,198 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include <glib.h>
+
+#include <src/adapter.h>
+
+using namespace std;
+using namespace promise;
+
+/* brightness set is reported back later, one change per write */
+struct TestProxy: IBrightnessProxy {
+    int brightness = 50;
+    vector<int> queue;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    Promise<void> setBrightness(int value) {
+      queue.push_back(value);
+      return resolved();
+    }
+
+    int getBrightness() const {
+      return brightness;
+    }
+
+    void set(int value) {
+      brightness = value;
+      brightnessChanged();
+    }
+
+    void flush() {
+      vector<int> values;
+      values.swap(queue);
+      for (int value : values)
+        set(value);
+    }
+};
+
+/* keyboard with 4 levels, the percentage set is truncated to a level */
+struct KeyboardProxy: TestProxy {
+    static const int MAX = 3;
+
+    Promise<void> setBrightness(int value) {
+      return TestProxy::setBrightness(value * MAX / 100 * 100 / MAX);
+    }
+
+    fixed::Q16 getResolution() const {
+      return (fixed::fromInt(100) + MAX - 1) / MAX;
+    }
+};
+
+static void runFor(long millis) {
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add(millis, [](gpointer user_data) {
+    g_main_loop_quit((GMainLoop*) user_data);
+    return G_SOURCE_REMOVE;
+  }, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+/* echo of an older write does not move the offset */
+static void test_race() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  proxy.set(50);
+  assert(adapter.getValue() == 50);
+
+  adapter.setValue(60);
+  adapter.setValue(70);
+  proxy.flush();
+  assert(adapter.getOffset() == 0);
+  assert(adapter.getStats().echoes == 2);
+  assert(adapter.getStats().adjustments == 0);
+}
+
+static void test_user() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  proxy.set(50);
+
+  adapter.setValue(60);
+  proxy.flush();
+  proxy.set(80);
+  assert(adapter.getOffset() == 20);
+  assert(adapter.getStats().echoes == 1);
+  assert(adapter.getStats().adjustments == 1);
+
+  /* same as the old echo, consumed already */
+  proxy.set(60);
+  assert(adapter.getOffset() == 0);
+  assert(adapter.getStats().adjustments == 2);
+}
+
+/* the backend reports the last of several writes only */
+static void test_coalesced() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  proxy.set(50);
+
+  adapter.setValue(60);
+  adapter.setValue(70);
+  proxy.queue.erase(proxy.queue.begin());
+  proxy.flush();
+  assert(adapter.getStats().echoes == 1);
+
+  /* back to the older write, which is no echo any more */
+  proxy.set(60);
+  assert(adapter.getOffset() == -10);
+  assert(adapter.getStats().adjustments == 1);
+}
+
+/* echoes absorbed before, as behind Ramp */
+static void test_untracked() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  adapter.echoWindow = 0;
+  proxy.set(50);
+
+  adapter.setValue(60);
+  proxy.flush();
+  assert(adapter.getStats().echoes == 0);
+  assert(adapter.getStats().adjustments == 0);
+
+  /* user returns to a value just written */
+  proxy.set(80);
+  proxy.set(60);
+  assert(adapter.getOffset() == 0);
+  assert(adapter.getStats().adjustments == 2);
+}
+
+static void test_expired() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  adapter.echoWindow = 50;
+  proxy.set(50);
+
+  adapter.setValue(60);
+  adapter.setValue(70);
+  runFor(100);
+  proxy.flush();
+  assert(adapter.getStats().echoes == 0);
+  assert(adapter.getStats().adjustments == 2);
+}
+
+/* correction stays with the ambient level it was made at */
+static void test_levels() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  proxy.set(50);
+
+  adapter.setValue(80);
+  proxy.flush();
+  proxy.set(90);
+  assert(adapter.getOffset() == 10);
+
+  adapter.setValue(10);
+  assert(adapter.getOffset() == 0);
+  assert(proxy.queue.back() == 10);
+
+  adapter.setValue(80);
+  assert(adapter.getOffset() == 10);
+  assert(proxy.queue.back() == 90);
+}
+
+static void test_keyboard() {
+  KeyboardProxy proxy;
+  Adapter adapter(&proxy);
+  proxy.set(33);
+
+  adapter.setValue(50);
+  adapter.setValue(60);
+  adapter.setValue(70);
+  assert(proxy.queue == vector<int>({ 33, 33, 66 }));
+  proxy.flush();
+  assert(adapter.getOffset() == 0);
+  assert(adapter.getStats().echoes == 3);
+  assert(adapter.getStats().adjustments == 0);
+
+  /* a level up is no echo */
+  proxy.set(100);
+  assert(adapter.getOffset() == 30);
+  assert(adapter.getStats().adjustments == 1);
+}
+
+int main() {
+  test_race();
+  test_user();
+  test_coalesced();
+  test_untracked();
+  test_expired();
+  test_levels();
+  test_keyboard();
+  cout << "OK" << endl;
+}
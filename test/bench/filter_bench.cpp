@@ -0,0 +1,50 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <glib.h>
+
+#include <src/filter.h>
+
+using namespace std;
+
+static const int SAMPLES = 1000000;
+
+struct Case {
+    const char *name;
+    IFilter* (*create)();
+};
+
+static const Case CASES[] = {
+  { "pressure", [] () -> IFilter* { return new PressureFilter(); } },
+  { "ema", [] () -> IFilter* { return new EmaFilter(); } },
+  { "median", [] () -> IFilter* { return new MedianFilter(15); } },
+  { "kalman", [] () -> IFilter* { return new KalmanFilter(); } },
+  { "hysteresis", [] () -> IFilter* { return new HysteresisFilter(); } },
+};
+
+/* noisy steps, 10 samples per second */
+static void run(const Case &c) {
+  unique_ptr<IFilter> filter(c.create());
+  filter->setValue(50);
+
+  guint32 seed = 1;
+  int sum = 0;
+  gint64 start = g_get_monotonic_time();
+  for (int i = 0; i < SAMPLES; i++) {
+    seed = seed * 1664525 + 1013904223;
+    int level = (i / 1000) % 2 ? 70 : 30;
+    int v = level + (int) (seed >> 28) - 8;
+    sum += filter->filter(v, i * 100000LL);
+  }
+  gint64 elapsed = g_get_monotonic_time() - start;
+
+  cout << c.name << ": " << elapsed * 1000.0 / SAMPLES << " ns/sample"
+      << " (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char **argv) {
+  for (const Case &c : CASES) {
+    if (argc < 2 || !strcmp(argv[1], c.name))
+      run(c);
+  }
+}
@@ -0,0 +1,213 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include <gio/gio.h>
+
+#include <src/adapter.h>
+#include <src/brightness.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *POWER_PATH = "/org/gnome/SettingsDaemon/Power";
+
+static const char *POWER_XML =
+    "<node>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Screen'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Keyboard'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "    <property name='Steps' type='i' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+static const int N = 2;
+
+static const MockObject OBJECTS[N] = {
+    { POWER_PATH, "org.gnome.SettingsDaemon.Power" },
+    { POWER_PATH, NULL }
+};
+
+static const char *SCREEN = "org.gnome.SettingsDaemon.Power.Screen";
+
+static const char *KEYBOARD = "org.gnome.SettingsDaemon.Power.Keyboard";
+
+/* applies each Set after a delay, values of 99 are refused,
+ * keyboard values are truncated to one of its steps */
+struct Power: MockDBus {
+    int brightness = 50;
+    int keyboard = 0;
+    int steps = 4;
+    vector<int> calls;
+};
+
+struct Call {
+    Power *power;
+    GDBusMethodInvocation *invocation;
+    const char *interface;
+    int value;
+};
+
+static gboolean apply(gpointer user_data) {
+  Call *call = (Call*) user_data;
+  Power *power = call->power;
+
+  if (call->value == 99) {
+    g_dbus_method_invocation_return_error(
+        call->invocation,
+        G_DBUS_ERROR,
+        G_DBUS_ERROR_INVALID_ARGS,
+        "Refused");
+    delete call;
+    return G_SOURCE_REMOVE;
+  }
+
+  int *brightness = &power->brightness;
+  int value = call->value;
+  if (g_str_equal(call->interface, KEYBOARD)) {
+    int max = power->steps - 1;
+    brightness = &power->keyboard;
+    value = value * max / 100 * 100 / max;
+  }
+
+  *brightness = value;
+  emitPropertyChanged(
+      power,
+      POWER_PATH,
+      call->interface,
+      "Brightness",
+      g_variant_new_int32(value));
+  g_dbus_method_invocation_return_value(call->invocation, NULL);
+  delete call;
+  return G_SOURCE_REMOVE;
+}
+
+/* Set calls come here since there is no set_property */
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Power *power = (Power*) user_data;
+  const char *interface;
+  GVariant *value;
+  g_variant_get(parameters, "(&s&sv)", &interface, NULL, &value);
+
+  Call *call = new Call {
+      power,
+      invocation,
+      g_str_equal(interface, KEYBOARD) ? KEYBOARD : SCREEN,
+      g_variant_get_int32(value)
+  };
+  g_variant_unref(value);
+  power->calls.push_back(call->value);
+  g_timeout_add(50, apply, call);
+}
+
+static GVariant* onGetProperty(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *property_name,
+    GError **error,
+    gpointer user_data) {
+  Power *power = (Power*) user_data;
+  if (!g_str_equal(interface_name, KEYBOARD))
+    return g_variant_new_int32(power->brightness);
+  if (g_str_equal(property_name, "Steps"))
+    return g_variant_new_int32(power->steps);
+  return g_variant_new_int32(power->keyboard);
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall, onGetProperty };
+
+/* only the latest value is sent after the one in flight */
+static void test_coalesce(Power *power, BrightnessProxy &proxy) {
+  int resolved = 0;
+  auto count = [&] {
+    resolved++;
+  };
+  proxy.setBrightness(10) << count;
+  proxy.setBrightness(20) << count;
+  proxy.setBrightness(30) << count;
+  await(proxy.setBrightness(40));
+  assert(resolved == 3);
+  assert(power->calls == vector<int>({ 10, 40 }));
+  assert(proxy.getBrightness() == 40);
+
+  /* value in flight asked again */
+  power->calls.clear();
+  proxy.setBrightness(60);
+  proxy.setBrightness(70);
+  await(proxy.setBrightness(60));
+  assert(power->calls == vector<int>({ 60 }));
+}
+
+/* a failed value is superseded by a newer one */
+static void test_failure(Power *power, BrightnessProxy &proxy) {
+  power->calls.clear();
+  bool rejected = false;
+  proxy.setBrightness(99).then([] {
+  }, [&](exception_ptr ex) {
+    rejected = true;
+  });
+  await(proxy.setBrightness(45));
+  assert(!rejected);
+  assert(power->calls == vector<int>({ 99, 45 }));
+
+  bool done = false;
+  proxy.setBrightness(99).then([] {
+    abort();
+  }, [&](exception_ptr ex) {
+    done = true;
+  });
+  while (!done)
+    g_main_context_iteration(NULL, TRUE);
+}
+
+/* writes between the keyboard steps come back as echoes */
+static void test_keyboard(Power *power) {
+  BrightnessProxy proxy(BrightnessProxy::KEYBOARD);
+  await(proxy.connect());
+  assert(proxy.getResolution() == (fixed::fromInt(100) + 2) / 3);
+
+  Adapter adapter(&proxy);
+  adapter.setValue(50);
+  while (proxy.getBrightness() != 33)
+    g_main_context_iteration(NULL, TRUE);
+  assert(adapter.getOffset() == 0);
+  assert(adapter.getStats().echoes == 1);
+  assert(adapter.getStats().adjustments == 0);
+
+  /* the same value joins the write in flight, if any */
+  await(proxy.setBrightness(50));
+}
+
+int main() {
+  Power power;
+  setUp(&power, POWER_XML, OBJECTS, N, &vtable, &power);
+
+  {
+    BrightnessProxy proxy;
+    await(proxy.connect());
+    assert(proxy.getBrightness() == 50);
+
+    test_coalesce(&power, proxy);
+    test_failure(&power, proxy);
+  }
+
+  test_keyboard(&power);
+
+  tearDown(&power);
+
+  cout << "OK" << endl;
+}
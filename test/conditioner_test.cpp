@@ -0,0 +1,125 @@
+#include <cassert>
+#include <iostream>
+#include <glib.h>
+
+#include <src/conditioner.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+struct TestSensor: public ISensor {
+    double lightLevel = 0;
+    Unit unit = LUX;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    double getLightLevel() const {
+      return lightLevel;
+    }
+
+    Unit getUnit() const {
+      return unit;
+    }
+
+    void set(double value) {
+      lightLevel = value;
+      lightLevelChanged();
+    }
+};
+
+static gboolean quit(gpointer user_data) {
+  g_main_loop_quit((GMainLoop*) user_data);
+  return FALSE;
+}
+
+static void runFor(guint interval) {
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add(interval, quit, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+static void test_normalize() {
+  assert(ISensor::normalize(0.5, ISensor::LUX) == 0);
+  assert(ISensor::normalize(10, ISensor::LUX) == 33);
+  assert(ISensor::normalize(1000, ISensor::LUX) == 100);
+  assert(ISensor::normalize(42, ISensor::VENDOR) == 42);
+}
+
+static void test_suppress() {
+  TestSensor *sensor = new TestSensor();
+  SensorConditioner input(sensor);
+  input.maxRate = 0;
+
+  int changes = 0;
+  input.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  sensor->lightLevel = 100;
+  input.connect();
+  assert(changes == 1);
+  assert(input.getNormalized() == 67);
+
+  sensor->set(101);
+  sensor->set(105);
+  assert(changes == 1);
+  assert(input.getLightLevel() == 100);
+
+  sensor->set(200);
+  assert(changes == 2);
+  assert(input.getNormalized() == 77);
+
+  const SensorConditioner::Stats &stats = input.getStats();
+  assert(stats.samples == 3);
+  assert(stats.suppressed == 2);
+  assert(stats.processed == 2);
+  assert(stats.coalesced == 0);
+}
+
+static void test_rate() {
+  TestSensor *sensor = new TestSensor();
+  SensorConditioner input(sensor);
+  input.maxRate = 5;
+
+  int changes = 0;
+  input.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  sensor->set(10);
+  assert(changes == 1);
+
+  /* latest wins */
+  sensor->set(20);
+  sensor->set(30);
+  sensor->set(40);
+  assert(changes == 1);
+
+  runFor(250);
+  assert(changes == 2);
+  assert(input.getLightLevel() == 40);
+
+  /* back to the processed value while waiting */
+  sensor->set(60);
+  sensor->set(40);
+  runFor(250);
+  assert(changes == 2);
+
+  const SensorConditioner::Stats &stats = input.getStats();
+  assert(stats.samples == 6);
+  assert(stats.processed == 2);
+  assert(stats.coalesced == 3);
+  assert(stats.suppressed == 1);
+}
+
+int main() {
+  test_normalize();
+  test_suppress();
+  test_rate();
+
+  cout << "OK" << endl;
+}
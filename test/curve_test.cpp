@@ -0,0 +1,152 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include <src/curve.h>
+#include <src/adapter.h>
+
+using namespace std;
+using namespace promise;
+
+/* brightness set is reported back as is */
+struct TestProxy: IBrightnessProxy {
+    int brightness = -1;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    Promise<void> setBrightness(int value) {
+      if (brightness != value) {
+        brightness = value;
+        brightnessChanged();
+      }
+      return resolved();
+    }
+
+    int getBrightness() const {
+      return brightness;
+    }
+};
+
+static void test_input_default() {
+  const InputCurve &curve = InputCurve::standard();
+  assert(curve.map(0) == 0);
+  assert(curve.map(0.5) == 0);
+  assert(curve.map(1) == 0);
+  assert(curve.map(1000) == 100);
+  assert(curve.map(10000) == 100);
+  assert(curve.map(1e9) == 100);
+
+  /* same as the log scale, except on rounding ties */
+  for (double lux = 1; lux < 1000; lux *= 1.01) {
+    double expected = log10(lux) / 3 * 100;
+    assert(abs(curve.map(lux) - expected) <= 0.51);
+  }
+}
+
+static void test_input_points() {
+  InputCurve curve({ { 10, 20 }, { 100, 40 }, { 10000, 100 } });
+  assert(curve.map(5) == 20);
+  assert(curve.map(10) == 20);
+  assert(curve.map(100) == 40);
+  assert(curve.map(1000) == 70);
+  assert(curve.map(20000) == 100);
+}
+
+static void test_invalid() {
+  int thrown = 0;
+  try {
+    InputCurve({ { 0, 0 }, { 10, 100 } });
+  } catch (const invalid_argument &e) {
+    thrown++;
+  }
+  try {
+    InputCurve({ { 10, 0 }, { 10, 100 } });
+  } catch (const invalid_argument &e) {
+    thrown++;
+  }
+  try {
+    OutputCurve({ { 0, 50 }, { 50, 60 }, { 100, 40 } });
+  } catch (const invalid_argument &e) {
+    thrown++;
+  }
+  try {
+    OutputCurve curve { CurvePoints() };
+  } catch (const invalid_argument &e) {
+    thrown++;
+  }
+  assert(thrown == 4);
+}
+
+static void test_output() {
+  OutputCurve identity;
+  for (int i = 0; i <= 100; i++) {
+    assert(identity.map(i) == i);
+    assert(identity.inverse(i) == i);
+  }
+  assert(identity.map(-5) == 0);
+  assert(identity.map(120) == 100);
+
+  /* flat below 20, steeper above */
+  OutputCurve curve({ { 20, 0 }, { 60, 20 }, { 100, 100 } });
+  assert(curve.map(10) == 0);
+  assert(curve.map(40) == 10);
+  assert(curve.map(80) == 60);
+  assert(curve.inverse(0) == 0);
+  assert(curve.inverse(10) == 39);
+  assert(curve.inverse(61) == 80);
+  for (int level = 20; level <= 100; level++) {
+    assert(curve.map(curve.inverse(curve.map(level))) == curve.map(level));
+  }
+}
+
+/* lit in the dark, off above level 40 */
+static void test_falling() {
+  OutputCurve curve({ { 10, 100 }, { 40, 0 } });
+  assert(curve.map(0) == 100);
+  assert(curve.map(25) == 50);
+  assert(curve.map(60) == 0);
+  assert(curve.inverse(100) == 10);
+  assert(curve.inverse(50) == 25);
+  assert(curve.inverse(0) == 100);
+  for (int level = 10; level <= 40; level++) {
+    assert(curve.map(curve.inverse(curve.map(level))) == curve.map(level));
+  }
+}
+
+static void test_adapter() {
+  TestProxy proxy;
+  Adapter adapter(&proxy);
+  adapter.setCurve(OutputCurve({ { 20, 0 }, { 60, 20 }, { 100, 100 } }));
+
+  adapter.setValue(80);
+  assert(proxy.brightness == 60);
+  assert(adapter.getOffset() == 0);
+
+  /* levels on the flat part keep the offset */
+  adapter.setValue(10);
+  assert(proxy.brightness == 0);
+  adapter.setValue(15);
+  assert(adapter.getOffset() == 0);
+
+  /* user change is read back through the inverse */
+  adapter.setValue(80);
+  proxy.setBrightness(70);
+  assert(adapter.getOffset() == 5);
+  assert(adapter.getValue() == 80);
+
+  adapter.setCurve(OutputCurve());
+  assert(proxy.brightness == 85);
+}
+
+int main() {
+  test_input_default();
+  test_input_points();
+  test_invalid();
+  test_output();
+  test_falling();
+  test_adapter();
+  cout << "OK" << endl;
+}
@@ -0,0 +1,229 @@
+#include <cassert>
+#include <iostream>
+#include <glib.h>
+
+#include <src/duty-cycle.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+/* sends the next level on resume, as iio-sensor-proxy does on claim */
+struct TestSensor: public ISensor {
+    double lightLevel = 0;
+    double next = -1;
+    bool running = true;
+    int suspends = 0;
+    int resumes = 0;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    Promise<void> suspend() {
+      assert(running);
+      running = false;
+      suspends++;
+      return resolved();
+    }
+
+    Promise<void> resume() {
+      assert(!running);
+      running = true;
+      resumes++;
+      if (next >= 0)
+        set(next);
+      return resolved();
+    }
+
+    double getLightLevel() const {
+      return lightLevel;
+    }
+
+    Unit getUnit() const {
+      return LUX;
+    }
+
+    void set(double value) {
+      lightLevel = value;
+      lightLevelChanged();
+    }
+};
+
+static gboolean quit(gpointer user_data) {
+  g_main_loop_quit((GMainLoop*) user_data);
+  return FALSE;
+}
+
+static void runFor(guint interval) {
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add(interval, quit, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+static void runUntil(DutyCycle &dutyCycle, DutyCycle::State state) {
+  gint64 deadline = g_get_monotonic_time() + G_USEC_PER_SEC;
+  while (dutyCycle.getState() != state) {
+    g_main_context_iteration(NULL, TRUE);
+    assert(g_get_monotonic_time() < deadline);
+  }
+}
+
+static void configure(DutyCycle &dutyCycle) {
+  dutyCycle.setEnabled(true);
+  dutyCycle.stableTime = 100;
+  dutyCycle.readWindow = 20;
+  dutyCycle.minInterval = 40;
+  dutyCycle.maxInterval = 100;
+}
+
+static void test_stable() {
+  TestSensor *sensor = new TestSensor();
+  sensor->lightLevel = 100;
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+
+  int changes = 0;
+  dutyCycle.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  dutyCycle.connect();
+  assert(dutyCycle.getState() == DutyCycle::CONTINUOUS);
+  assert(dutyCycle.getInterval() == 0);
+
+  /* small changes are stable */
+  runFor(30);
+  sensor->set(105);
+  assert(changes == 1);
+
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(!sensor->running);
+  assert(dutyCycle.getInterval() == 40);
+
+  runUntil(dutyCycle, DutyCycle::READING);
+  assert(sensor->running);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(dutyCycle.getInterval() == 80);
+
+  /* intervals grow up to max */
+  runUntil(dutyCycle, DutyCycle::READING);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(dutyCycle.getInterval() == 100);
+  runUntil(dutyCycle, DutyCycle::READING);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(dutyCycle.getInterval() == 100);
+
+  assert(dutyCycle.getDutyCycle() < 1);
+  assert(dutyCycle.getWakeupsPerMinute() > 0);
+}
+
+/* a read deviating returns to continuous sampling */
+static void test_deviation() {
+  TestSensor *sensor = new TestSensor();
+  sensor->lightLevel = 100;
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+  dutyCycle.connect();
+
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  sensor->next = 102;
+  runUntil(dutyCycle, DutyCycle::READING);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+
+  sensor->next = 1000;
+  runUntil(dutyCycle, DutyCycle::CONTINUOUS);
+  assert(sensor->running);
+  assert(dutyCycle.getInterval() == 0);
+
+  /* stable again at the new level */
+  sensor->next = -1;
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(dutyCycle.getInterval() == 40);
+}
+
+/* levels follow the curve set, not the standard one */
+static void test_curve() {
+  TestSensor *sensor = new TestSensor();
+  sensor->lightLevel = 100;
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+  dutyCycle.setCurve(InputCurve({ { 100, 0 }, { 103, 100 } }));
+  dutyCycle.connect();
+
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  sensor->next = 102;
+  runUntil(dutyCycle, DutyCycle::CONTINUOUS);
+  assert(sensor->running);
+}
+
+static void test_unstable() {
+  TestSensor *sensor = new TestSensor();
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+  dutyCycle.connect();
+
+  for (int i = 0; i < 10; i++) {
+    sensor->set(i % 2 ? 10 : 1000);
+    runFor(30);
+    assert(dutyCycle.getState() == DutyCycle::CONTINUOUS);
+  }
+  assert(sensor->suspends == 0);
+  assert(dutyCycle.getDutyCycle() == 1);
+  assert(dutyCycle.getWakeupsPerMinute() >= 10);
+}
+
+/* suspended by the owner, for example while quiescent */
+static void test_suspend() {
+  TestSensor *sensor = new TestSensor();
+  sensor->lightLevel = 100;
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+  dutyCycle.connect();
+
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  assert(sensor->suspends == 1);
+
+  /* already not running */
+  dutyCycle.suspend();
+  assert(sensor->suspends == 1);
+  runFor(150);
+  assert(!sensor->running);
+  assert(sensor->resumes == 0);
+
+  dutyCycle.resume();
+  assert(sensor->running);
+  assert(dutyCycle.getState() == DutyCycle::CONTINUOUS);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+}
+
+static void test_disabled() {
+  TestSensor *sensor = new TestSensor();
+  sensor->lightLevel = 100;
+  DutyCycle dutyCycle(sensor);
+  configure(dutyCycle);
+  dutyCycle.connect();
+
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+  dutyCycle.setEnabled(false);
+  assert(sensor->running);
+  assert(dutyCycle.getState() == DutyCycle::CONTINUOUS);
+
+  runFor(150);
+  assert(dutyCycle.getState() == DutyCycle::CONTINUOUS);
+  assert(sensor->running);
+
+  dutyCycle.setEnabled(true);
+  runUntil(dutyCycle, DutyCycle::SLEEPING);
+}
+
+int main() {
+  test_stable();
+  test_deviation();
+  test_curve();
+  test_unstable();
+  test_suspend();
+  test_disabled();
+  cout << "OK" << endl;
+}
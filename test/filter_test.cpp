@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <src/filter.h>
+
+using namespace std;
+
+static const gint64 MS = 1000;
+
+/* time for value to change, sampling input at the given interval */
+static gint64 convergence(long interval, bool timer) {
+  PressureFilter filter;
+  filter.setValue(50);
+
+  gint64 start = 1000 * MS;
+  gint64 now = start;
+  gint64 next = start;
+  filter.filter(70, now);
+  while (filter.update(now) == 50) {
+    next += interval * MS;
+    if (timer && filter.nextUpdate() >= 0)
+      now = min(next, now + filter.nextUpdate() * MS);
+    else
+      now = next;
+    if (now == next)
+      filter.filter(70, now);
+  }
+  return (now - start) / MS;
+}
+
+static void test_rate_independent() {
+  /* 4 * 0.7 pressure per second */
+  assert(convergence(100, true) == 358);
+  assert(convergence(1000, true) == 358);
+  assert(convergence(50, false) == 400);
+}
+
+static void test_mid_value() {
+  PressureFilter filter;
+  filter.setValue(50);
+  assert(filter.getFixed() == fixed::fromInt(50));
+
+  filter.filter(60, 0);
+  filter.filter(65, 500 * MS);
+  assert(filter.update(700 * MS) == 50);
+
+  /* value is the time weighted mean of inputs, kept unrounded */
+  long next = filter.nextUpdate();
+  assert(next == 279);
+  assert(filter.update((700 + next) * MS) == 62);
+  fixed::Q16 mid = fixed::fromDouble(62.446);
+  assert(abs(filter.getFixed() - mid) < fixed::fromDouble(0.001));
+  assert(filter.nextUpdate() > 0);
+}
+
+static void test_reset() {
+  PressureFilter filter;
+  filter.setValue(50);
+
+  filter.filter(70, 0);
+  filter.filter(70, 200 * MS);
+  DebugInfo info;
+  filter.updateDebugInfo(&info);
+  assert(info.pressure > 0);
+
+  /* opposite side resets pressure */
+  filter.filter(40, 300 * MS);
+  filter.updateDebugInfo(&info);
+  assert(info.pressure == 0);
+
+  filter.filter(50, 400 * MS);
+  assert(filter.nextUpdate() == -1);
+  assert(filter.update(10000 * MS) == 50);
+}
+
+static void test_down() {
+  PressureFilter filter;
+  filter.timeConstant = 2000;
+  filter.setValue(80);
+
+  filter.filter(60, 0);
+  /* 4 * 0.8 pressure per 2 seconds */
+  assert(filter.nextUpdate() == 625);
+  assert(filter.update(624 * MS) == 80);
+  assert(filter.update(625 * MS) == 60);
+}
+
+static void test_ema() {
+  EmaFilter filter;
+  filter.setValue(0);
+
+  filter.filter(100, 0);
+  assert(filter.update(1000 * MS) == 63);
+
+  /* next rounding step, reached at 63.5 */
+  long next = filter.nextUpdate();
+  assert(next == 8);
+  assert(filter.update((1000 + next - 1) * MS) == 63);
+  assert(filter.update((1000 + next) * MS) == 64);
+
+  filter.setValue(100);
+  assert(filter.nextUpdate() == -1);
+}
+
+/* finer steps for backends with more resolution */
+static void test_ema_step() {
+  EmaFilter filter;
+  filter.setStep(fixed::ONE / 4);
+  filter.setValue(0);
+
+  filter.filter(100, 0);
+  filter.update(1000 * MS);
+  assert(abs(filter.getFixed() - fixed::fromDouble(63.212)) < 10);
+
+  /* next step, reached at 63.375 */
+  long next = filter.nextUpdate();
+  assert(next == 5);
+  filter.update((1000 + next - 1) * MS);
+  assert(filter.getFixed() < fixed::fromDouble(63.375));
+  filter.update((1000 + next) * MS);
+  assert(filter.getFixed() >= fixed::fromDouble(63.375));
+
+  filter.filter(63, 2000 * MS);
+  filter.update(100000 * MS);
+  assert(filter.nextUpdate() == -1);
+}
+
+static int median(std::vector<int> window) {
+  sort(window.begin(), window.end());
+  size_t n = window.size();
+  return n % 2 ? window[n / 2] : round((window[n / 2 - 1] + window[n / 2]) * 0.5);
+}
+
+static void test_median_spike() {
+  MedianFilter filter(5);
+  filter.setValue(40);
+
+  assert(filter.filter(90, 0) == 40);
+  assert(filter.filter(95, 0) == 40);
+  assert(filter.filter(40, 0) == 40);
+  assert(filter.filter(40, 0) == 40);
+  assert(filter.filter(40, 0) == 40);
+
+  /* level change passes once it fills more than half of the window */
+  assert(filter.filter(60, 0) == 40);
+  assert(filter.filter(60, 0) == 40);
+  assert(filter.filter(60, 0) == 60);
+}
+
+static void test_median_random() {
+  srand(1);
+  for (size_t size = 1; size < 10; size++) {
+    MedianFilter filter(size);
+    filter.setValue(50);
+    std::vector<int> window(size, 50);
+    for (int i = 0; i < 1000; i++) {
+      int v = rand() % 101;
+      window.erase(window.begin());
+      window.push_back(v);
+      assert(filter.filter(v, 0) == median(window));
+    }
+  }
+}
+
+static void test_median_held() {
+  MedianFilter filter(3);
+  filter.interval = 100;
+  filter.setValue(10);
+
+  filter.filter(30, 0);
+  assert(filter.nextUpdate() == 100);
+  assert(filter.update(50 * MS) == 10);
+  assert(filter.update(100 * MS) == 30);
+  assert(filter.nextUpdate() == -1);
+}
+
+static void test_kalman() {
+  KalmanFilter filter;
+  filter.setValue(20);
+
+  /* first sample with fresh uncertainty */
+  assert(filter.filter(60, 0) == 40);
+
+  /* converges on held input */
+  gint64 now = 0;
+  while (filter.nextUpdate() >= 0) {
+    now += filter.nextUpdate() * MS;
+    filter.update(now);
+    assert(now < 60000 * MS);
+  }
+  assert(filter.getValue() == 60);
+
+  /* noisy samples move the estimate less than the noise */
+  for (int i = 1; i <= 10; i++) {
+    filter.filter(i % 2 ? 66 : 54, now + i * 100 * MS);
+    assert(abs(filter.getValue() - 60) < 6);
+  }
+}
+
+static void test_hysteresis() {
+  HysteresisFilter filter;
+  filter.threshold = 5;
+  filter.setValue(50);
+
+  assert(filter.filter(54, 0) == 50);
+  assert(filter.filter(46, 0) == 50);
+  assert(filter.filter(55, 0) == 55);
+  assert(filter.filter(51, 0) == 55);
+  assert(filter.filter(50, 0) == 50);
+}
+
+static void test_predictive() {
+  EmaFilter *ema = new EmaFilter();
+  ema->timeConstant = 10000;
+  PredictiveFilter filter(ema);
+  filter.window = 5000;
+  filter.leadTime = 5000;
+  filter.limit = 5;
+  filter.setValue(50);
+
+  /* held input, no lead */
+  for (gint64 t = 0; t <= 3000; t += 1000)
+    assert(filter.filter(50, t * 1000) == 50);
+  assert(filter.nextUpdate() == -1);
+
+  /* rising one level per second, lead is bounded */
+  int input = 50;
+  for (gint64 t = 4000; t <= 20000; t += 1000) {
+    int value = filter.filter(++input, t * 1000);
+    assert(value > ema->getValue() || t < 6000);
+    assert(value - ema->getValue() <= 5);
+    assert(value <= input);
+  }
+
+  /* trend fades out without stepping back */
+  int last = filter.getValue();
+  for (gint64 t = 21000; t <= 60000; t += 1000) {
+    int value = filter.filter(input, t * 1000);
+    assert(value >= last);
+    last = value;
+  }
+  assert(filter.getValue() == ema->getValue());
+}
+
+static void test_dead_band() {
+  using namespace fixed;
+
+  DeadBand band;
+  band.up = ONE;
+  band.down = 2 * ONE;
+  band.dwell = 1000;
+  band.setValue(fromInt(50));
+
+  /* asymmetric thresholds */
+  assert(band.filter(fromInt(50) + HALF, 0) == fromInt(50));
+  assert(band.filter(fromInt(49), 0) == fromInt(50));
+  assert(band.nextUpdate(0) == -1);
+  assert(band.filter(fromInt(51), 0) == fromInt(51));
+  assert(band.getChanges() == 1);
+
+  /* held for the dwell time */
+  assert(band.filter(fromInt(49), 400000) == fromInt(51));
+  assert(band.nextUpdate(400000) == 600);
+  assert(band.update(1000000) == fromInt(49));
+  assert(band.getChanges() == 2);
+  assert(band.changesPerHour() == 7200);
+}
+
+static void test_fast_path() {
+  EmaFilter *ema = new EmaFilter();
+  ema->timeConstant = 10000;
+  FastPathFilter filter(ema);
+  filter.threshold = 20;
+  filter.confirmTime = 300;
+  filter.setValue(50);
+
+  /* small changes keep the damping */
+  assert(filter.filter(60, 0) == 50);
+  assert(filter.update(300 * MS) == 50);
+  filter.setValue(50);
+
+  /* jump not held for the confirm time */
+  filter.filter(90, 1000 * MS);
+  assert(filter.nextUpdate() >= 0);
+  filter.filter(50, 1200 * MS);
+  assert(filter.update(1500 * MS) < 55);
+  filter.setValue(50);
+
+  /* jump to the other side restarts confirmation */
+  filter.filter(90, 2000 * MS);
+  filter.filter(10, 2200 * MS);
+  assert(filter.update(2400 * MS) > 40);
+
+  /* jump held */
+  filter.filter(10, 2500 * MS);
+  assert(filter.update(2500 * MS) == 10);
+  assert(filter.nextUpdate() == -1);
+}
+
+int main() {
+  test_rate_independent();
+  test_mid_value();
+  test_reset();
+  test_down();
+  test_ema();
+  test_ema_step();
+  test_median_spike();
+  test_median_random();
+  test_median_held();
+  test_kalman();
+  test_hysteresis();
+  test_predictive();
+  test_dead_band();
+  test_fast_path();
+
+  cout << "OK" << endl;
+}
@@ -0,0 +1,97 @@
+#include <cassert>
+#include <iostream>
+
+#include <src/fixed.h>
+#include <src/curve.h>
+#include <src/adapter.h>
+
+using namespace std;
+using namespace promise;
+using namespace fixed;
+
+/* backend with 1000 steps, brightness set is reported back quantized */
+struct FineProxy: IBrightnessProxy {
+    int raw = -1;
+    int writes = 0;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    Promise<void> setBrightness(int value) {
+      return setBrightnessFixed(fromInt(value));
+    }
+
+    int getBrightness() const {
+      return toInt(getBrightnessFixed());
+    }
+
+    Promise<void> setBrightnessFixed(Q16 value) {
+      int raw = scale(value, 1000, fromInt(100));
+      if (this->raw != raw) {
+        this->raw = raw;
+        writes++;
+        brightnessChanged();
+      }
+      return resolved();
+    }
+
+    Q16 getBrightnessFixed() const {
+      return scale(raw, fromInt(100), 1000);
+    }
+};
+
+static void test_conversions() {
+  assert(fromInt(1) == ONE);
+  assert(toInt(fromDouble(2.5)) == 3);
+  assert(toInt(fromDouble(2.49)) == 2);
+  assert(toInt(fromDouble(-2.5)) == -3);
+  assert(toInt(fromDouble(-2.49)) == -2);
+  assert(toInt(fromInt(-200)) == -200);
+  assert(toDouble(fromDouble(0.75)) == 0.75);
+  assert(lerp(fromInt(10), fromInt(20), HALF) == fromInt(15));
+  assert(scale(15, 1, 2) == 8);
+  assert(scale(-15, 1, 2) == -8);
+}
+
+static void test_curve() {
+  OutputCurve curve({ { 0, 0 }, { 50, 10 }, { 100, 100 } });
+  assert(curve.mapFixed(fromInt(50)) == fromInt(10));
+  assert(curve.mapFixed(fromDouble(50.5)) == fromDouble(10.9));
+  assert(curve.mapFixed(fromInt(150)) == fromInt(100));
+  assert(curve.mapFixed(fromInt(-5)) == 0);
+  for (int level = 0; level <= 100; level++) {
+    assert(toInt(curve.mapFixed(fromInt(level))) == curve.map(level));
+  }
+}
+
+/* sub percent changes reach the backend, without moving the offset */
+static void test_adapter() {
+  FineProxy proxy;
+  Adapter adapter(&proxy);
+
+  adapter.setValueFixed(fromDouble(40.25));
+  assert(proxy.raw == 403);
+  assert(adapter.getValue() == 40);
+  assert(adapter.getOffset() == 0);
+
+  adapter.setValueFixed(fromDouble(40.5));
+  assert(proxy.raw == 405);
+  assert(adapter.getValue() == 41);
+  assert(adapter.getOffset() == 0);
+
+  /* same raw step, no write */
+  adapter.setValueFixed(fromDouble(40.52));
+  assert(proxy.writes == 2);
+
+  /* user change */
+  proxy.setBrightness(60);
+  assert(adapter.getOffset() == 19);
+}
+
+int main() {
+  test_conversions();
+  test_curve();
+  test_adapter();
+  cout << "OK" << endl;
+}
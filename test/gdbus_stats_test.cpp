@@ -0,0 +1,108 @@
+#include <cassert>
+#include <iostream>
+#include <gio/gio.h>
+
+#include <src/gdbus-stats.h>
+
+using namespace std;
+using namespace gdbus;
+
+static void test_histogram_index() {
+  for (long v = 0; v < (1L << Histogram::MAX_BITS); v = v * 3 / 2 + 1) {
+    int index = Histogram::indexOf(v);
+    assert(index >= 0 && index < Histogram::SIZE);
+    assert(Histogram::lowestAt(index) <= v);
+    assert(Histogram::highestAt(index) >= v);
+    /* relative error is bounded by the sub bucket count */
+    long width = Histogram::highestAt(index) - Histogram::lowestAt(index) + 1;
+    assert(width == 1 || width * Histogram::SUB <= v);
+  }
+  assert(Histogram::indexOf(-1) == 0);
+  assert(Histogram::indexOf(1L << 40) == Histogram::SIZE - 1);
+}
+
+static void test_histogram_percentile() {
+  Histogram h;
+  assert(h.percentile(50) == 0);
+
+  for (int i = 1; i <= 100; i++) {
+    h.record(i * 1000);
+  }
+
+  assert(h.count() == 100);
+  assert(h.max() == 100000);
+
+  long p50 = h.percentile(50);
+  assert(p50 >= 50000 && p50 <= 50000 * 9 / 8);
+
+  long p99 = h.percentile(99);
+  assert(p99 >= 99000 && p99 <= 100000);
+
+  assert(h.percentile(100) == 100000);
+}
+
+static void test_table() {
+  CallStatsTable &table = callStats();
+  table.reset();
+
+  CallStats *a = table.lookup("org.example.Iface", "Method");
+  CallStats *b = table.lookup("org.example.Iface", "Other");
+  assert(a != b);
+  assert(table.lookup("org.example.Iface", "Method") == a);
+  assert(table.size == 2);
+
+  for (int i = table.size; i < CallStatsTable::SIZE + 4; i++) {
+    string method = "Method" + to_string(i);
+    table.lookup("org.example.Iface", method.c_str());
+  }
+  assert(table.size == CallStatsTable::SIZE);
+  assert(table.lookup("org.example.Iface", "Method") == a);
+
+  /* named entries are kept, the overflow goes to its own slot */
+  CallStats *other = &table.entries[CallStatsTable::SIZE - 1];
+  assert(string(other->method) == "(other)");
+  assert(string(table.entries[CallStatsTable::SIZE - 2].method)
+      == "Method" + to_string(CallStatsTable::SIZE - 2));
+  assert(table.lookup("org.example.Iface", "Unknown") == other);
+
+  table.reset();
+  assert(table.size == 0);
+}
+
+static void test_record() {
+  CallStatsTable &table = callStats();
+  table.reset();
+
+  CallStats *stats = table.lookup("org.example.Iface", "Method");
+  gint64 start = g_get_monotonic_time();
+
+  GException none;
+  GException timeout(g_error_new_literal(
+      G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "timeout"));
+  GException cancelled(g_error_new_literal(
+      G_IO_ERROR, G_IO_ERROR_CANCELLED, "cancelled"));
+  GException denied(g_error_new_literal(
+      G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED, "denied"));
+
+  recordCall(stats, start, none);
+  recordCall(stats, start, timeout);
+  recordCall(stats, start, cancelled);
+  recordCall(stats, start, denied);
+
+  assert(stats->timeouts == 1);
+  assert(stats->cancelled == 1);
+  assert(stats->errors == 1);
+  /* cancelled calls have no meaningful latency */
+  assert(stats->latency.count() == 3);
+
+  cout << *stats << endl;
+}
+
+int main() {
+  test_histogram_index();
+  test_histogram_percentile();
+  test_table();
+  test_record();
+
+  cout << "OK" << endl;
+}
@@ -1,5 +1,7 @@
 #include <cassert>
 #include <iostream>
+#include <stdexcept>
+#include <gio/gio.h>
 
 #include <src/gexception.h>
 
@@ -68,12 +70,56 @@ static void test_move() {
   assert(b->message);
 }
 
+static void test_kind() {
+  GException none;
+  assert(none.kind() == GException::NONE);
+
+  GException other;
+  fill_gerror(other.get());
+  assert(other.kind() == GException::OTHER);
+  assert(!other.isTransient());
+  assert(!other.isPermanent());
+
+  GException unknown(g_error_new_literal(
+      G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN, "unknown"));
+  assert(unknown.kind() == GException::SERVICE_UNKNOWN);
+  assert(unknown.isTransient());
+
+  GException noReply(g_error_new_literal(
+      G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY, "no reply"));
+  assert(noReply.kind() == GException::TIMEOUT);
+  assert(noReply.isTransient());
+
+  GException denied(g_error_new_literal(
+      G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED, "denied"));
+  assert(denied.kind() == GException::ACCESS_DENIED);
+  assert(denied.isPermanent());
+
+  GException method(g_error_new_literal(
+      G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD, "method"));
+  assert(method.kind() == GException::UNKNOWN_METHOD);
+  assert(method.isPermanent());
+
+  GException cancelled(g_error_new_literal(
+      G_IO_ERROR, G_IO_ERROR_CANCELLED, "cancelled"));
+  assert(cancelled.kind() == GException::CANCELLED);
+  assert(!cancelled.isTransient());
+  assert(!cancelled.isPermanent());
+
+  assert(GException::kindOf(make_exception_ptr(denied))
+      == GException::ACCESS_DENIED);
+  assert(GException::kindOf(make_exception_ptr(runtime_error("x")))
+      == GException::OTHER);
+  assert(GException::kindOf(exception_ptr()) == GException::NONE);
+}
+
 int main() {
   test_throws(unsafe_pattern);
   test_throws(safe_pattern);
   test_throw_null();
   test_copy();
   test_move();
+  test_kind();
 
   cout << "OK" << endl;
 }
@@ -12,7 +12,7 @@ int main() {
   bool cannotConnect = false;
   GMainLoop *loop = g_main_loop_new(NULL, FALSE);
 
-  IdleAware proxy;
+  IdleAware proxy(new BrightnessProxy());
 
   proxy.brightnessChanged << [&] {
     cout << "Brightness: " << proxy.getBrightness() << endl;
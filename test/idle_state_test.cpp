@@ -0,0 +1,321 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <gio/gio.h>
+
+#include <src/idle-aware.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *XML =
+    "<node>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Screen'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.Mutter.IdleMonitor'>"
+    "    <method name='GetIdletime'>"
+    "      <arg name='idletime' type='t' direction='out'/>"
+    "    </method>"
+    "    <method name='AddIdleWatch'>"
+    "      <arg name='interval' type='t' direction='in'/>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='AddUserActiveWatch'>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='RemoveWatch'>"
+    "      <arg name='id' type='u' direction='in'/>"
+    "    </method>"
+    "    <signal name='WatchFired'>"
+    "      <arg name='id' type='u'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+static const int N = 2;
+
+static const MockObject OBJECTS[N] = {
+    { "/org/gnome/SettingsDaemon/Power", "org.gnome.SettingsDaemon.Power" },
+    { "/org/gnome/Mutter/IdleMonitor/Core", "org.gnome.Mutter.IdleMonitor" }
+};
+
+/* the flags of IdleAware */
+static const int IDLE = 1 << 0;
+static const int INACTIVE = 1 << 1;
+static const int DISABLED = 1 << 2;
+
+struct Services: MockDBus {
+    int brightness = 50;
+    vector<int> writes;
+    int idleTimeCalls = 0;
+    int activeWatchCalls = 0;
+    int removeCalls = 0;
+    guint idleKey = 0;
+    guint activeKey = 0;
+    guint watches = 0;
+    vector<string> calls;
+    bool fireOnAdd = false;
+    guint fireKey = 0;
+};
+
+static void emitBrightness(Services *services, int brightness) {
+  services->brightness = brightness;
+  emitPropertyChanged(
+      services,
+      OBJECTS[0].path,
+      "org.gnome.SettingsDaemon.Power.Screen",
+      "Brightness",
+      g_variant_new_int32(brightness));
+}
+
+static void fireWatch(Services *services, guint key) {
+  emitSignal(
+      services,
+      OBJECTS[1].path,
+      "org.gnome.Mutter.IdleMonitor",
+      "WatchFired",
+      g_variant_new("(u)", key));
+}
+
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  GVariant *ret = NULL;
+
+  if (g_str_equal(interface_name, "org.gnome.Mutter.IdleMonitor"))
+    services->calls.push_back(method_name);
+
+  /* Set calls come here since there is no set_property */
+  if (g_str_equal(method_name, "Set")) {
+    GVariant *value;
+    g_variant_get(parameters, "(&s&sv)", NULL, NULL, &value);
+    services->writes.push_back(g_variant_get_int32(value));
+    g_variant_unref(value);
+    emitBrightness(services, services->writes.back());
+  } else if (g_str_equal(method_name, "GetIdletime")) {
+    services->idleTimeCalls++;
+    ret = g_variant_new("(t)", (guint64) 0);
+  } else if (g_str_equal(method_name, "AddIdleWatch")) {
+    services->idleKey = ++services->watches;
+    ret = g_variant_new("(u)", services->idleKey);
+    /* fired before the caller knows the key */
+    if (services->fireOnAdd) {
+      fireWatch(services,
+          services->fireKey ? services->fireKey : services->idleKey);
+    }
+  } else if (g_str_equal(method_name, "AddUserActiveWatch")) {
+    services->activeWatchCalls++;
+    services->activeKey = ++services->watches;
+    ret = g_variant_new("(u)", services->activeKey);
+  } else if (g_str_equal(method_name, "RemoveWatch")) {
+    services->removeCalls++;
+  }
+  g_dbus_method_invocation_return_value(invocation, ret);
+}
+
+static GVariant* onGetProperty(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *property_name,
+    GError **error,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  return g_variant_new_int32(services->brightness);
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall, onGetProperty };
+
+static void* awaitId(const Promise<void*> &promise) {
+  void *id = nullptr;
+  await(promise << [&](void *value) {
+    id = value;
+  });
+  return id;
+}
+
+static int flagsOf(const IdleAware &idleAware) {
+  DebugInfo info;
+  idleAware.updateDebugInfo(&info);
+  return info.flags;
+}
+
+static void awaitFlags(const IdleAware &idleAware, int flags) {
+  gint64 deadline = g_get_monotonic_time() + 2 * G_USEC_PER_SEC;
+  while (flagsOf(idleAware) != flags) {
+    g_main_context_iteration(NULL, FALSE);
+    assert(g_get_monotonic_time() < deadline);
+  }
+}
+
+static void awaitBrightness(const IdleAware &idleAware, int brightness) {
+  gint64 deadline = g_get_monotonic_time() + 2 * G_USEC_PER_SEC;
+  while (idleAware.getBrightness() != brightness) {
+    g_main_context_iteration(NULL, FALSE);
+    assert(g_get_monotonic_time() < deadline);
+  }
+}
+
+/* one idle period: dimmed while idle, restored when active */
+static void idlePeriod(Services *services, IdleAware *idleAware) {
+  fireWatch(services, services->idleKey);
+  awaitFlags(*idleAware, IDLE);
+  assert(!idleAware->isInactive());
+
+  /* dimmed by the session, the value set meanwhile is kept for later */
+  emitBrightness(services, 20);
+  awaitFlags(*idleAware, IDLE | INACTIVE | DISABLED);
+  assert(idleAware->isInactive());
+  await(idleAware->setBrightness(80));
+  assert(services->writes.empty());
+
+  fireWatch(services, services->activeKey);
+  awaitFlags(*idleAware, 0);
+  assert(!idleAware->isInactive());
+  awaitBrightness(*idleAware, 80);
+  assert(services->writes == vector<int>({ 80 }));
+  services->writes.clear();
+}
+
+static void test_idle(Services *services) {
+  IdleAware idleAware(new BrightnessProxy());
+  int emitted = 0;
+  idleAware.brightnessChanged << [&] {
+    emitted++;
+  };
+  int inactiveChanges = 0;
+  idleAware.inactiveChanged << [&] {
+    inactiveChanges++;
+  };
+  await(idleAware.connect());
+  assert(services->idleKey);
+  assert(services->activeWatchCalls == 0);
+
+  /* not idle, changes pass through */
+  emitBrightness(services, 60);
+  awaitBrightness(idleAware, 60);
+  assert(flagsOf(idleAware) == 0);
+
+  idlePeriod(services, &idleAware);
+  assert(services->activeWatchCalls == 1);
+
+  /* the same watch is armed again, no duplicates on repeated idle */
+  guint activeKey = services->activeKey;
+  fireWatch(services, services->idleKey);
+  fireWatch(services, services->idleKey);
+  idlePeriod(services, &idleAware);
+  assert(services->activeWatchCalls == 2);
+  assert(services->activeKey != activeKey);
+
+  /* the old key is disarmed */
+  emitBrightness(services, 70);
+  awaitBrightness(idleAware, 70);
+  fireWatch(services, activeKey);
+  emitBrightness(services, 71);
+  awaitBrightness(idleAware, 71);
+  assert(flagsOf(idleAware) == 0);
+
+  /* idle without a dim, still active and writing */
+  int changes = inactiveChanges;
+  fireWatch(services, services->idleKey);
+  awaitFlags(idleAware, IDLE);
+  awaitCalls(services->activeWatchCalls, 3);
+  await(idleAware.setBrightness(75));
+  assert(services->writes == vector<int>({ 75 }));
+  services->writes.clear();
+  awaitBrightness(idleAware, 75);
+  assert(flagsOf(idleAware) == IDLE);
+  assert(!idleAware.isInactive());
+  fireWatch(services, services->activeKey);
+  awaitFlags(idleAware, 0);
+  assert(inactiveChanges == changes);
+  services->writes.clear();
+
+  /* never asked for the idle time, never removed a watch */
+  assert(services->idleTimeCalls == 0);
+  assert(services->removeCalls == 0);
+  assert(emitted > 0);
+
+  /* once on each idle period start and end */
+  assert(inactiveChanges == 4);
+}
+
+static void test_refresh(Services *services) {
+  IdleMonitorProxy monitor;
+  int idle = 0;
+  int active = 0;
+  await(monitor.connect());
+  awaitId(monitor.addIdleWatch(1000, [&] {
+    idle++;
+  }));
+  awaitId(monitor.addUserActiveWatch([&] {
+    active++;
+  }, true));
+  guint activeKey = services->activeKey;
+  assert(monitor.getRefreshTime() == -1);
+
+  /* all calls at once, removals first */
+  services->calls.clear();
+  services->fireOnAdd = true;
+  await(monitor.refreshAll());
+  services->fireOnAdd = false;
+  assert(services->calls.size() == 4);
+  assert(services->calls[0] == "RemoveWatch");
+  assert(services->calls[1] == "RemoveWatch");
+  assert(services->calls[2] != "RemoveWatch");
+  assert(services->calls[3] != "RemoveWatch");
+  assert(services->activeKey != activeKey);
+  assert(monitor.getRefreshTime() >= 0);
+
+  /* fired before the swap, delivered after */
+  assert(idle == 1);
+  assert(monitor.getLostEvents() == 0);
+
+  /* new keys are in place */
+  fireWatch(services, services->idleKey);
+  awaitCalls(idle, 2);
+  fireWatch(services, services->activeKey);
+  awaitCalls(active, 1);
+
+  /* the disarmed watch is left alone, an unknown event is lost */
+  services->calls.clear();
+  services->fireOnAdd = true;
+  services->fireKey = 999;
+  await(monitor.refreshAll());
+  services->fireOnAdd = false;
+  services->fireKey = 0;
+  assert(services->calls.size() == 2);
+  assert(monitor.getLostEvents() == 1);
+  assert(idle == 2);
+
+  await(monitor.removeAll());
+}
+
+int main() {
+  Services services;
+  setUp(&services, XML, OBJECTS, N, &vtable, &services);
+
+  test_idle(&services);
+  test_refresh(&services);
+
+  /* until watches are removed */
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+
+  tearDown(&services);
+
+  cout << "OK" << endl;
+}
@@ -0,0 +1,257 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <src/iio-sensor.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+using Unit = IioSensor::Unit;
+
+static string readFile(const string &path) {
+  gchar *contents = NULL;
+  assert(g_file_get_contents(path.c_str(), &contents, NULL, NULL));
+  string value(g_strstrip(contents));
+  g_free(contents);
+  return value;
+}
+
+static void writeFile(const string &path, const string &value) {
+  assert(g_file_set_contents(path.c_str(), value.c_str(), -1, NULL));
+}
+
+static void makeDir(const string &path) {
+  assert(g_mkdir(path.c_str(), 0755) == 0);
+}
+
+static void removeTree(const string &path) {
+  GDir *dir = g_dir_open(path.c_str(), 0, NULL);
+  if (dir) {
+    const char *name;
+    while ((name = g_dir_read_name(dir)))
+      removeTree(path + "/" + name);
+    g_dir_close(dir);
+  }
+  g_remove(path.c_str());
+}
+
+static void addScanElement(
+    const string &dir,
+    const string &channel,
+    int index,
+    const string &type,
+    int enabled) {
+  writeFile(dir + "/" + channel + "_en", to_string(enabled));
+  writeFile(dir + "/" + channel + "_index", to_string(index));
+  writeFile(dir + "/" + channel + "_type", type);
+}
+
+static void connect(IioSensor &sensor) {
+  bool done = false;
+  sensor.connect().then([&] {
+    done = true;
+  }, [](exception_ptr ex) {
+    cerr << "Cannot connect: " << ex << endl;
+    abort();
+  });
+  assert(done);
+}
+
+static gboolean quit(gpointer user_data) {
+  g_main_loop_quit((GMainLoop*) user_data);
+  return FALSE;
+}
+
+static void runFor(guint interval) {
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add(interval, quit, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+static void test_format() {
+  IioSensor::ScanFormat format;
+  assert(IioSensor::parseFormat("le:u16/16>>0", format));
+  assert(!format.be && !format.sign);
+  assert(format.bits == 16 && format.storage == 2 && format.shift == 0);
+
+  guint8 le[] = { 0x34, 0x12 };
+  assert(IioSensor::decode(format, le) == 0x1234);
+
+  assert(IioSensor::parseFormat("be:s12/16>>4", format));
+  assert(format.be && format.sign);
+  guint8 be[] = { 0xff, 0xf0 };
+  assert(IioSensor::decode(format, be) == -1);
+  guint8 be2[] = { 0x01, 0x20 };
+  assert(IioSensor::decode(format, be2) == 0x12);
+
+  assert(!IioSensor::parseFormat("", format));
+  assert(!IioSensor::parseFormat("le:u16/12>>0", format));
+  assert(!IioSensor::parseFormat("xe:u16/16>>0", format));
+}
+
+static void test_input(const string &root) {
+  string path = root + "/iio:device0";
+  makeDir(path);
+  writeFile(path + "/in_illuminance_input", "12.5");
+
+  IioSensor sensor("", root, root, 10);
+  int changes = 0;
+  sensor.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  connect(sensor);
+  assert(sensor.getName() == "iio:device0");
+  assert(sensor.getUnit() == Unit::LUX);
+  assert(sensor.getLightLevel() == 12.5);
+  assert(!sensor.isBuffered());
+  assert(changes == 1);
+
+  writeFile(path + "/in_illuminance_input", "40");
+  runFor(100);
+  assert(sensor.getLightLevel() == 40);
+  assert(changes == 2);
+  assert(!sensor.isStale());
+
+  /* stale while the attribute cannot be read */
+  int staleChanges = 0;
+  sensor.staleChanged << [&] {
+    staleChanges++;
+  };
+  g_remove((path + "/in_illuminance_input").c_str());
+  runFor(100);
+  assert(sensor.isStale());
+  writeFile(path + "/in_illuminance_input", "40");
+  runFor(100);
+  assert(!sensor.isStale());
+  assert(staleChanges == 2);
+  assert(changes == 2);
+
+  removeTree(path);
+}
+
+static void test_raw(const string &root) {
+  string path = root + "/iio:device0";
+  makeDir(path);
+  writeFile(path + "/in_illuminance0_raw", "100");
+
+  {
+    IioSensor sensor("", root, root, 0);
+    connect(sensor);
+    assert(sensor.getUnit() == Unit::VENDOR);
+    assert(sensor.getLightLevel() == 100);
+  }
+
+  writeFile(path + "/in_illuminance0_scale", "0.5");
+  writeFile(path + "/in_illuminance0_offset", "10");
+
+  {
+    IioSensor sensor("", root, root, 0);
+    connect(sensor);
+    assert(sensor.getUnit() == Unit::LUX);
+    assert(sensor.getLightLevel() == 55);
+  }
+
+  removeTree(path);
+}
+
+static void test_missing(const string &root) {
+  IioSensor sensor("", root, root, 0);
+  bool rejected = false;
+  sensor.connect().then([] {
+    abort();
+  }, [&](exception_ptr ex) {
+    rejected = true;
+  });
+  assert(rejected);
+}
+
+/* u16 illuminance, padding, s64 timestamp */
+static void writeSample(int fd, guint16 value) {
+  guint8 sample[16] = { 0 };
+  sample[0] = value & 0xff;
+  sample[1] = value >> 8;
+  assert(write(fd, sample, sizeof(sample)) == sizeof(sample));
+}
+
+static void test_buffer(const string &root) {
+  string path = root + "/iio:device1";
+  string scanDir = path + "/scan_elements";
+  makeDir(path);
+  makeDir(scanDir);
+  makeDir(path + "/buffer");
+  writeFile(path + "/in_illuminance_raw", "5");
+  writeFile(path + "/in_illuminance_scale", "2");
+  writeFile(path + "/buffer/enable", "0");
+  addScanElement(scanDir, "in_illuminance", 0, "le:u16/16>>0", 0);
+  addScanElement(scanDir, "in_timestamp", 1, "le:s64/64>>0", 1);
+
+  /* the fifo stands in for the character device */
+  string devRoot = root + "/dev";
+  makeDir(devRoot);
+  assert(mkfifo((devRoot + "/iio:device1").c_str(), 0600) == 0);
+  int fd = open((devRoot + "/iio:device1").c_str(), O_RDWR);
+  assert(fd >= 0);
+
+  IioSensor sensor("iio:device1", root, devRoot, 10);
+  int changes = 0;
+  sensor.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  connect(sensor);
+  assert(sensor.isBuffered());
+  assert(sensor.getLightLevel() == 10);
+  assert(readFile(scanDir + "/in_illuminance_en") == "1");
+  assert(readFile(path + "/buffer/enable") == "1");
+
+  writeSample(fd, 10);
+  writeSample(fd, 21);
+  runFor(50);
+  assert(sensor.getLightLevel() == 42);
+
+  /* device gone, back to polling */
+  close(fd);
+  runFor(50);
+  assert(!sensor.isBuffered());
+  assert(readFile(path + "/buffer/enable") == "0");
+  assert(readFile(scanDir + "/in_illuminance_en") == "0");
+
+  writeFile(path + "/in_illuminance_raw", "7");
+  runFor(100);
+  assert(sensor.getLightLevel() == 14);
+
+  /* cannot open the device, the scan element is left as it was */
+  IioSensor missing("iio:device1", root, root + "/none", 10);
+  connect(missing);
+  assert(!missing.isBuffered());
+  assert(readFile(scanDir + "/in_illuminance_en") == "0");
+
+  removeTree(path);
+  removeTree(devRoot);
+}
+
+int main() {
+  gchar *tmp = g_dir_make_tmp("iio_sensor_test-XXXXXX", NULL);
+  assert(tmp);
+  string root(tmp);
+  g_free(tmp);
+
+  test_format();
+  test_input(root);
+  test_raw(root);
+  test_missing(root);
+  test_buffer(root);
+
+  removeTree(root);
+
+  cout << "OK" << endl;
+}
@@ -0,0 +1,173 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <src/logind-backlight.h>
+#include <src/gexception.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *SESSION_PATH = "/org/freedesktop/login1/session/test";
+
+static const char *SESSION_XML =
+    "<node>"
+    "  <interface name='org.freedesktop.login1.Session'>"
+    "    <method name='SetBrightness'>"
+    "      <arg name='subsystem' type='s' direction='in'/>"
+    "      <arg name='name' type='s' direction='in'/>"
+    "      <arg name='brightness' type='u' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static const MockObject SESSION = { SESSION_PATH, "org.freedesktop.login1" };
+
+struct Logind: MockDBus {
+    string root;
+    int calls = 0;
+};
+
+static void writeFile(const string &path, const string &value) {
+  assert(g_file_set_contents(path.c_str(), value.c_str(), -1, NULL));
+}
+
+static string readFile(const string &path) {
+  gchar *contents = NULL;
+  assert(g_file_get_contents(path.c_str(), &contents, NULL, NULL));
+  string value(g_strstrip(contents));
+  g_free(contents);
+  return value;
+}
+
+static void addDevice(const string &root, const string &name, int max) {
+  string path = root + "/" + name;
+  assert(g_mkdir(path.c_str(), 0755) == 0);
+  writeFile(path + "/type", "raw");
+  writeFile(path + "/max_brightness", to_string(max));
+  writeFile(path + "/brightness", to_string(max));
+}
+
+static void removeTree(const string &path) {
+  GDir *dir = g_dir_open(path.c_str(), 0, NULL);
+  if (dir) {
+    const char *name;
+    while ((name = g_dir_read_name(dir)))
+      removeTree(path + "/" + name);
+    g_dir_close(dir);
+  }
+  g_remove(path.c_str());
+}
+
+/* writes the device as logind does */
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Logind *logind = (Logind*) user_data;
+  const gchar *subsystem;
+  const gchar *name;
+  guint32 value;
+  g_variant_get(parameters, "(&s&su)", &subsystem, &name, &value);
+  logind->calls++;
+
+  string path = logind->root + "/" + name;
+  if (g_strcmp0(subsystem, "backlight") != 0
+      || !g_file_test(path.c_str(), G_FILE_TEST_IS_DIR)) {
+    g_dbus_method_invocation_return_error(
+        invocation,
+        G_DBUS_ERROR,
+        G_DBUS_ERROR_INVALID_ARGS,
+        "No such device: %s",
+        name);
+    return;
+  }
+
+  writeFile(path + "/brightness", to_string(value));
+  g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall };
+
+static exception_ptr awaitError(const Promise<void> &promise) {
+  exception_ptr error;
+  bool done = false;
+  promise.then([] {
+    abort();
+  }, [&](exception_ptr ex) {
+    error = ex;
+    done = true;
+  });
+  while (!done)
+    g_main_context_iteration(NULL, TRUE);
+  return error;
+}
+
+static void test_backlight(Logind *logind) {
+  const string &root = logind->root;
+  addDevice(root, "intel_backlight", 1000);
+
+  LogindBacklight bright(root, SESSION_PATH);
+  await(bright.connect());
+  assert(bright.getBrightness() == 100);
+
+  await(bright.setBrightness(30));
+  assert(logind->calls == 1);
+  assert(bright.getBrightness() == 30);
+  assert(readFile(root + "/intel_backlight/brightness") == "300");
+
+  /* same raw value is not written again */
+  await(bright.setBrightness(30));
+  assert(logind->calls == 1);
+
+  /* device removed behind our back */
+  removeTree(root + "/intel_backlight");
+  exception_ptr error = awaitError(bright.setBrightness(60));
+  assert(GException::kindOf(error) == GException::INVALID_ARGS);
+  assert(logind->calls == 2);
+  assert(bright.getBrightness() == 30);
+}
+
+/* the session is only known to be missing on the first write */
+static void test_no_session(Logind *logind) {
+  const string &root = logind->root;
+  addDevice(root, "intel_backlight", 1000);
+  int calls = logind->calls;
+
+  LogindBacklight bright(root, "/org/freedesktop/login1/session/none");
+  await(bright.connect());
+  exception_ptr error = awaitError(bright.setBrightness(10));
+  assert(GException::kindOf(error) == GException::UNKNOWN_METHOD);
+  assert(logind->calls == calls);
+  assert(bright.getBrightness() == 100);
+  assert(readFile(root + "/intel_backlight/brightness") == "1000");
+}
+
+int main() {
+  Logind logind;
+  setUp(&logind, SESSION_XML, &SESSION, 1, &vtable, &logind);
+
+  gchar *tmp = g_dir_make_tmp("logind_backlight_test-XXXXXX", NULL);
+  assert(tmp);
+  logind.root = tmp;
+  g_free(tmp);
+
+  test_backlight(&logind);
+  test_no_session(&logind);
+
+  removeTree(logind.root);
+  tearDown(&logind);
+
+  cout << "OK" << endl;
+}
@@ -6,7 +6,7 @@
 using namespace std;
 
 int main() {
-  IdleAware proxy;
+  IdleAware proxy(new BrightnessProxy());
   proxy.brightnessChanged << [&] {
     cout << "Brightness: " << proxy.getBrightness() << endl;
   };
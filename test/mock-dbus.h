@@ -0,0 +1,151 @@
+#ifndef MOCK_DBUS_H_
+#define MOCK_DBUS_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <gio/gio.h>
+
+#include <src/logger.h>
+#include <src/promise.h>
+
+/**
+ * Object of a mocked service, the name is owned unless NULL, for
+ * objects of a service whose name is owned by another object.
+ */
+struct MockObject {
+    const char *path;
+    const char *name;
+};
+
+/**
+ * Services mocked on a private bus, used as both session and system
+ * bus. The interfaces of the XML are registered in order, one for
+ * each object, calls going to the vtable of the test.
+ */
+struct MockDBus {
+    GTestDBus *bus = NULL;
+    GDBusConnection *connection = NULL;
+    GDBusNodeInfo *info = NULL;
+    std::vector<guint> objectIds;
+    std::vector<guint> ownerIds;
+    size_t acquired = 0;
+};
+
+inline void onMockNameAcquired(
+    GDBusConnection *connection,
+    const gchar *name,
+    gpointer user_data) {
+  MockDBus *mock = (MockDBus*) user_data;
+  mock->acquired++;
+}
+
+inline void setUp(
+    MockDBus *mock,
+    const char *xml,
+    const MockObject *objects,
+    int n,
+    const GDBusInterfaceVTable *vtable,
+    gpointer user_data) {
+  mock->bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(mock->bus);
+  g_setenv(
+      "DBUS_SYSTEM_BUS_ADDRESS",
+      g_test_dbus_get_bus_address(mock->bus),
+      TRUE);
+
+  mock->connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+  assert(mock->connection);
+  mock->info = g_dbus_node_info_new_for_xml(xml, NULL);
+  assert(mock->info);
+  for (int i = 0; i < n; i++) {
+    guint id = g_dbus_connection_register_object(
+        mock->connection,
+        objects[i].path,
+        mock->info->interfaces[i],
+        vtable,
+        user_data,
+        NULL,
+        NULL);
+    assert(id);
+    mock->objectIds.push_back(id);
+    if (!objects[i].name)
+      continue;
+    mock->ownerIds.push_back(g_bus_own_name_on_connection(
+        mock->connection,
+        objects[i].name,
+        G_BUS_NAME_OWNER_FLAGS_NONE,
+        onMockNameAcquired,
+        NULL,
+        mock,
+        NULL));
+  }
+  while (mock->acquired < mock->ownerIds.size())
+    g_main_context_iteration(NULL, TRUE);
+}
+
+inline void tearDown(MockDBus *mock) {
+  for (guint id : mock->ownerIds)
+    g_bus_unown_name(id);
+  for (guint id : mock->objectIds)
+    g_dbus_connection_unregister_object(mock->connection, id);
+  g_dbus_node_info_unref(mock->info);
+  g_object_unref(mock->connection);
+
+  g_test_dbus_down(mock->bus);
+  g_object_unref(mock->bus);
+}
+
+inline void emitSignal(
+    MockDBus *mock,
+    const char *path,
+    const char *iface,
+    const char *signal,
+    GVariant *parameters) {
+  g_dbus_connection_emit_signal(
+      mock->connection,
+      NULL,
+      path,
+      iface,
+      signal,
+      parameters,
+      NULL);
+}
+
+inline void emitPropertyChanged(
+    MockDBus *mock,
+    const char *path,
+    const char *iface,
+    const char *name,
+    GVariant *value) {
+  GVariantBuilder changed;
+  g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+  g_variant_builder_add(&changed, "{sv}", name, value);
+  emitSignal(
+      mock,
+      path,
+      "org.freedesktop.DBus.Properties",
+      "PropertiesChanged",
+      g_variant_new("(sa{sv}as)", iface, &changed, NULL));
+}
+
+inline void await(const promise::Promise<void> &promise) {
+  bool done = false;
+  promise.then([&] {
+    done = true;
+  }, [&](std::exception_ptr ex) {
+    std::cerr << "Rejected: " << ex << std::endl;
+    abort();
+  });
+  while (!done)
+    g_main_context_iteration(NULL, TRUE);
+}
+
+inline void awaitCalls(int &calls, int expected) {
+  while (calls < expected)
+    g_main_context_iteration(NULL, TRUE);
+  assert(calls == expected);
+}
+
+#endif /* MOCK_DBUS_H_ */
@@ -0,0 +1,66 @@
+#include <cassert>
+#include <iostream>
+
+#include <src/offset-table.h>
+
+using namespace std;
+using namespace fixed;
+
+static void test_learn() {
+  OffsetTable table;
+  assert(table.get(fromInt(50)) == 0);
+
+  assert(table.learn(fromInt(50), 20));
+  assert(table.get(fromInt(50)) == 20);
+  assert(!table.learn(fromInt(50), 20));
+
+  /* decays away from the level */
+  int near = table.get(fromInt(60));
+  int far = table.get(fromInt(90));
+  assert(near > 0 && near < 20);
+  assert(far >= 0 && far < near);
+  assert(table.get(fromInt(0)) == 0);
+  assert(table.get(fromInt(100)) == 0);
+
+  /* other levels keep their own offset */
+  table.learn(fromInt(90), -10);
+  assert(table.get(fromInt(90)) == -10);
+  assert(table.get(fromInt(50)) == 20);
+}
+
+static void test_limits() {
+  OffsetTable table;
+  table.learn(fromInt(-10), 200);
+  assert(table.get(0) == 100);
+  table.learn(fromInt(200), -200);
+  assert(table.get(fromInt(100)) == -100);
+}
+
+static void test_pack() {
+  OffsetTable table;
+  table.fill(5);
+  table.learn(fromInt(30), -15);
+
+  vector<int16_t> packed = table.pack();
+  assert(packed.size() == OffsetTable::SIZE);
+
+  OffsetTable other;
+  assert(other != table);
+  other.unpack(packed);
+  assert(other == table);
+
+  bool thrown = false;
+  try {
+    other.unpack({ 1, 2, 3 });
+  } catch (const invalid_argument &e) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main() {
+  test_learn();
+  test_limits();
+  test_pack();
+  cout << "OK" << endl;
+}
@@ -0,0 +1,268 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <gio/gio.h>
+
+#include <src/autobright.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *POWER_PATH = "/org/gnome/SettingsDaemon/Power";
+static const char *MONITOR_PATH = "/org/gnome/Mutter/IdleMonitor/Core";
+static const char *SENSOR_PATH = "/net/hadess/SensorProxy";
+
+static const char *XML =
+    "<node>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Screen'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Keyboard'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.Mutter.IdleMonitor'>"
+    "    <method name='AddIdleWatch'>"
+    "      <arg name='interval' type='t' direction='in'/>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='AddUserActiveWatch'>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='RemoveWatch'>"
+    "      <arg name='id' type='u' direction='in'/>"
+    "    </method>"
+    "    <signal name='WatchFired'>"
+    "      <arg name='id' type='u'/>"
+    "    </signal>"
+    "  </interface>"
+    "  <interface name='net.hadess.SensorProxy'>"
+    "    <method name='ClaimLight'/>"
+    "    <method name='ReleaseLight'/>"
+    "    <property name='LightLevel' type='d' access='read'/>"
+    "    <property name='LightLevelUnit' type='s' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+static const int N = 4;
+
+static const MockObject OBJECTS[N] = {
+    { POWER_PATH, "org.gnome.SettingsDaemon.Power" },
+    { POWER_PATH, NULL },
+    { MONITOR_PATH, "org.gnome.Mutter.IdleMonitor" },
+    { SENSOR_PATH, "net.hadess.SensorProxy" }
+};
+
+static const char *SCREEN = "org.gnome.SettingsDaemon.Power.Screen";
+
+static const char *KEYBOARD = "org.gnome.SettingsDaemon.Power.Keyboard";
+
+/* gsd power with screen and keyboard, each output has its own idle
+ * and user active watches */
+struct Services: MockDBus {
+    int screen = 50;
+    int keyboard = 50;
+    double lightLevel = 0;
+    guint watches = 0;
+    vector<guint> idleKeys;
+    vector<guint> activeKeys;
+    int removes = 0;
+    int releases = 0;
+};
+
+static void emitBrightness(Services *services, const char *iface, int value) {
+  (g_str_equal(iface, KEYBOARD) ? services->keyboard : services->screen) =
+      value;
+  emitPropertyChanged(
+      services,
+      POWER_PATH,
+      iface,
+      "Brightness",
+      g_variant_new_int32(value));
+}
+
+static void fireWatches(Services *services, const vector<guint> &keys) {
+  for (guint key : keys) {
+    emitSignal(
+        services,
+        MONITOR_PATH,
+        "org.gnome.Mutter.IdleMonitor",
+        "WatchFired",
+        g_variant_new("(u)", key));
+  }
+}
+
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  GVariant *ret = NULL;
+
+  /* Set calls come here since there is no set_property */
+  if (g_str_equal(method_name, "Set")) {
+    const char *iface;
+    GVariant *value;
+    g_variant_get(parameters, "(&s&sv)", &iface, NULL, &value);
+    emitBrightness(
+        services,
+        g_str_equal(iface, KEYBOARD) ? KEYBOARD : SCREEN,
+        g_variant_get_int32(value));
+    g_variant_unref(value);
+  } else if (g_str_equal(method_name, "AddIdleWatch")) {
+    services->idleKeys.push_back(++services->watches);
+    ret = g_variant_new("(u)", services->watches);
+  } else if (g_str_equal(method_name, "AddUserActiveWatch")) {
+    services->activeKeys.push_back(++services->watches);
+    ret = g_variant_new("(u)", services->watches);
+  } else if (g_str_equal(method_name, "RemoveWatch")) {
+    services->removes++;
+  } else if (g_str_equal(method_name, "ReleaseLight")) {
+    services->releases++;
+  } else if (g_str_equal(method_name, "ClaimLight")) {
+    emitPropertyChanged(
+        services,
+        SENSOR_PATH,
+        interface_name,
+        "LightLevel",
+        g_variant_new_double(services->lightLevel));
+  }
+  g_dbus_method_invocation_return_value(invocation, ret);
+}
+
+static GVariant* onGetProperty(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *property_name,
+    GError **error,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  if (g_str_equal(interface_name, KEYBOARD))
+    return g_variant_new_int32(services->keyboard);
+  if (g_str_equal(interface_name, SCREEN))
+    return g_variant_new_int32(services->screen);
+  if (g_str_equal(property_name, "LightLevel"))
+    return g_variant_new_double(services->lightLevel);
+  return g_variant_new_string("lux");
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall, onGetProperty };
+
+static void iterate(long ms) {
+  gint64 until = g_get_monotonic_time() + ms * 1000;
+  while (g_get_monotonic_time() < until)
+    g_main_context_iteration(NULL, FALSE);
+}
+
+/* until both outputs are stable */
+static void settle(Services *services) {
+  int screen;
+  int keyboard;
+  do {
+    screen = services->screen;
+    keyboard = services->keyboard;
+    iterate(1500);
+  } while (services->screen != screen || services->keyboard != keyboard);
+}
+
+/* lux normalized to the level given */
+static double luxFor(int level) {
+  double lux = 0;
+  while (ISensor::normalize(lux, ISensor::LUX) < level)
+    lux += 0.5;
+  assert(ISensor::normalize(lux, ISensor::LUX) == level);
+  return lux;
+}
+
+static size_t learnt(GSettings *settings, const char *key) {
+  GVariant *table = g_settings_get_value(settings, key);
+  size_t n = g_variant_n_children(table);
+  g_variant_unref(table);
+  return n;
+}
+
+/* the default keyboard curve, from 100 at level 10 to 0 at level 40 */
+static int keyboardAt(int level) {
+  return lround(100 - (level - 10) * 100 / 30.0);
+}
+
+static void test_outputs(Services *services, gsettings::PGSettings settings) {
+  GSettings *s = settings.get();
+  services->lightLevel = luxFor(20);
+  Autobright autobright(settings);
+  await(autobright.connect());
+
+  /* one value for both, through their own curve and offset */
+  settle(services);
+  DebugInfo info;
+  autobright.updateDebugInfo(&info);
+  assert(abs(info.value - 20) <= 2);
+  assert(services->screen == info.value);
+  assert(services->keyboard == keyboardAt(info.value + 10));
+
+  /* dimmed by the session while idle, not learnt */
+  int keyboard = services->keyboard;
+  fireWatches(services, services->idleKeys);
+  while (services->activeKeys.size() < 2)
+    g_main_context_iteration(NULL, TRUE);
+  emitBrightness(services, KEYBOARD, 0);
+  iterate(200);
+  assert(learnt(s, "keyboard-offset-table") == 0);
+
+  fireWatches(services, services->activeKeys);
+  while (services->keyboard != keyboard)
+    g_main_context_iteration(NULL, TRUE);
+  assert(learnt(s, "keyboard-offset-table") == 0);
+
+  /* a manual change is learnt for the keyboard only */
+  emitBrightness(services, KEYBOARD, 80);
+  while (!learnt(s, "keyboard-offset-table"))
+    g_main_context_iteration(NULL, TRUE);
+  assert(learnt(s, "offset-table") == 0);
+  assert(services->screen == info.value);
+}
+
+int main() {
+  GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+  GSettingsSchema *schema = source
+      ? g_settings_schema_source_lookup(source, "fragoi.autobright", TRUE)
+      : NULL;
+  if (!schema) {
+    cout << "Schema not found, set GSETTINGS_SCHEMA_DIR" << endl;
+    return 77;
+  }
+  g_settings_schema_unref(schema);
+  g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+
+  Services services;
+  setUp(&services, XML, OBJECTS, N, &vtable, &services);
+
+  gsettings::PGSettings settings = gsettings::newDefault();
+  GSettings *s = settings.get();
+  g_settings_set_string(s, "keyboard-backend", "gsd");
+  g_settings_set_int(s, "keyboard-offset", 10);
+  g_settings_set_double(s, "ramp-rate", 0);
+  g_settings_set_uint(s, "filter-interval", 100);
+  g_settings_set_uint(s, "filter-time-constant", 100);
+
+  test_outputs(&services, settings);
+
+  /* until watches are removed and the light released */
+  awaitCalls(services.removes, services.idleKeys.size());
+  awaitCalls(services.releases, 1);
+  iterate(200);
+
+  tearDown(&services);
+
+  cout << "OK" << endl;
+}
@@ -0,0 +1,299 @@
+#include <cassert>
+#include <iostream>
+#include <gio/gio.h>
+
+#include <src/presence.h>
+#include <src/quiescence.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *SESSION_PATH = "/org/freedesktop/login1/session/test";
+
+static const char *XML =
+    "<node>"
+    "  <interface name='org.gnome.ScreenSaver'>"
+    "    <method name='GetActive'>"
+    "      <arg name='active' type='b' direction='out'/>"
+    "    </method>"
+    "    <signal name='ActiveChanged'>"
+    "      <arg name='active' type='b'/>"
+    "    </signal>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.login1.Session'>"
+    "    <property name='Active' type='b' access='read'/>"
+    "  </interface>"
+    "  <interface name='net.hadess.SensorProxy'>"
+    "    <method name='ClaimLight'/>"
+    "    <method name='ReleaseLight'/>"
+    "    <property name='LightLevel' type='d' access='read'/>"
+    "    <property name='LightLevelUnit' type='s' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.login1.Manager'>"
+    "    <property name='LidClosed' type='b' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+static const int N = 4;
+
+/* the manager is owned with the session */
+static const MockObject OBJECTS[N] = {
+    { "/org/gnome/ScreenSaver", "org.gnome.ScreenSaver" },
+    { SESSION_PATH, "org.freedesktop.login1" },
+    { "/net/hadess/SensorProxy", "net.hadess.SensorProxy" },
+    { "/org/freedesktop/login1", NULL }
+};
+
+/* screen saver, logind session and manager, sensor proxy on the same bus */
+struct Services: MockDBus {
+    bool screenSaverActive = false;
+    bool sessionActive = true;
+    bool lidClosed = false;
+    double lightLevel = 100;
+    int claims = 0;
+    int releases = 0;
+};
+
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  if (g_str_equal(method_name, "GetActive")) {
+    g_dbus_method_invocation_return_value(
+        invocation,
+        g_variant_new("(b)", services->screenSaverActive));
+    return;
+  }
+  /* the light level is sent again on claim, as iio-sensor-proxy does */
+  if (g_str_equal(method_name, "ClaimLight")) {
+    services->claims++;
+    emitPropertyChanged(
+        services,
+        object_path,
+        interface_name,
+        "LightLevel",
+        g_variant_new_double(services->lightLevel));
+  } else if (g_str_equal(method_name, "ReleaseLight")) {
+    services->releases++;
+  }
+  g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static GVariant* onGetProperty(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *property_name,
+    GError **error,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  if (g_str_equal(property_name, "Active"))
+    return g_variant_new_boolean(services->sessionActive);
+  if (g_str_equal(property_name, "LidClosed"))
+    return g_variant_new_boolean(services->lidClosed);
+  if (g_str_equal(property_name, "LightLevel"))
+    return g_variant_new_double(services->lightLevel);
+  return g_variant_new_string("lux");
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall, onGetProperty };
+
+static void setScreenSaverActive(Services *services, bool active) {
+  services->screenSaverActive = active;
+  emitSignal(
+      services,
+      "/org/gnome/ScreenSaver",
+      "org.gnome.ScreenSaver",
+      "ActiveChanged",
+      g_variant_new("(b)", active));
+}
+
+static void setSessionActive(Services *services, bool active) {
+  services->sessionActive = active;
+  emitPropertyChanged(
+      services,
+      SESSION_PATH,
+      "org.freedesktop.login1.Session",
+      "Active",
+      g_variant_new_boolean(active));
+}
+
+static void setLidClosed(Services *services, bool closed) {
+  services->lidClosed = closed;
+  emitPropertyChanged(
+      services,
+      "/org/freedesktop/login1",
+      "org.freedesktop.login1.Manager",
+      "LidClosed",
+      g_variant_new_boolean(closed));
+}
+
+static void setLightLevel(Services *services, double value) {
+  services->lightLevel = value;
+  emitPropertyChanged(
+      services,
+      "/net/hadess/SensorProxy",
+      "net.hadess.SensorProxy",
+      "LightLevel",
+      g_variant_new_double(value));
+}
+
+static void awaitChanged(Presence &presence) {
+  bool changed = false;
+  void *id = presence.changed << [&] {
+    changed = true;
+  };
+  while (!changed)
+    g_main_context_iteration(NULL, TRUE);
+  presence.changed.remove(id);
+}
+
+static void test_presence(Services *services) {
+  Presence presence(SESSION_PATH);
+  await(presence.connect());
+  assert(presence.isPresent());
+
+  setScreenSaverActive(services, true);
+  awaitChanged(presence);
+  assert(presence.isScreenSaverActive());
+  assert(!presence.isPresent());
+
+  setScreenSaverActive(services, false);
+  awaitChanged(presence);
+  assert(presence.isPresent());
+
+  setSessionActive(services, false);
+  awaitChanged(presence);
+  assert(!presence.isSessionActive());
+  assert(!presence.isPresent());
+
+  setSessionActive(services, true);
+  awaitChanged(presence);
+  assert(presence.isPresent());
+
+  setLidClosed(services, true);
+  awaitChanged(presence);
+  assert(presence.isLidClosed());
+  assert(!presence.isPresent());
+
+  setLidClosed(services, false);
+  awaitChanged(presence);
+  assert(presence.isPresent());
+
+  presence.setUserIdle(true);
+  assert(presence.isUserIdle());
+  assert(!presence.isPresent());
+  presence.setUserIdle(false);
+  assert(presence.isPresent());
+}
+
+/* screen saver and lid read on connect */
+static void test_initial(Services *services) {
+  services->screenSaverActive = true;
+  Presence presence(SESSION_PATH);
+  await(presence.connect());
+  assert(!presence.isPresent());
+  services->screenSaverActive = false;
+
+  services->lidClosed = true;
+  Presence closed(SESSION_PATH);
+  await(closed.connect());
+  assert(closed.isLidClosed());
+  assert(!closed.isPresent());
+  services->lidClosed = false;
+}
+
+static void test_quiescence(Services *services) {
+  SensorProxy sensor;
+  await(sensor.connect());
+  assert(services->claims == 1);
+
+  Presence presence(SESSION_PATH);
+  await(presence.connect());
+  Quiescence quiescence(&sensor, &presence);
+  assert(!quiescence.isQuiescent());
+
+  setLightLevel(services, 200);
+  while (sensor.getLightLevel() != 200)
+    g_main_context_iteration(NULL, TRUE);
+
+  gint64 start = g_get_monotonic_time();
+  setScreenSaverActive(services, true);
+  awaitCalls(services->releases, 1);
+  assert(quiescence.isQuiescent());
+
+  /* one sample per active period, none while quiescent */
+  gint64 later = g_get_monotonic_time() + 60 * G_USEC_PER_SEC;
+  assert(quiescence.getQuiescentTime(later) >= 60000);
+  assert(quiescence.getWakeupsAvoided(later) >= 1);
+
+  /* light changed while released is read on claim */
+  services->lightLevel = 50;
+  setScreenSaverActive(services, false);
+  awaitCalls(services->claims, 2);
+  while (sensor.getLightLevel() != 50)
+    g_main_context_iteration(NULL, TRUE);
+  assert(!quiescence.isQuiescent());
+
+  gint64 elapsed = (g_get_monotonic_time() - start) / 1000;
+  assert(quiescence.getQuiescentTime() <= elapsed);
+  long total = quiescence.getQuiescentTime();
+  assert(quiescence.getQuiescentTime(later) == total);
+
+  /* disabled keeps the sensor claimed */
+  quiescence.setEnabled(false);
+  setSessionActive(services, false);
+  awaitChanged(presence);
+  assert(!quiescence.isQuiescent());
+  assert(services->releases == 1);
+
+  quiescence.setEnabled(true);
+  assert(quiescence.isQuiescent());
+  awaitCalls(services->releases, 2);
+
+  setSessionActive(services, true);
+  awaitCalls(services->claims, 3);
+  assert(!quiescence.isQuiescent());
+
+  /* idle user and closed lid release it as well */
+  presence.setUserIdle(true);
+  assert(quiescence.isQuiescent());
+  awaitCalls(services->releases, 3);
+  presence.setUserIdle(false);
+  awaitCalls(services->claims, 4);
+
+  setLidClosed(services, true);
+  awaitCalls(services->releases, 4);
+  assert(quiescence.isQuiescent());
+  setLidClosed(services, false);
+  awaitCalls(services->claims, 5);
+  assert(!quiescence.isQuiescent());
+
+  /* released once, not again when destroyed */
+  await(sensor.suspend());
+  await(sensor.suspend());
+  assert(services->releases == 5);
+}
+
+int main() {
+  Services services;
+  setUp(&services, XML, OBJECTS, N, &vtable, &services);
+
+  test_presence(&services);
+  test_initial(&services);
+  test_quiescence(&services);
+
+  tearDown(&services);
+
+  cout << "OK" << endl;
+}
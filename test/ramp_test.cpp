@@ -0,0 +1,306 @@
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <glib.h>
+
+#include <src/ramp.h>
+
+using namespace std;
+using namespace promise;
+using namespace fixed;
+
+/* brightness set is reported back later when async,
+ * rounded to the steps if any */
+struct TestProxy: IBrightnessProxy {
+    Q16 brightness = fromInt(10);
+    vector<Q16> writes;
+    bool async = false;
+    bool silent = false;
+    bool fail = false;
+    int steps = 0;
+
+    Promise<void> connect() {
+      return resolved();
+    }
+
+    Promise<void> setBrightness(int value) {
+      return setBrightnessFixed(fromInt(value));
+    }
+
+    int getBrightness() const {
+      return toInt(brightness);
+    }
+
+    Promise<void> setBrightnessFixed(Q16 value) {
+      if (fail)
+        return rejected<void>(runtime_error("failed"));
+
+      writes.push_back(quantize(value));
+      if (silent)
+        return resolved();
+      if (async) {
+        g_timeout_add(30, [](gpointer user_data) {
+          TestProxy *self = (TestProxy*) user_data;
+          self->brightness = self->writes.front();
+          self->writes.erase(self->writes.begin());
+          self->brightnessChanged();
+          return G_SOURCE_REMOVE;
+        }, this);
+      } else {
+        set(writes.back());
+      }
+      return resolved();
+    }
+
+    Q16 quantize(Q16 value) const {
+      if (!steps)
+        return value;
+      int step = toInt(value * steps / 100);
+      return fromInt(step * 100) / steps;
+    }
+
+    Q16 getBrightnessFixed() const {
+      return brightness;
+    }
+
+    Q16 getResolution() const {
+      return steps ? fromInt(100) / steps : ONE / 10;
+    }
+
+    void set(Q16 value) {
+      brightness = value;
+      brightnessChanged();
+    }
+};
+
+static void runFor(long millis) {
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add(millis, [](gpointer user_data) {
+    g_main_loop_quit((GMainLoop*) user_data);
+    return G_SOURCE_REMOVE;
+  }, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+static void test_ramp() {
+  TestProxy proxy;
+  Ramp ramp(&proxy);
+  ramp.rate = 100;
+  ramp.interval = 20;
+  int changes = 0;
+  ramp.brightnessChanged << [&] {
+    changes++;
+  };
+
+  ramp.setBrightness(50);
+  assert(ramp.isRamping());
+  assert(ramp.getBrightness() == 50);
+  assert(proxy.getBrightness() == 12);
+
+  runFor(300);
+  assert(ramp.isRamping());
+  assert(proxy.getBrightness() > 20);
+  assert(proxy.getBrightness() < 50);
+
+  runFor(300);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 50);
+  assert(changes == 0);
+
+  /* one write per interval at most */
+  const Ramp::Stats &stats = ramp.getStats();
+  assert(stats.transitions == 1);
+  assert(stats.lastSteps == proxy.writes.size());
+  assert(stats.lastSteps <= 400 / 20 + 1);
+  assert(stats.lastSteps >= 400 / 40);
+}
+
+static void test_retarget() {
+  TestProxy proxy;
+  Ramp ramp(&proxy);
+  ramp.rate = 100;
+  ramp.interval = 20;
+
+  ramp.setBrightness(50);
+  runFor(100);
+  int reached = proxy.getBrightness();
+  assert(reached > 12);
+  ramp.setBrightness(0);
+  runFor(60);
+  assert(ramp.isRamping());
+  assert(proxy.getBrightness() < reached);
+  runFor(400);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 0);
+  assert(ramp.getStats().transitions == 1);
+}
+
+static void test_user_change() {
+  TestProxy proxy;
+  Ramp ramp(&proxy);
+  ramp.rate = 100;
+  ramp.interval = 20;
+  int changes = 0;
+  ramp.brightnessChanged << [&] {
+    changes++;
+  };
+
+  ramp.setBrightness(90);
+  runFor(100);
+  proxy.set(fromInt(30));
+  assert(!ramp.isRamping());
+  assert(changes == 1);
+  assert(ramp.getBrightness() == 30);
+  assert(ramp.getStats().cancelled == 1);
+
+  size_t writes = proxy.writes.size();
+  runFor(100);
+  assert(proxy.writes.size() == writes);
+}
+
+/* echoes arriving late are not user changes */
+static void test_async() {
+  TestProxy proxy;
+  proxy.async = true;
+  Ramp ramp(&proxy);
+  ramp.rate = 100;
+  ramp.interval = 20;
+  int changes = 0;
+  ramp.brightnessChanged << [&] {
+    changes++;
+  };
+
+  ramp.setBrightness(30);
+  runFor(500);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 30);
+  assert(changes == 0);
+  assert(ramp.getStats().echoes == ramp.getStats().steps);
+
+  proxy.set(fromInt(60));
+  assert(changes == 1);
+  assert(ramp.getBrightness() == 60);
+}
+
+/* echoes reported on the backend steps, not where written */
+static void test_quantized() {
+  TestProxy proxy;
+  proxy.async = true;
+  proxy.steps = 3;
+  proxy.brightness = 0;
+  Ramp ramp(&proxy);
+  ramp.rate = 1000;
+  ramp.interval = 20;
+  ramp.echoWindow = 200;
+  int changes = 0;
+  ramp.brightnessChanged << [&] {
+    changes++;
+  };
+
+  ramp.setBrightness(50);
+  runFor(300);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 67);
+  assert(changes == 0);
+
+  ramp.setBrightness(20);
+  runFor(300);
+  assert(proxy.getBrightness() == 33);
+  assert(changes == 0);
+
+  /* after the window the range written does not swallow user changes */
+  runFor(250);
+  proxy.set(fromInt(67));
+  assert(changes == 1);
+  assert(ramp.getBrightness() == 67);
+}
+
+/* a backend that never reports does not leave echoes behind */
+static void test_echo_window() {
+  TestProxy proxy;
+  proxy.silent = true;
+  Ramp ramp(&proxy);
+  ramp.echoWindow = 50;
+  int changes = 0;
+  ramp.brightnessChanged << [&] {
+    changes++;
+  };
+
+  ramp.rate = 1000;
+  ramp.setBrightness(40);
+  runFor(200);
+  assert(!ramp.isRamping());
+  assert(ramp.getBrightness() == 10);
+
+  proxy.set(fromInt(30));
+  assert(changes == 1);
+  assert(ramp.getBrightness() == 30);
+}
+
+static void test_failure() {
+  TestProxy proxy;
+  proxy.fail = true;
+  Ramp ramp(&proxy);
+  bool rejected = false;
+  ramp.setBrightness(70).grab([&](exception_ptr) {
+    rejected = true;
+  });
+  assert(rejected);
+
+  rejected = false;
+  ramp.rate = 0;
+  ramp.setBrightness(20).grab([&](exception_ptr) {
+    rejected = true;
+  });
+  assert(rejected);
+}
+
+static void test_no_rate() {
+  TestProxy proxy;
+  Ramp ramp(&proxy);
+  ramp.rate = 0;
+
+  ramp.setBrightness(70);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 70);
+  assert(proxy.writes.size() == 1);
+}
+
+static void test_at_once() {
+  TestProxy proxy;
+  Ramp ramp(&proxy);
+  ramp.rate = 100;
+  ramp.interval = 20;
+
+  /* the ramp in flight ends with one write */
+  ramp.setBrightness(90);
+  assert(ramp.isRamping());
+  ramp.setAtOnce(true);
+  ramp.setBrightness(60);
+  assert(!ramp.isRamping());
+  assert(proxy.getBrightness() == 60);
+  assert(proxy.writes.size() == 2);
+
+  /* nothing left behind when no value was set meanwhile */
+  ramp.setAtOnce(false);
+  ramp.setAtOnce(true);
+  ramp.setAtOnce(false);
+  ramp.setBrightness(20);
+  assert(ramp.isRamping());
+  assert(proxy.getBrightness() > 20);
+}
+
+int main() {
+  test_ramp();
+  test_retarget();
+  test_user_change();
+  test_async();
+  test_quantized();
+  test_echo_window();
+  test_failure();
+  test_no_rate();
+  test_at_once();
+  cout << "OK" << endl;
+}
@@ -0,0 +1,156 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include <src/filter.h>
+#include <src/replay.h>
+
+using namespace std;
+
+/* 1000 lux to 10 lux and back, sampled every 100ms */
+static vector<Replay::Sample> steps() {
+  vector<Replay::Sample> samples;
+  for (gint64 t = 0; t < 30000; t += 100) {
+    double lux = t >= 5000 && t < 15000 ? 10 : 1000;
+    samples.push_back({ t, lux });
+  }
+  return samples;
+}
+
+static void test_parse() {
+  vector<Replay::Sample> samples = Replay::parse(
+      "# time lux\n"
+      "0 100\n"
+      "\n"
+      "  250 12.5\n");
+  assert(samples.size() == 2);
+  assert(samples[1].time == 250);
+  assert(samples[1].lightLevel == 12.5);
+
+  bool thrown = false;
+  try {
+    Replay::parse("0 100\nfoo\n");
+  } catch (const runtime_error &e) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  thrown = false;
+  try {
+    Replay::parse("100 1\n0 1\n");
+  } catch (const runtime_error &e) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+static void test_time_to_target() {
+  TimeToTarget ttt;
+  ttt.update(50, 50, 0);
+  assert(ttt.start == -1);
+  ttt.update(90, 50, 1000000);
+  ttt.update(90, 70, 2000000);
+  ttt.update(90, 88, 3500000);
+  assert(ttt.last == 2500);
+  assert(ttt.count == 1);
+  assert(ttt.mean() == 2500);
+}
+
+static void test_fast_path() {
+  Replay replay;
+
+  EmaFilter slow;
+  Replay::Result damped = replay.run(&slow, steps());
+  assert(damped.timeToTarget.count == 2);
+
+  FastPathFilter fast(new EmaFilter());
+  fast.confirmTime = 300;
+  Replay::Result snapped = replay.run(&fast, steps());
+  assert(snapped.timeToTarget.count == 2);
+  assert(snapped.timeToTarget.max == 300);
+  assert(snapped.timeToTarget.max < damped.timeToTarget.max);
+
+  cout << "Time to target, damped: " << damped.timeToTarget.mean()
+      << "ms, fast path: " << snapped.timeToTarget.mean() << "ms" << endl;
+}
+
+/* small steps keep the damping of the wrapped filter */
+static void test_small_steps() {
+  vector<Replay::Sample> samples;
+  for (gint64 t = 0; t < 10000; t += 100) {
+    samples.push_back({ t, t < 2000 ? 100.0 : 200.0 });
+  }
+
+  Replay replay;
+  PressureFilter slow;
+  Replay::Result damped = replay.run(&slow, samples);
+  FastPathFilter fast(new PressureFilter());
+  Replay::Result result = replay.run(&fast, samples);
+  assert(result.values == damped.values);
+}
+
+/* light next to a level boundary, flipping between the two levels */
+static void test_dead_band() {
+  vector<Replay::Sample> samples;
+  for (gint64 t = 0; t < 600000; t += 500) {
+    samples.push_back({ t, (t / 500) % 2 ? 31.0 : 34.0 });
+  }
+
+  Replay replay;
+  HysteresisFilter direct;
+  direct.threshold = 1;
+  Replay::Result flipping = replay.run(&direct, samples);
+  assert(flipping.changes > 1000);
+
+  DeadBand deadBand;
+  Replay::Result held = replay.run(&direct, samples, &deadBand);
+  assert(held.changes <= 1);
+  assert(held.changesPerHour() < flipping.changesPerHour() / 100);
+
+  cout << "Value changes per hour, direct: " << flipping.changesPerHour()
+      << ", dead band: " << held.changesPerHour() << endl;
+}
+
+/* dusk, from 1000 lux to 1 lux in ten minutes with some noise */
+static vector<Replay::Sample> dusk() {
+  vector<Replay::Sample> samples;
+  for (gint64 t = 0; t <= 600000; t += 1000) {
+    double noise = (t / 1000) % 3 ? 1.02 : 0.98;
+    samples.push_back({ t, pow(10, 3 - t / 200000.0) * noise });
+  }
+  return samples;
+}
+
+static void test_predictor() {
+  Replay replay;
+  DeadBand band;
+
+  EmaFilter trailing;
+  trailing.timeConstant = 10000;
+  Replay::Result plain = replay.run(&trailing, dusk(), &band);
+
+  EmaFilter *ema = new EmaFilter();
+  ema->timeConstant = 10000;
+  PredictiveFilter predictive(ema);
+  predictive.leadTime = 10000;
+  DeadBand other;
+  Replay::Result led = replay.run(&predictive, dusk(), &other);
+
+  assert(led.meanAbsoluteError() < plain.meanAbsoluteError());
+  assert(led.changes <= plain.changes);
+
+  cout << "Mean absolute error, plain: " << plain.meanAbsoluteError()
+      << ", predictor: " << led.meanAbsoluteError()
+      << ", changes: " << plain.changes << ", " << led.changes << endl;
+}
+
+int main() {
+  test_parse();
+  test_time_to_target();
+  test_fast_path();
+  test_small_steps();
+  test_dead_band();
+  test_predictor();
+  cout << "OK" << endl;
+}
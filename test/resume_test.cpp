@@ -0,0 +1,333 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <src/autobright.h>
+#include <src/iio-sensor.h>
+#include <src/logger.h>
+
+#include "mock-dbus.h"
+
+using namespace std;
+using namespace promise;
+
+static const char *XML =
+    "<node>"
+    "  <interface name='org.gnome.SettingsDaemon.Power.Screen'>"
+    "    <property name='Brightness' type='i' access='readwrite'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.Mutter.IdleMonitor'>"
+    "    <method name='GetIdletime'>"
+    "      <arg name='idletime' type='t' direction='out'/>"
+    "    </method>"
+    "    <method name='AddIdleWatch'>"
+    "      <arg name='interval' type='t' direction='in'/>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='AddUserActiveWatch'>"
+    "      <arg name='id' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='RemoveWatch'>"
+    "      <arg name='id' type='u' direction='in'/>"
+    "    </method>"
+    "    <signal name='WatchFired'>"
+    "      <arg name='id' type='u'/>"
+    "    </signal>"
+    "  </interface>"
+    "  <interface name='net.hadess.SensorProxy'>"
+    "    <method name='ClaimLight'/>"
+    "    <method name='ReleaseLight'/>"
+    "    <property name='LightLevel' type='d' access='read'/>"
+    "    <property name='LightLevelUnit' type='s' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.login1.Manager'>"
+    "    <signal name='PrepareForSleep'>"
+    "      <arg name='start' type='b'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+static const int N = 4;
+
+static const MockObject OBJECTS[N] = {
+    { "/org/gnome/SettingsDaemon/Power", "org.gnome.SettingsDaemon.Power" },
+    { "/org/gnome/Mutter/IdleMonitor/Core", "org.gnome.Mutter.IdleMonitor" },
+    { "/net/hadess/SensorProxy", "net.hadess.SensorProxy" },
+    { "/org/freedesktop/login1", "org.freedesktop.login1" }
+};
+
+/* gsd power, mutter idle monitor, sensor proxy and logind on one bus,
+ * there is no screen saver nor session so they are assumed present */
+struct Services: MockDBus {
+    int brightness = 50;
+    vector<int> writes;
+    double lightLevel = 0;
+    int claims = 0;
+    int releases = 0;
+    guint watches = 0;
+    guint idleKey = 0;
+    guint activeKey = 0;
+};
+
+static void onMethodCall(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *method_name,
+    GVariant *parameters,
+    GDBusMethodInvocation *invocation,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  GVariant *ret = NULL;
+
+  /* Set calls come here since there is no set_property */
+  if (g_str_equal(method_name, "Set")) {
+    GVariant *value;
+    g_variant_get(parameters, "(&s&sv)", NULL, NULL, &value);
+    services->brightness = g_variant_get_int32(value);
+    services->writes.push_back(services->brightness);
+    g_variant_unref(value);
+    emitPropertyChanged(
+        services,
+        object_path,
+        "org.gnome.SettingsDaemon.Power.Screen",
+        "Brightness",
+        g_variant_new_int32(services->brightness));
+  } else if (g_str_equal(method_name, "GetIdletime")) {
+    ret = g_variant_new("(t)", (guint64) 0);
+  } else if (g_str_equal(method_name, "AddIdleWatch")) {
+    services->idleKey = ++services->watches;
+    ret = g_variant_new("(u)", services->idleKey);
+  } else if (g_str_equal(method_name, "AddUserActiveWatch")) {
+    services->activeKey = ++services->watches;
+    ret = g_variant_new("(u)", services->activeKey);
+  } else if (g_str_equal(method_name, "ClaimLight")) {
+    /* the light level is sent again on claim, as iio-sensor-proxy does */
+    services->claims++;
+    emitPropertyChanged(
+        services,
+        object_path,
+        interface_name,
+        "LightLevel",
+        g_variant_new_double(services->lightLevel));
+  } else if (g_str_equal(method_name, "ReleaseLight")) {
+    services->releases++;
+  }
+  g_dbus_method_invocation_return_value(invocation, ret);
+}
+
+static GVariant* onGetProperty(
+    GDBusConnection *connection,
+    const gchar *sender,
+    const gchar *object_path,
+    const gchar *interface_name,
+    const gchar *property_name,
+    GError **error,
+    gpointer user_data) {
+  Services *services = (Services*) user_data;
+  if (g_str_equal(property_name, "Brightness"))
+    return g_variant_new_int32(services->brightness);
+  if (g_str_equal(property_name, "LightLevel"))
+    return g_variant_new_double(services->lightLevel);
+  return g_variant_new_string("lux");
+}
+
+static const GDBusInterfaceVTable vtable = { onMethodCall, onGetProperty };
+
+static void prepareForSleep(Services *services, bool start) {
+  emitSignal(
+      services,
+      "/org/freedesktop/login1",
+      "org.freedesktop.login1.Manager",
+      "PrepareForSleep",
+      g_variant_new("(b)", start));
+}
+
+static void fireWatch(Services *services, guint key) {
+  emitSignal(
+      services,
+      "/org/gnome/Mutter/IdleMonitor/Core",
+      "org.gnome.Mutter.IdleMonitor",
+      "WatchFired",
+      g_variant_new("(u)", key));
+}
+
+static void emitLightLevel(Services *services, double lux) {
+  services->lightLevel = lux;
+  emitPropertyChanged(
+      services,
+      "/net/hadess/SensorProxy",
+      "net.hadess.SensorProxy",
+      "LightLevel",
+      g_variant_new_double(lux));
+}
+
+/* until the ramp in flight is done */
+static void settle(Services *services) {
+  size_t writes;
+  do {
+    writes = services->writes.size();
+    gint64 until = g_get_monotonic_time() + 200 * 1000;
+    while (g_get_monotonic_time() < until)
+      g_main_context_iteration(NULL, FALSE);
+  } while (services->writes.size() != writes);
+}
+
+/* lux normalized to the level given */
+static double luxFor(int level) {
+  double lux = 0;
+  while (ISensor::normalize(lux, ISensor::LUX) < level)
+    lux += 0.5;
+  assert(ISensor::normalize(lux, ISensor::LUX) == level);
+  return lux;
+}
+
+/* milliseconds until the first write after resume, or to the target */
+static long resume(Services *services, double lux, int target) {
+  prepareForSleep(services, true);
+  awaitCalls(services->releases, services->claims);
+
+  services->lightLevel = lux;
+  services->writes.clear();
+  gint64 start = g_get_monotonic_time();
+  prepareForSleep(services, false);
+
+  gint64 deadline = start + 2 * G_USEC_PER_SEC;
+  while (target < 0 ? services->writes.empty()
+      : services->brightness != target) {
+    g_main_context_iteration(NULL, FALSE);
+    assert(g_get_monotonic_time() < deadline);
+  }
+  return (g_get_monotonic_time() - start) / 1000;
+}
+
+static void test_resume(Services *services) {
+  /* no write before sleep, filter and screen agree */
+  services->lightLevel = luxFor(50);
+  Autobright autobright;
+  await(autobright.connect());
+  assert(services->claims == 1);
+
+  long elapsed = resume(services, luxFor(100), 100);
+  cout << "Time to correct brightness after resume: " << elapsed << "ms"
+      << endl;
+  assert(services->claims == 2);
+  assert(services->writes == vector<int>({ 100 }));
+  assert(elapsed < 1000);
+
+  DebugInfo info;
+  autobright.updateDebugInfo(&info);
+  assert(info.resumeTime >= 0 && info.resumeTime <= elapsed);
+  assert(info.value == 100);
+
+  /* without the fast path the filter and the ramp take their time */
+  autobright.resumeWindow = 0;
+  resume(services, luxFor(50), -1);
+  assert(services->writes.front() > 50);
+
+  /* released before going, to leave no call behind */
+  prepareForSleep(services, true);
+  awaitCalls(services->releases, 3);
+  settle(services);
+}
+
+/* the idle watch alone keeps the sensor, the session dim releases it */
+static void test_idle(Services *services) {
+  services->lightLevel = luxFor(50);
+  services->brightness = 50;
+  Autobright autobright;
+  await(autobright.connect());
+  int claims = services->claims;
+  int releases = services->releases;
+
+  fireWatch(services, services->idleKey);
+  while (!services->activeKey)
+    g_main_context_iteration(NULL, TRUE);
+
+  services->writes.clear();
+  emitLightLevel(services, luxFor(80));
+  gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+  while (services->writes.empty()) {
+    g_main_context_iteration(NULL, FALSE);
+    assert(g_get_monotonic_time() < deadline);
+  }
+  settle(services);
+  assert(services->releases == releases);
+
+  /* dimmed by the session */
+  emitPropertyChanged(
+      services,
+      "/org/gnome/SettingsDaemon/Power",
+      "org.gnome.SettingsDaemon.Power.Screen",
+      "Brightness",
+      g_variant_new_int32(20));
+  awaitCalls(services->releases, releases + 1);
+
+  fireWatch(services, services->activeKey);
+  awaitCalls(services->claims, claims + 1);
+
+  /* released before going, to leave no call behind */
+  prepareForSleep(services, true);
+  awaitCalls(services->releases, releases + 2);
+  settle(services);
+}
+
+/* iio polls on resume and emits the sample before resume returns,
+ * the pipeline must be active by then to apply it at once */
+static void test_iio(Services *services) {
+  gchar *tmp = g_dir_make_tmp("resume_test_XXXXXX", NULL);
+  assert(tmp);
+  string root(tmp);
+  g_free(tmp);
+  string path = root + "/iio:device0";
+  assert(g_mkdir(path.c_str(), 0755) == 0);
+  string input = path + "/in_illuminance_input";
+  assert(g_file_set_contents(input.c_str(), "10", -1, NULL));
+
+  IioSensor sensor("", root, root, 1000);
+  await(sensor.connect());
+  Presence presence;
+  await(presence.connect());
+  Quiescence quiescence(&sensor, &presence);
+
+  vector<string> events;
+  quiescence.changed << [&] {
+    events.push_back(quiescence.isQuiescent() ? "quiescent" : "active");
+  };
+  sensor.lightLevelChanged << [&] {
+    events.push_back("sample");
+  };
+
+  prepareForSleep(services, true);
+  while (!quiescence.isQuiescent())
+    g_main_context_iteration(NULL, TRUE);
+
+  assert(g_file_set_contents(input.c_str(), "80", -1, NULL));
+  prepareForSleep(services, false);
+  while (quiescence.isQuiescent())
+    g_main_context_iteration(NULL, TRUE);
+  assert(events == vector<string>({ "quiescent", "active", "sample" }));
+  assert(sensor.getLightLevel() == 80);
+
+  await(sensor.suspend());
+  g_remove(input.c_str());
+  g_remove(path.c_str());
+  g_remove(root.c_str());
+}
+
+int main() {
+  Services services;
+  setUp(&services, XML, OBJECTS, N, &vtable, &services);
+
+  test_resume(&services);
+  test_idle(&services);
+  test_iio(&services);
+
+  tearDown(&services);
+
+  cout << "OK" << endl;
+}
@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <time.h>
 #include <string>
+#include <gio/gio.h>
 
 #include <src/retry.h>
 #include <src/logger.h>
@@ -39,6 +40,15 @@ static Promise<int> test_retry_int(int &times) {
   }, BACKOFF, FACTOR, RETRIES);
 }
 
+static Promise<void> test_retry_error(int &times, GQuark domain, int code) {
+  return retry::retry([&, domain, code] {
+    cout << "Retry called: " << times << endl;
+    times--;
+    return rejected<void>(GException(g_error_new_literal(
+        domain, code, "failed")));
+  }, BACKOFF, FACTOR, RETRIES);
+}
+
 static void quitLoop(GMainLoop **loop) {
   g_main_loop_quit(*loop);
   g_main_loop_unref(*loop);
@@ -91,7 +101,41 @@ static void test_int() {
   assert(rejected == 1);
 }
 
+static void test_permanent() {
+  int times = RETRIES + 1;
+  int resolved = 0;
+  int rejected = 0;
+
+  runLoop(
+      test_retry_error(times, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED),
+      resolved,
+      rejected);
+
+  /* called only once */
+  assert(times == RETRIES);
+  assert(resolved == 0);
+  assert(rejected == 1);
+}
+
+static void test_cancelled() {
+  int times = RETRIES + 1;
+  int resolved = 0;
+  int rejected = 0;
+
+  runLoop(
+      test_retry_error(times, G_IO_ERROR, G_IO_ERROR_CANCELLED),
+      resolved,
+      rejected);
+
+  /* called only once */
+  assert(times == RETRIES);
+  assert(resolved == 0);
+  assert(rejected == 1);
+}
+
 int main() {
   test_void();
   test_int();
+  test_permanent();
+  test_cancelled();
 }
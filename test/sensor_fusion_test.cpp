@@ -0,0 +1,227 @@
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+#include <src/sensor-fusion.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+struct TestSensor: public ISensor {
+    double lightLevel = 0;
+    Unit unit = LUX;
+    bool fail = false;
+    bool stale = false;
+
+    Promise<void> connect() {
+      if (fail)
+        return rejected<void>(runtime_error("failed"));
+      return resolved();
+    }
+
+    double getLightLevel() const {
+      return lightLevel;
+    }
+
+    Unit getUnit() const {
+      return unit;
+    }
+
+    bool isStale() const {
+      return stale;
+    }
+
+    void setStale(bool value) {
+      stale = value;
+      staleChanged();
+    }
+
+    void set(double value) {
+      lightLevel = value;
+      lightLevelChanged();
+    }
+};
+
+static bool connect(SensorFusion &fusion) {
+  bool connected = false;
+  bool done = false;
+  fusion.connect().then([&] {
+    connected = true;
+    done = true;
+  }, [&](exception_ptr ex) {
+    done = true;
+  });
+  assert(done);
+  return connected;
+}
+
+static void test_weighted_median() {
+  assert(SensorFusion::weightedMedian({ { 1, 1 }, { 2, 1 }, { 3, 1 } }) == 2);
+  assert(SensorFusion::weightedMedian({ { 3, 1 }, { 1, 1 } }) == 2);
+  assert(SensorFusion::weightedMedian({ { 1, 1 }, { 10, 3 } }) == 10);
+  assert(SensorFusion::weightedMedian({ { 1, 3 }, { 10, 1 } }) == 1);
+  assert(SensorFusion::weightedMedian({ { 5, 1 } }) == 5);
+}
+
+static void test_median() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  TestSensor *c = new TestSensor();
+  fusion.add(a);
+  fusion.add(b);
+  fusion.add(c);
+
+  int changes = 0;
+  fusion.lightLevelChanged << [&] {
+    changes++;
+  };
+
+  a->lightLevel = 100;
+  b->lightLevel = 110;
+  c->lightLevel = 120;
+  assert(connect(fusion));
+  assert(fusion.getUnit() == ISensor::LUX);
+  assert(fusion.getLightLevel() == 110);
+
+  /* a single jittery source does not move the estimate */
+  int before = changes;
+  c->set(500);
+  c->set(115);
+  assert(fusion.getLightLevel() == 110);
+  assert(changes == before);
+
+  b->set(105);
+  assert(fusion.getLightLevel() == 105);
+  assert(changes == before + 1);
+}
+
+static void test_max() {
+  SensorFusion fusion;
+  fusion.policy = SensorFusion::MAX;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  fusion.add(a);
+  fusion.add(b);
+
+  a->lightLevel = 50;
+  b->lightLevel = 20;
+  assert(connect(fusion));
+  assert(fusion.getLightLevel() == 50);
+
+  b->set(80);
+  assert(fusion.getLightLevel() == 80);
+}
+
+/* sources emit on change only, a steady one still counts */
+static void test_steady() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  TestSensor *c = new TestSensor();
+  fusion.add(a);
+  fusion.add(b);
+  fusion.add(c);
+
+  a->lightLevel = 10;
+  b->lightLevel = 30;
+  c->lightLevel = 30;
+  assert(connect(fusion));
+  assert(fusion.getLightLevel() == 30);
+
+  /* b and c steady, a noisy one does not take over */
+  a->set(12);
+  a->set(400);
+  assert(fusion.getLightLevel() == 30);
+}
+
+static void test_suspend() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  fusion.add(a);
+  fusion.add(b);
+
+  a->lightLevel = 10;
+  b->lightLevel = 30;
+  assert(connect(fusion));
+  assert(fusion.getLightLevel() == 20);
+
+  /* values of suspended sources are not combined */
+  fusion.suspend();
+  a->set(12);
+  assert(fusion.getLightLevel() == 20);
+
+  fusion.resume();
+  assert(fusion.getLightLevel() == 21);
+}
+
+/* a source that fails to read stops voting until it reads again */
+static void test_stale() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  fusion.add(a);
+  fusion.add(b);
+
+  a->lightLevel = 10;
+  b->lightLevel = 30;
+  assert(connect(fusion));
+  assert(fusion.getLightLevel() == 20);
+
+  b->setStale(true);
+  assert(fusion.getLightLevel() == 10);
+
+  b->setStale(false);
+  assert(fusion.getLightLevel() == 20);
+}
+
+static void test_units() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  a->unit = ISensor::VENDOR;
+  a->lightLevel = 900;
+  b->lightLevel = 40;
+  fusion.add(a);
+  fusion.add(b);
+
+  assert(connect(fusion));
+  assert(fusion.getUnit() == ISensor::LUX);
+  assert(fusion.getLightLevel() == 40);
+}
+
+static void test_connect() {
+  SensorFusion fusion;
+  TestSensor *a = new TestSensor();
+  TestSensor *b = new TestSensor();
+  a->fail = true;
+  a->lightLevel = 1000;
+  b->lightLevel = 10;
+  fusion.add(a);
+  fusion.add(b);
+
+  assert(connect(fusion));
+  assert(fusion.getLightLevel() == 10);
+
+  SensorFusion none;
+  TestSensor *c = new TestSensor();
+  c->fail = true;
+  none.add(c);
+  assert(!connect(none));
+  assert(!none.hasUnit());
+}
+
+int main() {
+  test_weighted_median();
+  test_median();
+  test_max();
+  test_steady();
+  test_suspend();
+  test_stale();
+  test_units();
+  test_connect();
+
+  cout << "OK" << endl;
+}
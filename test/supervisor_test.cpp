@@ -0,0 +1,120 @@
+#include <cassert>
+#include <iostream>
+#include <gio/gio.h>
+
+#include <src/supervisor.h>
+#include <src/gexception.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+static const char *NAME = "com.github.fragoi.Autobright.SupervisorTest";
+
+struct Context {
+    GMainLoop *loop;
+    guint ownerId = 0;
+    bool acquired = false;
+    int reconnects = 0;
+    int failures = 0;
+};
+
+static void onNameAcquired(
+    GDBusConnection *connection,
+    const gchar *name,
+    gpointer user_data) {
+  cout << "Name acquired: " << name << endl;
+  Context *ctx = (Context*) user_data;
+  if (!ctx->acquired) {
+    ctx->acquired = true;
+    g_main_loop_quit(ctx->loop);
+  }
+}
+
+static void ownName(Context *ctx) {
+  ctx->ownerId = g_bus_own_name(
+      G_BUS_TYPE_SESSION,
+      NAME,
+      G_BUS_NAME_OWNER_FLAGS_NONE,
+      NULL,
+      onNameAcquired,
+      NULL,
+      ctx,
+      NULL);
+}
+
+static gboolean restartService(gpointer user_data) {
+  Context *ctx = (Context*) user_data;
+  cout << "Restarting service" << endl;
+  g_bus_unown_name(ctx->ownerId);
+  ownName(ctx);
+  return FALSE;
+}
+
+static gboolean timeout(gpointer user_data) {
+  cerr << "Timeout" << endl;
+  abort();
+}
+
+static void test_backoff() {
+  retry::Backoff backoff { 100, 2, 1000, 0 };
+  assert(backoff.delay(0) == 100);
+  assert(backoff.delay(1) == 200);
+  assert(backoff.delay(3) == 800);
+  assert(backoff.delay(4) == 1000);
+  assert(backoff.delay(100) == 1000);
+
+  backoff.jitter = 0.5;
+  for (int i = 0; i < 100; i++) {
+    long delay = backoff.delay(2);
+    assert(delay >= 200 && delay <= 400);
+  }
+}
+
+static void test_reconnect() {
+  Context ctx;
+  ctx.loop = g_main_loop_new(NULL, FALSE);
+
+  /* service is running before supervising */
+  ownName(&ctx);
+  g_main_loop_run(ctx.loop);
+
+  Supervisor supervisor;
+  supervisor.backoff = { 10, 2, 100, 0.5 };
+  supervisor.watch(G_BUS_TYPE_SESSION, NAME, [&]() -> Promise<void> {
+    cout << "Reconnect called" << endl;
+    /* first attempt fails as if the service was not ready */
+    if (!ctx.failures++) {
+      return rejected<void>(GException(g_error_new_literal(
+          G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN, "not ready")));
+    }
+    ctx.reconnects++;
+    g_main_loop_quit(ctx.loop);
+    return resolved();
+  });
+
+  g_timeout_add(200, restartService, &ctx);
+  g_timeout_add(5000, timeout, &ctx);
+
+  g_main_loop_run(ctx.loop);
+
+  assert(ctx.failures == 2);
+  assert(ctx.reconnects == 1);
+
+  g_bus_unown_name(ctx.ownerId);
+  g_main_loop_unref(ctx.loop);
+}
+
+int main() {
+  test_backoff();
+
+  GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(bus);
+
+  test_reconnect();
+
+  g_test_dbus_down(bus);
+  g_object_unref(bus);
+
+  cout << "OK" << endl;
+}
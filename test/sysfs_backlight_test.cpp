@@ -0,0 +1,157 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <src/sysfs-backlight.h>
+#include <src/logger.h>
+
+using namespace std;
+using namespace promise;
+
+static string readFile(const string &path) {
+  gchar *contents = NULL;
+  assert(g_file_get_contents(path.c_str(), &contents, NULL, NULL));
+  string value(g_strstrip(contents));
+  g_free(contents);
+  return value;
+}
+
+static void writeFile(const string &path, const string &value) {
+  assert(g_file_set_contents(path.c_str(), value.c_str(), -1, NULL));
+}
+
+static void addDevice(
+    const string &root,
+    const string &name,
+    const string &type,
+    int max,
+    int value) {
+  string path = root + "/" + name;
+  assert(g_mkdir(path.c_str(), 0755) == 0);
+  writeFile(path + "/type", type);
+  writeFile(path + "/max_brightness", to_string(max));
+  writeFile(path + "/brightness", to_string(value));
+}
+
+static void removeTree(const string &path) {
+  GDir *dir = g_dir_open(path.c_str(), 0, NULL);
+  if (dir) {
+    const char *name;
+    while ((name = g_dir_read_name(dir)))
+      removeTree(path + "/" + name);
+    g_dir_close(dir);
+  }
+  g_remove(path.c_str());
+}
+
+static void await(const Promise<void> &promise) {
+  bool done = false;
+  promise.then([&] {
+    done = true;
+  }, [&](exception_ptr ex) {
+    cerr << "Rejected: " << ex << endl;
+    abort();
+  });
+  while (!done)
+    g_main_context_iteration(NULL, TRUE);
+}
+
+static void test_backlight(const string &root) {
+  addDevice(root, "acpi_video0", "firmware", 15, 15);
+  addDevice(root, "intel_backlight", "raw", 1000, 1000);
+
+  SysfsBacklight bright(root);
+  int changes = 0;
+  bright.brightnessChanged << [&] {
+    changes++;
+  };
+
+  await(bright.connect());
+  assert(bright.getDevices().size() == 2);
+  assert(bright.getDevices()[0].name == "acpi_video0");
+  assert(bright.getBrightness() == 100);
+  assert(changes == 1);
+
+  await(bright.setBrightness(50));
+  assert(bright.getBrightness() == 50);
+  assert(readFile(root + "/acpi_video0/brightness") == "8");
+  assert(readFile(root + "/intel_backlight/brightness") == "500");
+  assert(changes == 2);
+
+  /* nothing to wake up for while the brightness is left alone */
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+  assert(!g_main_context_pending(NULL));
+
+  /* external change on the primary device, regular files
+   * are not notified as sysfs attributes are */
+  writeFile(root + "/acpi_video0/brightness", "3");
+  bright.refresh();
+  assert(bright.getBrightness() == 20);
+  assert(changes == 3);
+}
+
+/* quantized to the raw resolution only when writing */
+static void test_fixed(const string &root) {
+  addDevice(root, "fine", "raw", 1000, 0);
+
+  SysfsBacklight bright(root);
+  await(bright.connect());
+  assert(bright.getResolution() == 6554);
+
+  await(bright.setBrightnessFixed(fixed::fromDouble(50.25)));
+  assert(readFile(root + "/fine/brightness") == "503");
+  assert(bright.getBrightnessFixed() == fixed::fromDouble(50.25));
+  assert(bright.getBrightness() == 50);
+
+  await(bright.setBrightnessFixed(fixed::fromDouble(50.31)));
+  assert(readFile(root + "/fine/brightness") == "503");
+}
+
+/* keyboard backlight among other leds */
+static void test_keyboard(const string &root) {
+  addDevice(root, "input3::capslock", "", 1, 0);
+  addDevice(root, "dell::kbd_backlight", "", 2, 0);
+
+  SysfsBacklight keyboard(root, SysfsBacklight::KEYBOARD_PATTERN);
+  await(keyboard.connect());
+  assert(keyboard.getDevices().size() == 1);
+  assert(keyboard.getDevices()[0].name == "dell::kbd_backlight");
+  assert(keyboard.getBrightness() == 0);
+
+  await(keyboard.setBrightness(50));
+  assert(readFile(root + "/dell::kbd_backlight/brightness") == "1");
+  assert(readFile(root + "/input3::capslock/brightness") == "0");
+}
+
+static void test_empty(const string &root) {
+  SysfsBacklight bright(root + "/missing");
+  bool rejected = false;
+  bright.connect().then([] {
+    abort();
+  }, [&](exception_ptr ex) {
+    rejected = true;
+  });
+  assert(rejected);
+}
+
+int main() {
+  gchar *tmp = g_dir_make_tmp("sysfs_backlight_test-XXXXXX", NULL);
+  assert(tmp);
+  string root(tmp);
+  g_free(tmp);
+
+  test_backlight(root);
+  removeTree(root);
+  g_mkdir(root.c_str(), 0755);
+  test_fixed(root);
+  removeTree(root);
+  g_mkdir(root.c_str(), 0755);
+  test_keyboard(root);
+  test_empty(root);
+
+  removeTree(root);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include <src/filter.h>
+#include <src/replay.h>
+
+using namespace std;
+
+struct Case {
+    const char *name;
+    IFilter* (*create)();
+};
+
+static const Case CASES[] = {
+  { "pressure", [] () -> IFilter* { return new PressureFilter(); } },
+  { "ema", [] () -> IFilter* { return new EmaFilter(); } },
+  { "median", [] () -> IFilter* { return new MedianFilter(); } },
+  { "kalman", [] () -> IFilter* { return new KalmanFilter(); } },
+  { "hysteresis", [] () -> IFilter* { return new HysteresisFilter(); } },
+};
+
+static void usage(const char *name) {
+  cerr << "Usage: " << name
+      << " TRACE [FILTER [THRESHOLD [CONFIRM [DEADBAND [PREDICTOR]]]]]"
+      << endl
+      << "  TRACE      lines of milliseconds and lux" << endl
+      << "  FILTER     pressure, ema, median, kalman or hysteresis" << endl
+      << "  THRESHOLD  fast path threshold, 0 to disable (default 25)" << endl
+      << "  CONFIRM    fast path confirmation milliseconds (default 500)"
+      << endl
+      << "  DEADBAND   UP:DOWN:DWELL, or off (default 1:2:1000)" << endl
+      << "  PREDICTOR  LEAD:WINDOW:LIMIT, or off (default off)" << endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  const char *name = argc > 2 ? argv[2] : "pressure";
+  const Case *found = nullptr;
+  for (const Case &c : CASES) {
+    if (!strcmp(name, c.name))
+      found = &c;
+  }
+  if (!found) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  unique_ptr<IFilter> filter(found->create());
+  int threshold = argc > 3 ? atoi(argv[3]) : 25;
+  if (threshold > 0) {
+    FastPathFilter *fastPath = new FastPathFilter(filter.release());
+    fastPath->threshold = threshold;
+    if (argc > 4)
+      fastPath->confirmTime = atol(argv[4]);
+    filter.reset(fastPath);
+  }
+
+  if (argc > 6 && strcmp(argv[6], "off")) {
+    long lead, window;
+    int limit;
+    if (sscanf(argv[6], "%ld:%ld:%d", &lead, &window, &limit) != 3) {
+      usage(argv[0]);
+      return 2;
+    }
+    PredictiveFilter *predictive = new PredictiveFilter(filter.release());
+    predictive->leadTime = lead;
+    predictive->window = window;
+    predictive->limit = limit;
+    filter.reset(predictive);
+  }
+
+  unique_ptr<DeadBand> deadBand;
+  if (argc <= 5 || strcmp(argv[5], "off")) {
+    double up = 1, down = 2;
+    long dwell = 1000;
+    if (argc > 5 && sscanf(argv[5], "%lf:%lf:%ld", &up, &down, &dwell) != 3) {
+      usage(argv[0]);
+      return 2;
+    }
+    deadBand.reset(new DeadBand());
+    deadBand->up = fixed::fromDouble(up);
+    deadBand->down = fixed::fromDouble(down);
+    deadBand->dwell = dwell;
+  }
+
+  vector<Replay::Sample> samples;
+  try {
+    samples = Replay::load(argv[1]);
+  } catch (const exception &e) {
+    cerr << "Cannot load trace: " << e.what() << endl;
+    return 1;
+  }
+
+  Replay replay;
+  Replay::Result result = replay.run(
+      filter.get(),
+      samples,
+      deadBand.get());
+
+  for (const auto &value : result.values) {
+    cout << value.first << " " << value.second << endl;
+  }
+
+  const TimeToTarget &ttt = result.timeToTarget;
+  cerr << "samples: " << samples.size()
+      << ", changes: " << result.values.size() - 1
+      << ", transitions: " << ttt.count
+      << ", time to target mean: " << ttt.mean() << "ms"
+      << ", max: " << ttt.max << "ms"
+      << ", value changes per hour: " << result.changesPerHour()
+      << ", mean absolute error: " << result.meanAbsoluteError() << endl;
+}